@@ -107,6 +107,7 @@ void Build::addArgs()
             });
 
     addDeep();
+    addAnalysisCache();
     addAbsolute();
 
     m_ap.add(
@@ -166,6 +167,17 @@ void Build::addArgs()
             "entwine will determine it heuristically.",
             [this](json j) { m_json["hierarchyStep"] = extract(j); });
 
+    m_ap.add(
+            "--bundleStep",
+            "Depth step at which data files are packed into shard objects.",
+            [this](json j) { m_json["bundleStep"] = extract(j); });
+
+    m_ap.add(
+            "--hierarchyCacheSize",
+            "Number of hierarchy nodes to hold in memory before spilling to "
+            "the tmp directory.  0 to hold the whole hierarchy in memory.",
+            [this](json j) { m_json["hierarchyCacheSize"] = extract(j); });
+
     m_ap.add(
             "--sleepCount",
             "Count (per-thread) after which idle nodes are serialized.",
@@ -177,6 +189,13 @@ void Build::addArgs()
             "logging (default: 10).",
             [this](json j) { m_json["progressInterval"] = extract(j); });
 
+    m_ap.add(
+            "--copc",
+            "Once the build is complete, also write the dataset as a single "
+            "cloud-optimized point cloud (COPC) file at this path.\n"
+            "Example: --copc ~/entwine/autzen.copc.laz",
+            [this](json j) { m_json["copc"] = j; });
+
     m_ap.add(
             "--laz_14",
             "Write LAZ 1.4 content encoding (default: false)",
@@ -186,6 +205,47 @@ void Build::addArgs()
                 m_json["laz_14"] = true;
             });
 
+    m_ap.add(
+            "--binaryHierarchy",
+            "Also write the hierarchy in a compact binary form, used to "
+            "speed up continued builds and merges (default: false)",
+            [this](json j)
+            {
+                checkEmpty(j);
+                m_json["binaryHierarchy"] = true;
+            });
+
+    m_ap.add(
+            "--binaryManifest",
+            "Also write the manifest in a compact binary form, used to "
+            "speed up continued builds and merges (default: false)",
+            [this](json j)
+            {
+                checkEmpty(j);
+                m_json["binaryManifest"] = true;
+            });
+
+    m_ap.add(
+            "--nodeStats",
+            "Also write the tight bounds and GpsTime, Intensity, and "
+            "Classification ranges of each node alongside the hierarchy "
+            "(default: false)",
+            [this](json j)
+            {
+                checkEmpty(j);
+                m_json["nodeStats"] = true;
+            });
+
+    m_ap.add(
+            "--timeIndex",
+            "Also write an index of the GpsTime values of each node, for "
+            "time-window queries (default: false)",
+            [this](json j)
+            {
+                checkEmpty(j);
+                m_json["timeIndex"] = true;
+            });
+
     addArbiter();
 }
 
@@ -197,6 +197,27 @@ void App::addDeep()
             });
 }
 
+void App::addAnalysisCache()
+{
+    m_ap.add(
+            "--analysisCache",
+            "Local directory in which to cache file analyses, so that "
+            "unchanged files are not analyzed again by later runs\n"
+            "Example: --analysisCache ~/.entwine/cache",
+            [this](json j) { m_json["analysisCache"] = j; });
+
+    m_ap.add(
+            "--analysisCacheRemote",
+            "Also cache analyses of remote files, keyed by their size alone.  "
+            "A remote file rewritten in place with the same size will not be "
+            "analyzed again (default: false)",
+            [this](json j)
+            {
+                checkEmpty(j);
+                m_json["analysisCacheRemote"] = true;
+            });
+}
+
 void App::addAbsolute()
 {
     m_ap.add(
@@ -56,6 +56,7 @@ protected:
     void addReprojection();
     void addNoTrustHeaders();
     void addDeep();
+    void addAnalysisCache();
     void addAbsolute();
     void addArbiter();
 
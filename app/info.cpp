@@ -49,6 +49,7 @@ void Info::addArgs()
 
     addTmp();
     addDeep();
+    addAnalysisCache();
     addReprojection();
     addSimpleThreads();
     addConfig();
@@ -98,7 +99,10 @@ void Info::run()
         deep,
         tmp,
         *a,
-        threads);
+        threads,
+        true,
+        config::getAnalysisCache(m_json),
+        config::getAnalysisCacheRemote(m_json));
     const SourceInfo summary = manifest::reduce(sources);
 
     std::cout << "\tDone.\n" << std::endl;
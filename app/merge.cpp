@@ -40,6 +40,17 @@ void Merge::addArgs()
             "Force merge overwrite - if a completed EPT dataset exists at this "
             "output location, overwrite it with the result of the merge.",
             [this](json j) { checkEmpty(j); m_json["force"] = true; });
+    m_ap.add(
+            "--copc",
+            "Also write the merged dataset as a single cloud-optimized point "
+            "cloud (COPC) file at this path.\n"
+            "Example: --copc ~/entwine/autzen.copc.laz",
+            [this](json j) { m_json["copc"] = j; });
+    m_ap.add(
+            "--hierarchyCacheSize",
+            "Number of hierarchy nodes to hold in memory before spilling to "
+            "the tmp directory.  0 to hold the whole hierarchy in memory.",
+            [this](json j) { m_json["hierarchyCacheSize"] = extract(j); });
 }
 
 void Merge::run()
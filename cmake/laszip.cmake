@@ -0,0 +1,10 @@
+find_path(LASZIP_INCLUDE_DIR laszip/laszip_api.h)
+find_library(LASZIP_LIBRARY NAMES laszip laszip3)
+if (LASZIP_INCLUDE_DIR AND LASZIP_LIBRARY)
+    message(STATUS "Found LASzip: ${LASZIP_LIBRARY}")
+    set(LASZIP_DEFS ENTWINE_HAVE_LASZIP)
+    set(LASZIP_DIRECTORIES ${LASZIP_INCLUDE_DIR})
+else()
+    set(LASZIP_INCLUDE_DIR "")
+    set(LASZIP_LIBRARY "")
+endif()
@@ -16,6 +16,8 @@ function(compiler_options target)
             ${CURL_DEFS}
             ${OPENSSL_DEFS}
             ${BACKTRACE_DEFS}
+            ${URING_DEFS}
+            ${LASZIP_DEFS}
     )
     target_include_directories(${target}
         PRIVATE
@@ -26,6 +28,7 @@ function(compiler_options target)
             ${OPENSSL_INCLUDE_DIR}
             ${LASZIP_DIRECTORIES}
             ${JSONCPP_INCLUDE_DIR}
+            ${URING_INCLUDE_DIR}
     )
 
     target_link_libraries(${target}
@@ -0,0 +1,11 @@
+if (NOT WIN32)
+    find_path(URING_INCLUDE_DIR liburing.h)
+    find_library(URING_LIBRARY uring)
+    if (URING_INCLUDE_DIR AND URING_LIBRARY)
+        message(STATUS "Found liburing: ${URING_LIBRARY}")
+        set(URING_DEFS ENTWINE_HAVE_URING)
+    else()
+        set(URING_INCLUDE_DIR "")
+        set(URING_LIBRARY "")
+    endif()
+endif()
@@ -14,20 +14,28 @@
 #include <cassert>
 #include <iostream>
 #include <limits>
+#include <unordered_set>
 
 #include <pdal/PipelineManager.hpp>
 
 #include <entwine/builder/clipper.hpp>
+#include <entwine/builder/copc.hpp>
 #include <entwine/builder/heuristics.hpp>
+#include <entwine/builder/native-reader.hpp>
+#include <entwine/builder/prefetcher.hpp>
+#include <entwine/io/order.hpp>
 #include <entwine/types/dimension.hpp>
 #include <entwine/types/point-counts.hpp>
 #include <entwine/util/config.hpp>
 #include <entwine/util/fs.hpp>
+#include <entwine/util/hedge.hpp>
 #include <entwine/util/info.hpp>
 #include <entwine/util/io.hpp>
 #include <entwine/util/pdal-mutex.hpp>
 #include <entwine/util/pipeline.hpp>
+#include <entwine/util/ranged-stream.hpp>
 #include <entwine/util/time.hpp>
+#include <entwine/util/unique.hpp>
 
 namespace entwine
 {
@@ -42,6 +50,137 @@ std::string toFullPrecisionString(double d) {
         d;
     return os.str();
 }
+
+Hierarchy::Spill getSpill(const Endpoints& endpoints, const uint64_t nodes)
+{
+    if (nodes && !endpoints.tmp.isLocal())
+    {
+        throw ConfigurationError(
+            "Spilling the hierarchy requires a local tmp directory");
+    }
+    return Hierarchy::Spill { endpoints.tmp.prefixedRoot(), nodes };
+}
+
+// Prefer the binary hierarchy if the build wrote one.  Otherwise, this may be
+// a build from before it was enabled, so fall back to the JSON.
+Hierarchy loadHierarchy(
+    const Endpoints& endpoints,
+    const unsigned threads,
+    const std::string postfix,
+    const bool binary,
+    Hedge* hedge,
+    const Hierarchy::Spill spill,
+    optional<unsigned>* savedStep = nullptr)
+{
+    // The binary hierarchy records how the JSON files were split, so that
+    // continuations may rewrite only the changed files either way.
+    if (binary &&
+        endpoints.hierarchy.tryGetSize(hierarchy::getBinaryFilename(postfix)))
+    {
+        return hierarchy::loadBinary(
+            endpoints.hierarchy,
+            threads,
+            postfix,
+            hedge,
+            spill,
+            savedStep);
+    }
+
+    unsigned step(0);
+    Hierarchy h(hierarchy::load(
+        endpoints.hierarchy,
+        threads,
+        postfix,
+        hedge,
+        spill,
+        &step));
+    if (savedStep) *savedStep = step;
+    return h;
+}
+
+// As for the hierarchy, prefer the binary manifest if there is one, in which
+// case the details of each source are only loaded as they are needed.  If
+// given, fromBinary receives whether it was used.
+Manifest loadManifest(
+    const Endpoints& endpoints,
+    const unsigned threads,
+    const std::string postfix,
+    const bool binary,
+    const bool verbose,
+    Hedge* hedge,
+    bool* fromBinary = nullptr)
+{
+    const bool exists = binary &&
+        endpoints.sources.tryGetSize(manifest::getBinaryFilename(postfix));
+    if (fromBinary) *fromBinary = exists;
+
+    if (exists)
+    {
+        return manifest::loadBinary(endpoints.sources, threads, postfix, hedge);
+    }
+    return manifest::load(endpoints.sources, threads, postfix, verbose, hedge);
+}
+
+std::shared_ptr<NodeStatsMap> loadNodeStats(
+    const Endpoints& endpoints,
+    const bool enabled,
+    const unsigned threads,
+    const std::string postfix,
+    Hedge* hedge)
+{
+    if (!enabled) return nullptr;
+
+    // Stats may have been enabled only after this build was started.
+    auto stats(std::make_shared<NodeStatsMap>());
+    const std::string root(hierarchy::getStatsFilename(Dxyz(), postfix));
+    if (endpoints.hierarchy.tryGetSize(root))
+    {
+        hierarchy::loadStats(
+            *stats,
+            endpoints.hierarchy,
+            threads,
+            postfix,
+            hedge);
+    }
+    return stats;
+}
+
+std::shared_ptr<TimeIndex> loadTimeIndex(
+    const Endpoints& endpoints,
+    const bool enabled,
+    const std::string postfix,
+    const bool empty,
+    Hedge* hedge)
+{
+    if (!enabled) return nullptr;
+
+    // Unlike node stats, nodes missing from the index would be skipped by
+    // queries rather than treated as unknown, so the index must cover every
+    // node of the build.
+    auto index(std::make_shared<TimeIndex>());
+    const std::string filename(timeindex::getFilename(postfix));
+    if (endpoints.output.tryGetSize(filename))
+    {
+        timeindex::load(*index, endpoints.output, postfix, hedge);
+    }
+    else if (!empty)
+    {
+        throw std::runtime_error(
+            "The time index must be enabled when a build is started");
+    }
+    return index;
+}
+
+// Remote LAS/LAZ inputs which we can decode natively are streamed via ranged
+// reads as they are inserted, rather than being downloaded first.
+bool isStreamed(const arbiter::Arbiter& a, const Source& source)
+{
+    return
+        !a.isLocal(source.path) &&
+        RangedStream::supports(a, source.path) &&
+        NativeReader::accepts(source.info, source.path);
+}
+
 }
 
 Builder::Builder(
@@ -49,14 +188,51 @@ Builder::Builder(
     Metadata metadata,
     Manifest manifest,
     Hierarchy hierarchy,
-    bool verbose)
+    bool verbose,
+    optional<unsigned> savedStep,
+    std::shared_ptr<NodeStatsMap> nodeStats,
+    std::shared_ptr<TimeIndex> timeIndex)
     : endpoints(endpoints)
     , metadata(metadata)
     , io(Io::create(this->metadata, this->endpoints))
     , manifest(manifest)
     , hierarchy(hierarchy)
     , verbose(verbose)
-{ }
+    , savedStep(savedStep)
+    , nodeStats(nodeStats)
+    , timeIndex(timeIndex)
+{
+    if (!this->nodeStats && this->metadata.internal.nodeStats)
+    {
+        this->nodeStats = std::make_shared<NodeStatsMap>();
+    }
+    if (this->metadata.internal.timeIndex)
+    {
+        if (!contains(this->metadata.schema, "GpsTime"))
+        {
+            throw std::runtime_error(
+                "The time index requires a GpsTime dimension");
+        }
+        if (io::getOrder(this->metadata) != io::Order::GpsTime)
+        {
+            throw std::runtime_error(
+                "The time index requires points ordered by GpsTime");
+        }
+        if (!this->timeIndex)
+        {
+            this->timeIndex = std::make_shared<TimeIndex>();
+        }
+    }
+
+    // Node stats and the time index are held entirely in memory, which would
+    // defeat the purpose of bounding the memory used by the hierarchy.
+    if ((this->nodeStats || this->timeIndex) && this->hierarchy.spills())
+    {
+        throw ConfigurationError(
+            "Node stats and the time index may not be combined with a "
+            "hierarchy cache size");
+    }
+}
 
 uint64_t Builder::run(
     const Threads threads,
@@ -113,36 +289,70 @@ void Builder::runInserts(
     const uint64_t stolenThreads = threads.work - actualWorkThreads;
     const uint64_t actualClipThreads = threads.clip + stolenThreads;
 
-    ChunkCache cache(endpoints, metadata, *io, hierarchy, actualClipThreads);
-    Pool pool(std::min<uint64_t>(actualWorkThreads, manifest.size()));
-
-    uint64_t filesInserted = 0;
-
+    std::vector<uint64_t> origins;
     for (
         uint64_t origin = 0;
-        origin < manifest.size() && (!limit || filesInserted < limit);
+        origin < manifest.size() && (!limit || origins.size() < limit);
         ++origin)
     {
-        if (cache.fatalErrors().size()) break;
-
         const auto& item = manifest.at(origin);
         const auto& info = item.source.info;
         if (!item.inserted && info.points && active.overlaps(info.bounds))
         {
-            if (verbose)
-            {
-                std::cout << "Adding " << origin << " - " << item.source.path <<
-                    std::endl;
-            }
+            origins.push_back(origin);
+        }
+    }
+    changed.insert(origins.begin(), origins.end());
+
+    // Sources from a binary manifest need their details before insertion.
+    manifest::loadDetails(
+        manifest,
+        endpoints.sources,
+        origins,
+        threads.work + threads.clip,
+        getPostfix(metadata));
 
-            pool.add([this, &cache, origin, &counter]()
-            {
-                tryInsert(cache, origin, counter);
-                if (verbose) std::cout << "\tDone " << origin << std::endl;
-            });
+    // Other remote inputs are downloaded ahead of their insertion.
+    StringList paths;
+    for (const uint64_t origin : origins)
+    {
+        const Source& source(manifest.at(origin).source);
+        if (!isStreamed(*endpoints.arbiter, source))
+        {
+            paths.push_back(source.path);
+        }
+    }
+    Prefetcher prefetcher(
+        *endpoints.arbiter,
+        paths,
+        metadata.internal.prefetch,
+        metadata.internal.prefetchBufferSize);
+
+    ChunkCache cache(
+        endpoints,
+        metadata,
+        *io,
+        hierarchy,
+        actualClipThreads,
+        nodeStats.get(),
+        timeIndex.get());
+    Pool pool(std::min<uint64_t>(actualWorkThreads, manifest.size()));
+
+    for (const uint64_t origin : origins)
+    {
+        if (cache.fatalErrors().size()) break;
 
-            ++filesInserted;
+        if (verbose)
+        {
+            std::cout << "Adding " << origin << " - " <<
+                manifest.at(origin).source.path << std::endl;
         }
+
+        pool.add([this, &cache, &prefetcher, origin, &counter]()
+        {
+            tryInsert(cache, prefetcher, origin, counter);
+            if (verbose) std::cout << "\tDone " << origin << std::endl;
+        });
     }
 
     if (verbose) std::cout << "Joining" << std::endl;
@@ -220,12 +430,24 @@ void Builder::monitor(
                 info.read << "R - " <<
                 info.alive << "A" <<
                 std::endl;
+
+            for (const auto& p : io->stats())
+            {
+                const Scheduler::Stats& s(p.second);
+                std::cout << "\tI/O " << p.first << " - " <<
+                    s.queued << " queued - " <<
+                    s.active << " active - " <<
+                    s.waiting << " retrying - " <<
+                    std::round(s.latency) << " ms" <<
+                    std::endl;
+            }
         }
     }
 }
 
 void Builder::tryInsert(
     ChunkCache& cache,
+    Prefetcher& prefetcher,
     const Origin originId,
     std::atomic_uint64_t& counter)
 {
@@ -233,7 +455,7 @@ void Builder::tryInsert(
 
     try
     {
-        insert(cache, originId, counter);
+        insert(cache, prefetcher, originId, counter);
     }
     catch (const std::exception& e)
     {
@@ -249,15 +471,13 @@ void Builder::tryInsert(
 
 void Builder::insert(
     ChunkCache& cache,
+    Prefetcher& prefetcher,
     const Origin originId,
     std::atomic_uint64_t& counter)
 {
     auto& item = manifest.at(originId);
     auto& info(item.source.info);
-    const auto handle =
-        ensureGetLocalHandle(*endpoints.arbiter, item.source.path);
-
-    const std::string localPath = handle.localPath();
+    const arbiter::Arbiter& a(*endpoints.arbiter);
 
     ChunkKey ck(metadata.bounds, getStartDepth(metadata));
     Clipper clipper(cache);
@@ -320,10 +540,88 @@ void Builder::insert(
         counter += counts.inserts;
     });
 
+    const bool needsStats = !hasStats(info.schema);
+
+    // Only accumulate stats for points that actually get inserted.
+    const Bounds statsBounds = boundsSubset
+        ? *boundsSubset
+        : metadata.boundsConforming;
+
+    // Our origin ID is assigned during insertion, but the source file's
+    // metadata won't have it.  In that case, add it to the source file's
+    // schema so it ends up being included in the stats.
+    const auto addOriginId = [&]()
+    {
+        if (contains(metadata.schema, "OriginId") &&
+            !contains(info.schema, "OriginId"))
+        {
+            info.schema.emplace_back("OriginId", Type::Unsigned32);
+        }
+    };
+
     json pipeline = info.pipeline.is_null()
         ? json::array({ json::object() })
         : info.pipeline;
-    pipeline.at(0)["filename"] = localPath;
+
+    // For subset builds, inputs which support spatially filtered reads only
+    // decode the points which may belong to this subset, rather than reading
+    // everything and discarding most of it.
+    const bool filtered = boundsSubset && pushDownBounds(
+        pipeline,
+        item.source.path,
+        intersection(*boundsSubset, metadata.boundsConforming));
+
+    // Plain LAS/LAZ files skip PDAL pipeline construction entirely.  If they
+    // are remote, they are streamed where possible, falling back to a local
+    // copy if their header turns out to be something we can't decode.
+    std::unique_ptr<NativeReader> reader;
+    if (!filtered && isStreamed(a, item.source))
+    {
+        reader = NativeReader::create(
+            info,
+            item.source.path,
+            makeUnique<RangedStream>(a, item.source.path));
+    }
+
+    Prefetcher::Handle handle;
+    if (!reader)
+    {
+        handle = prefetcher.get(item.source.path);
+        if (!filtered)
+        {
+            reader = NativeReader::create(
+                info,
+                item.source.path,
+                handle->localPath());
+        }
+    }
+
+    if (reader)
+    {
+        reader->read(
+            table,
+            needsStats ? statsBounds : optional<Bounds>());
+
+        if (needsStats)
+        {
+            addOriginId();
+
+            for (Dimension& d : info.schema)
+            {
+                if (d.name == "OriginId")
+                {
+                    DimensionStats stats;
+                    stats.minimum = stats.maximum = stats.mean = originId;
+                    d.stats = stats;
+                }
+                else d.stats = reader->stats().at(d.name);
+                d.stats->count = info.points;
+            }
+        }
+        return;
+    }
+
+    pipeline.at(0)["filename"] = handle->localPath();
 
     if (contains(metadata.schema, "OriginId"))
     {
@@ -333,7 +631,6 @@ void Builder::insert(
         });
     }
 
-    const bool needsStats = !hasStats(info.schema);
     if (needsStats)
     {
         json& statsFilter = findOrAppendStage(pipeline, "filters.stats");
@@ -342,13 +639,8 @@ void Builder::insert(
             statsFilter.update({ { "enumerate", "Classification" } });
         }
 
-        // Only accumulate stats for points that actually get inserted.
-        const Bounds b = boundsSubset 
-            ? *boundsSubset 
-            : metadata.boundsConforming;
-
-        const auto& min = b.min();
-        const auto& max = b.max();
+        const auto& min = statsBounds.min();
+        const auto& max = statsBounds.max();
 
         const std::string where = 
             "X >= " + toFullPrecisionString(min.x) + " && " + 
@@ -378,14 +670,7 @@ void Builder::insert(
         const pdal::StatsFilter& statsFilter(
             dynamic_cast<const pdal::StatsFilter&>(*stage));
 
-        // Our source file metadata might not have an origin id since we add
-        // that dimension.  In that case, add it to the source file's schema so
-        // it ends up being included in the stats.
-        if (contains(metadata.schema, "OriginId") && 
-            !contains(info.schema, "OriginId"))
-        {
-            info.schema.emplace_back("OriginId", Type::Unsigned32);
-        }
+        addOriginId();
 
         for (Dimension& d : info.schema)
         {
@@ -399,35 +684,141 @@ void Builder::insert(
 void Builder::save(const unsigned threads)
 {
     if (verbose) std::cout << "Saving" << std::endl;
+    io->bundle(threads);
     saveHierarchy(threads);
     saveSources(threads);
-    saveMetadata();
+    saveTimeIndex();
+    saveMetadata(threads);
 }
 
 void Builder::saveHierarchy(const unsigned threads)
 {
     // If we are a) saving a subset or b) saving a partial build, then defer
     // choosing a hierarchy step and instead just write one monolothic file.
-    const bool isStepped =
-        !metadata.subset &&
+    // An explicitly configured step needs no choosing, so partial builds use
+    // it too, which lets their continuations rewrite only changed files.
+    const bool isComplete =
         std::all_of(manifest.begin(), manifest.end(), isSettled);
 
     unsigned step = 0;
-    if (isStepped)
+    if (!metadata.subset)
     {
         if (metadata.internal.hierarchyStep)
         {
             step = metadata.internal.hierarchyStep;
         }
-        else step = hierarchy::determineStep(hierarchy);
+        else if (isComplete) step = hierarchy::determineStep(hierarchy);
+    }
+
+    // Files may only be rewritten selectively if they are split just as they
+    // were when this build was loaded.  Node stats change along with their
+    // node data, even if the point count of the node does not.
+    const std::string postfix = getPostfix(metadata);
+    const bool incremental =
+        hierarchy.tracking() && !metadata.subset &&
+        savedStep && *savedStep == step;
+
+    std::vector<Dxyz> roots;
+    if (incremental)
+    {
+        std::vector<Dxyz> keys(hierarchy.changed());
+        if (nodeStats)
+        {
+            const std::vector<Dxyz> stats(nodeStats->changed());
+            keys.insert(keys.end(), stats.begin(), stats.end());
+        }
+        roots = hierarchy::getFileRoots(keys, step);
+    }
+
+    if (!incremental || roots.size())
+    {
+        if (metadata.internal.binaryHierarchy)
+        {
+            hierarchy::saveBinary(
+                hierarchy,
+                endpoints.hierarchy,
+                step,
+                postfix);
+        }
+
+        // Subsets are only read by the merge, so with a binary hierarchy, the
+        // JSON is unnecessary.
+        if (!metadata.internal.binaryHierarchy || !metadata.subset)
+        {
+            saveHierarchyFiles(step, roots, incremental, threads);
+        }
     }
 
+    if (nodeStats)
+    {
+        // If stats were only just enabled, there are no files to update.
+        const bool exists = endpoints.hierarchy.tryGetSize(
+            hierarchy::getStatsFilename(Dxyz(), postfix));
+
+        if (incremental && exists)
+        {
+            hierarchy::saveStats(
+                hierarchy,
+                *nodeStats,
+                endpoints.hierarchy,
+                step,
+                roots,
+                threads,
+                postfix);
+        }
+        else
+        {
+            hierarchy::saveStats(
+                hierarchy,
+                *nodeStats,
+                endpoints.hierarchy,
+                step,
+                threads,
+                postfix);
+        }
+        nodeStats->clearChanged();
+    }
+
+    if (hierarchy.tracking())
+    {
+        hierarchy.track();
+        savedStep = step;
+    }
+}
+
+void Builder::saveHierarchyFiles(
+    const unsigned step,
+    const std::vector<Dxyz>& roots,
+    const bool incremental,
+    const unsigned threads)
+{
+    const std::string postfix = getPostfix(metadata);
+    if (!incremental)
+    {
+        hierarchy::save(hierarchy, endpoints.hierarchy, step, threads, postfix);
+        return;
+    }
+
+    if (verbose)
+    {
+        std::cout << "Rewriting " << roots.size() << " hierarchy files" <<
+            std::endl;
+    }
     hierarchy::save(
         hierarchy,
         endpoints.hierarchy,
         step,
+        roots,
         threads,
-        getPostfix(metadata));
+        postfix);
+}
+
+void Builder::saveTimeIndex()
+{
+    if (!timeIndex || !timeIndex->changed()) return;
+
+    timeindex::save(*timeIndex, endpoints.output, getPostfix(metadata));
+    timeIndex->clearChanged();
 }
 
 void Builder::saveSources(const unsigned threads)
@@ -435,8 +826,21 @@ void Builder::saveSources(const unsigned threads)
     const std::string postfix = getPostfix(metadata);
     const std::string manifestFilename = "manifest" + postfix + ".json";
     const bool pretty = manifest.size() <= 1000;
+    const bool binary = metadata.internal.binaryManifest;
 
-    if (metadata.subset)
+    if (metadata.subset && binary)
+    {
+        // Subsets are only read by the merge, so with a binary manifest, the
+        // JSON is unnecessary.
+        manifest::saveBinary(
+            manifest,
+            endpoints.sources,
+            changed,
+            threads,
+            postfix);
+        changed.clear();
+    }
+    else if (metadata.subset)
     {
         // If we are a subset, write the whole detailed metadata as one giant
         // blob, since we know we're going to need to wake up the whole thing to
@@ -478,11 +882,63 @@ void Builder::saveSources(const unsigned threads)
                 json(manifest).dump(getIndent(pretty)));
         }
     }
+    else if (binary)
+    {
+        // The details shards hold the full metadata of every source, so
+        // per-source files would only duplicate them at the cost of a write
+        // for each changed source.  Those are not written, and the overview
+        // refers to no metadata paths - EPT readers need only its paths,
+        // bounds, and point counts.
+        for (auto& item : manifest) item.metadataPath.clear();
+
+        manifest::saveBinary(
+            manifest,
+            endpoints.sources,
+            changed,
+            threads,
+            postfix);
+        changed.clear();
+
+        ensurePut(
+            endpoints.sources,
+            manifestFilename,
+            toOverview(manifest).dump(getIndent(pretty)));
+    }
     else
     {
-        // Save individual per-file metadata.
+        // Save individual per-file metadata.  Only sources which have changed,
+        // or whose metadata paths have, need to be rewritten - new sources
+        // have no metadata paths until they are assigned here.
+        StringList previous;
+        for (const auto& item : manifest)
+        {
+            previous.push_back(item.metadataPath);
+        }
+
         manifest = assignMetadataPaths(manifest);
-        saveEach(manifest, endpoints.sources, threads, pretty);
+
+        std::set<uint64_t> origins;
+        for (uint64_t origin = 0; origin < manifest.size(); ++origin)
+        {
+            if (changed.count(origin) ||
+                manifest[origin].metadataPath != previous[origin])
+            {
+                origins.insert(origin);
+            }
+        }
+
+        // Sources from a binary manifest need their details to be rewritten.
+        manifest::loadDetails(
+            manifest,
+            endpoints.sources,
+            std::vector<uint64_t>(origins.begin(), origins.end()),
+            threads,
+            postfix);
+
+        Manifest dirty;
+        for (const uint64_t origin : origins) dirty.push_back(manifest[origin]);
+        saveEach(dirty, endpoints.sources, threads, pretty);
+        changed.clear();
 
         // And in this case, we'll only write an overview for the manifest
         // itself, which excludes things like detailed metadata.
@@ -493,13 +949,17 @@ void Builder::saveSources(const unsigned threads)
     }
 }
 
-void Builder::saveMetadata()
+void Builder::saveMetadata(const unsigned threads)
 {
+    const std::string postfix = getPostfix(metadata);
+
     // If we've gained dimension stats during our build, accumulate them and
     // add them to our main metadata.
     const auto pred = [](const BuildItem& b) { return hasStats(b); };
     if (!metadata.subset && std::all_of(manifest.begin(), manifest.end(), pred))
     {
+        manifest::loadDetails(manifest, endpoints.sources, threads, postfix);
+
         Schema schema = clearStats(metadata.schema);
 
         for (const BuildItem& item : manifest)
@@ -515,8 +975,6 @@ void Builder::saveMetadata()
         metadata.schema = schema;
     }
 
-    const std::string postfix = getPostfix(metadata);
-
     const std::string metaFilename = "ept" + postfix + ".json";
     json metaJson = metadata;
     metaJson["points"] = getInsertedPoints(manifest);
@@ -533,7 +991,8 @@ Builder load(
     const Endpoints endpoints,
     const unsigned threads,
     const unsigned subsetId,
-    const bool verbose)
+    const bool verbose,
+    const uint64_t hierarchyCacheSize)
 {
     const std::string postfix = subsetId ? "-" + std::to_string(subsetId) : "";
     const json metadataJson = entwine::merge(
@@ -542,13 +1001,46 @@ Builder load(
 
     const Metadata metadata = config::getMetadata(metadataJson);
 
-    const Manifest manifest =
-        manifest::load(endpoints.sources, threads, postfix, verbose);
-
-    const Hierarchy hierarchy =
-        hierarchy::load(endpoints.hierarchy, threads, postfix);
-
-    return Builder(endpoints, metadata, manifest, hierarchy);
+    // Merges combine the schemas of every source, so all details are needed.
+    Manifest manifest = loadManifest(
+        endpoints,
+        threads,
+        postfix,
+        metadata.internal.binaryManifest,
+        verbose,
+        nullptr);
+    manifest::loadDetails(manifest, endpoints.sources, threads, postfix);
+
+    const Hierarchy hierarchy = loadHierarchy(
+        endpoints,
+        threads,
+        postfix,
+        metadata.internal.binaryHierarchy,
+        nullptr,
+        getSpill(endpoints, hierarchyCacheSize));
+
+    const auto nodeStats = loadNodeStats(
+        endpoints,
+        metadata.internal.nodeStats,
+        threads,
+        postfix,
+        nullptr);
+    const auto timeIndex = loadTimeIndex(
+        endpoints,
+        metadata.internal.timeIndex,
+        postfix,
+        !hierarchy.size(),
+        nullptr);
+
+    return Builder(
+        endpoints,
+        metadata,
+        manifest,
+        hierarchy,
+        verbose,
+        optional<unsigned>(),
+        nodeStats,
+        timeIndex);
 }
 
 Builder create(json j)
@@ -557,8 +1049,15 @@ Builder create(json j)
     const Endpoints endpoints = config::getEndpoints(j);
     const unsigned threads = config::getThreads(j);
 
+    const Hierarchy::Spill spill =
+        getSpill(endpoints, config::getHierarchyCacheSize(j));
+
     Manifest manifest;
-    Hierarchy hierarchy;
+    Hierarchy hierarchy(spill);
+    optional<unsigned> savedStep;
+    std::shared_ptr<NodeStatsMap> nodeStats;
+    std::shared_ptr<TimeIndex> timeIndex;
+    bool fromBinary = false;
 
     // TODO: Handle subset postfixing during existence check - currently
     // continuations of subset builds will not work properly.
@@ -573,23 +1072,54 @@ Builder create(json j)
         j = entwine::merge(j, existingConfig);
 
         // Awaken our existing manifest and hierarchy.
-        manifest = manifest::load(endpoints.sources, threads, "", verbose);
-        hierarchy = hierarchy::load(endpoints.hierarchy, threads);
+        Hedge hedge(config::getHedge(j));
+        manifest = loadManifest(
+            endpoints,
+            threads,
+            "",
+            config::getBinaryManifest(j),
+            verbose,
+            &hedge,
+            &fromBinary);
+        hierarchy = loadHierarchy(
+            endpoints,
+            threads,
+            "",
+            config::getBinaryHierarchy(j),
+            &hedge,
+            spill,
+            &savedStep);
+        nodeStats = loadNodeStats(
+            endpoints,
+            config::getNodeStats(j),
+            threads,
+            "",
+            &hedge);
+        timeIndex = loadTimeIndex(
+            endpoints,
+            config::getTimeIndex(j),
+            "",
+            !hierarchy.size(),
+            &hedge);
+
+        // Track changes, so that only modified files are rewritten.
+        hierarchy.track();
     }
 
     // Now, analyze the incoming `input` if needed.
     StringList inputs = resolve(config::getInput(j), *endpoints.arbiter);
-    const auto exists = [&manifest](std::string path)
+    std::unordered_set<std::string> existing;
+    existing.reserve(manifest.size());
+    for (const auto& item : manifest) existing.insert(item.source.path);
+    const auto exists = [&existing](const std::string& path)
     {
-        return std::any_of(
-            manifest.begin(),
-            manifest.end(),
-            [path](const BuildItem& b) { return b.source.path == path; });
+        return existing.count(path) > 0;
     };
     // Remove any inputs we already have in our manifest prior to analysis.
     inputs.erase(
         std::remove_if(inputs.begin(), inputs.end(), exists),
         inputs.end());
+    const uint64_t loaded = manifest.size();
     const SourceList sources = analyze(
         inputs,
         config::getPipeline(j),
@@ -597,7 +1127,9 @@ Builder create(json j)
         config::getTmp(j),
         *endpoints.arbiter,
         threads,
-        verbose);
+        verbose,
+        config::getAnalysisCache(j),
+        config::getAnalysisCacheRemote(j));
     for (const auto& source : sources)
     {
         if (source.info.points) manifest.emplace_back(source);
@@ -610,31 +1142,79 @@ Builder create(json j)
     j = merge(analysis, j);
     const Metadata metadata = config::getMetadata(j);
 
-    return Builder(endpoints, metadata, manifest, hierarchy, verbose);
+    Builder builder(
+        endpoints,
+        metadata,
+        manifest,
+        hierarchy,
+        verbose,
+        savedStep,
+        nodeStats,
+        timeIndex);
+
+    // Newly analyzed sources have never been saved.  If the binary manifest
+    // has only just been enabled, none of its details shards exist yet.
+    const uint64_t saved =
+        metadata.internal.binaryManifest && !fromBinary ? 0 : loaded;
+    for (uint64_t origin = saved; origin < manifest.size(); ++origin)
+    {
+        builder.changed.insert(origin);
+    }
+    return builder;
 }
 
 uint64_t run(Builder& builder, const json config)
 {
-    return builder.run(
+    const uint64_t points = builder.run(
         config::getCompoundThreads(config),
         config::getLimit(config),
         config::getProgressInterval(config));
+
+    const std::string copcPath = config::getCopc(config);
+    if (copcPath.empty()) return points;
+
+    // A COPC file holds the entire dataset, so it is only written once the
+    // build is complete.  For subset builds, the merge writes it.
+    const bool done = std::all_of(
+        builder.manifest.begin(),
+        builder.manifest.end(),
+        isSettled);
+    if (done && !builder.metadata.subset)
+    {
+        copc::write(builder, copcPath, config::getThreads(config));
+    }
+    else if (builder.verbose)
+    {
+        std::cout << "Build incomplete - not writing COPC output" << std::endl;
+    }
+
+    return points;
 }
 
 void merge(const json config)
 {
-    merge(
-        config::getEndpoints(config),
-        config::getThreads(config),
+    const Endpoints endpoints = config::getEndpoints(config);
+    const unsigned threads = config::getThreads(config);
+    const bool verbose = config::getVerbose(config);
+    const uint64_t hierarchyCacheSize = config::getHierarchyCacheSize(config);
+
+    const Builder builder = merge(
+        endpoints,
+        threads,
         config::getForce(config),
-        config::getVerbose(config));
+        verbose,
+        hierarchyCacheSize);
+
+    const std::string copcPath = config::getCopc(config);
+    if (copcPath.size()) copc::write(builder, copcPath, threads);
 }
 
-void merge(
+Builder merge(
     const Endpoints endpoints,
     const unsigned threads,
     const bool force,
-    const bool verbose)
+    const bool verbose,
+    const uint64_t hierarchyCacheSize)
 {
     if (!force && endpoints.output.tryGetSize("ept.json"))
     {
@@ -649,7 +1229,8 @@ void merge(
     }
 
     if (verbose) std::cout << "Initializing" << std::endl;
-    const Builder base = builder::load(endpoints, threads, 1, verbose);
+    const Builder base =
+        builder::load(endpoints, threads, 1, verbose, hierarchyCacheSize);
 
     // Grab the total number of subsets, then clear the subsetting from our
     // metadata aggregator which will represent our merged output.
@@ -659,13 +1240,20 @@ void merge(
 
     Manifest manifest = base.manifest;
 
-    Builder builder(endpoints, metadata, manifest, Hierarchy(), verbose);
+    Builder builder(
+        endpoints,
+        metadata,
+        manifest,
+        Hierarchy(getSpill(endpoints, hierarchyCacheSize)),
+        verbose);
     ChunkCache cache(
         endpoints, 
         builder.metadata, 
         *builder.io, 
         builder.hierarchy, 
-        threads);
+        threads,
+        builder.nodeStats.get(),
+        builder.timeIndex.get());
 
     if (verbose) std::cout << "Merging" << std::endl;
 
@@ -682,6 +1270,7 @@ void merge(
                 &endpoints,
                 threads,
                 verbose,
+                hierarchyCacheSize,
                 id,
                 &builder,
                 &cache,
@@ -691,7 +1280,8 @@ void merge(
                     endpoints,
                     threads,
                     id,
-                    verbose);
+                    verbose,
+                    hierarchyCacheSize);
                 builder::mergeOne(builder, current, cache);
 
                 // Our base builder contains the manifest of subset 1 so we
@@ -713,6 +1303,8 @@ void merge(
 
     builder.save(threads);
     if (verbose) std::cout << "Done" << std::endl;
+
+    return builder;
 }
 
 void mergeOne(Builder& dst, const Builder& src, ChunkCache& cache)
@@ -725,7 +1317,7 @@ void mergeOne(Builder& dst, const Builder& src, ChunkCache& cache)
 
     Clipper clipper(cache);
     const auto sharedDepth = getSharedDepth(src.metadata);
-    for (const auto& node : src.hierarchy.map)
+    for (const auto& node : src.hierarchy.nodes())
     {
         const Dxyz& key = node.first;
         const uint64_t count = node.second;
@@ -735,6 +1327,22 @@ void mergeOne(Builder& dst, const Builder& src, ChunkCache& cache)
         {
             assert(!hierarchy::get(dst.hierarchy, key));
             hierarchy::set(dst.hierarchy, key, count);
+
+            // Nodes which are copied as they are keep their stats, while
+            // shared nodes gather theirs as they are rewritten.
+            NodeStats stats;
+            if (dst.nodeStats && src.nodeStats &&
+                src.nodeStats->find(key, stats))
+            {
+                dst.nodeStats->set(key, stats);
+            }
+
+            TimeIndex::Entry times;
+            if (dst.timeIndex && src.timeIndex &&
+                src.timeIndex->find(key, times))
+            {
+                dst.timeIndex->set(key, times);
+            }
         }
         else
         {
@@ -11,19 +11,25 @@
 #pragma once
 
 #include <atomic>
+#include <memory>
+#include <set>
 #include <string>
 
 #include <entwine/builder/chunk-cache.hpp>
 #include <entwine/builder/hierarchy.hpp>
+#include <entwine/builder/time-index.hpp>
 #include <entwine/types/endpoints.hpp>
 #include <entwine/types/metadata.hpp>
 #include <entwine/types/source.hpp>
 #include <entwine/types/threads.hpp>
 #include <entwine/util/json.hpp>
+#include <entwine/util/optional.hpp>
 
 namespace entwine
 {
 
+class Prefetcher;
+
 struct Builder
 {
     Builder(
@@ -31,7 +37,10 @@ struct Builder
         Metadata metadata,
         Manifest manifest,
         Hierarchy hierarchy = Hierarchy(),
-        bool verbose = true);
+        bool verbose = true,
+        optional<unsigned> savedStep = optional<unsigned>(),
+        std::shared_ptr<NodeStatsMap> nodeStats = nullptr,
+        std::shared_ptr<TimeIndex> timeIndex = nullptr);
 
     uint64_t run(
         Threads threads,
@@ -49,17 +58,25 @@ struct Builder
         std::atomic_uint64_t& counter);
     void tryInsert(
         ChunkCache& cache,
+        Prefetcher& prefetcher,
         uint64_t origin,
         std::atomic_uint64_t& counter);
     void insert(
         ChunkCache& cache,
+        Prefetcher& prefetcher,
         uint64_t origin,
         std::atomic_uint64_t& counter);
     void save(unsigned threads);
 
     void saveHierarchy(unsigned threads);
+    void saveHierarchyFiles(
+        unsigned step,
+        const std::vector<Dxyz>& roots,
+        bool incremental,
+        unsigned threads);
     void saveSources(unsigned threads);
-    void saveMetadata();
+    void saveTimeIndex();
+    void saveMetadata(unsigned threads);
 
     Endpoints endpoints;
     Metadata metadata;
@@ -68,6 +85,17 @@ struct Builder
     Manifest manifest;
     Hierarchy hierarchy;
     bool verbose = true;
+
+    // The origins whose metadata has changed during this run, and for a
+    // continued build, the step with which its hierarchy files were split, if
+    // known.  Only the files of changed sources, and of changed hierarchy
+    // nodes if the hierarchy is tracking them, are rewritten.
+    std::set<Origin> changed;
+    optional<unsigned> savedStep;
+
+    // Present if node stats, or the time index, are enabled.
+    std::shared_ptr<NodeStatsMap> nodeStats;
+    std::shared_ptr<TimeIndex> timeIndex;
 };
 
 namespace builder
@@ -77,16 +105,20 @@ Builder load(
     Endpoints endpoints,
     unsigned threads,
     unsigned subsetId,
-    bool verbose = true);
+    bool verbose = true,
+    uint64_t hierarchyCacheSize = 0);
 Builder create(json config);
 uint64_t run(Builder& builder, json config);
 
 void merge(json config);
-void merge(
+
+// Returns the merged, saved, builder.
+Builder merge(
     Endpoints endpoints,
     unsigned threads,
     bool force = false,
-    bool verbose = true);
+    bool verbose = true,
+    uint64_t hierarchyCacheSize = 0);
 void mergeOne(Builder& dst, const Builder& src, ChunkCache& cache);
 
 } // namespace builder
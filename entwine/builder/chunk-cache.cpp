@@ -35,11 +35,15 @@ ChunkCache::ChunkCache(
     const Metadata& metadata,
     const Io& io,
     Hierarchy& hierarchy,
-    const uint64_t threads)
+    const uint64_t threads,
+    NodeStatsMap* stats,
+    TimeIndex* timeIndex)
     : m_endpoints(endpoints)
     , m_metadata(metadata)
     , m_io(io)
     , m_hierarchy(hierarchy)
+    , m_stats(stats)
+    , m_timeIndex(timeIndex)
     , m_pool(threads)
 { }
 
@@ -52,6 +56,16 @@ void ChunkCache::join()
 {
     maybePurge(0);
     m_pool.join();
+
+    try
+    {
+        m_io.flush();
+    }
+    catch (std::exception& e)
+    {
+        std::lock_guard<std::mutex> lock(m_errorsMutex);
+        m_errors.push_back(e.what());
+    }
 }
 
 bool ChunkCache::insert(
@@ -322,8 +336,17 @@ void ChunkCache::maybeSerialize(const Dxyz& dxyz)
         ++info.written;
     }
 
-    const uint64_t np = ref.chunk().save(m_endpoints);
-    hierarchy::set(m_hierarchy, ref.chunk().chunkKey().get(), np);
+    NodeStats stats;
+    TimeIndex::Entry times;
+    const uint64_t np = ref.chunk().save(
+        m_endpoints,
+        m_stats ? &stats : nullptr,
+        m_timeIndex ? &times : nullptr);
+
+    const Dxyz key(ref.chunk().chunkKey().get());
+    hierarchy::set(m_hierarchy, key, np);
+    if (m_stats) m_stats->set(key, stats);
+    if (m_timeIndex) m_timeIndex->set(key, times);
     assert(np);
 
     // Cannot erase this chunk here, since we haven't been holding the
@@ -79,7 +79,9 @@ public:
         const Metadata& Metadata,
         const Io& io,
         Hierarchy& hierarchy,
-        uint64_t threads);
+        uint64_t threads,
+        NodeStatsMap* stats = nullptr,
+        TimeIndex* timeIndex = nullptr);
 
     ~ChunkCache();
 
@@ -113,6 +115,8 @@ private:
     const Metadata& m_metadata;
     const Io& m_io;
     Hierarchy& m_hierarchy;
+    NodeStatsMap* m_stats;
+    TimeIndex* m_timeIndex;
     Pool m_pool;
     const uint64_t m_cacheSize = 64;
 
@@ -10,8 +10,11 @@
 
 #include <entwine/builder/chunk.hpp>
 
+#include <pdal/PointRef.hpp>
+
 #include <entwine/builder/chunk-cache.hpp>
 #include <entwine/io/io.hpp>
+#include <entwine/io/order.hpp>
 #include <entwine/types/metadata.hpp>
 #include <entwine/types/voxel.hpp>
 #include <entwine/util/unique.hpp>
@@ -19,6 +22,68 @@
 namespace entwine
 {
 
+namespace
+{
+
+// Gathers node stats from each point as it is written, so they need no pass
+// over the data of their own.  If times is given, its bins are marked too:
+// time indexed nodes are ordered by GpsTime, so the range of the bins is
+// known up front from the first and last points.
+class StatsVisitor : public PointVisitor
+{
+public:
+    StatsVisitor(BlockPointTable& table, TimeIndex::Entry* times)
+        : m_gpsTime(table.layout()->findDim("GpsTime"))
+        , m_intensity(table.layout()->findDim("Intensity"))
+        , m_classification(table.layout()->findDim("Classification"))
+        , m_times(m_gpsTime != DimId::Unknown && table.size() ? times : nullptr)
+    {
+        if (!m_times) return;
+
+        pdal::PointRef pr(table, 0);
+        Range range;
+        range.grow(pr.getFieldAs<double>(m_gpsTime));
+        pr.setPointId(table.size() - 1);
+        range.grow(pr.getFieldAs<double>(m_gpsTime));
+        *m_times = TimeIndex::create(range);
+    }
+
+    void visit(pdal::PointRef& pr) override
+    {
+        m_stats.bounds.grow(Point(
+            pr.getFieldAs<double>(DimId::X),
+            pr.getFieldAs<double>(DimId::Y),
+            pr.getFieldAs<double>(DimId::Z)));
+
+        if (m_gpsTime != DimId::Unknown)
+        {
+            const double t(pr.getFieldAs<double>(m_gpsTime));
+            m_stats.gpsTime.grow(t);
+            if (m_times) m_times->mark(t);
+        }
+        if (m_intensity != DimId::Unknown)
+        {
+            m_stats.intensity.grow(pr.getFieldAs<double>(m_intensity));
+        }
+        if (m_classification != DimId::Unknown)
+        {
+            m_stats.addClassification(
+                pr.getFieldAs<uint8_t>(m_classification));
+        }
+    }
+
+    const NodeStats& stats() const { return m_stats; }
+
+private:
+    const DimId m_gpsTime;
+    const DimId m_intensity;
+    const DimId m_classification;
+    TimeIndex::Entry* const m_times;
+    NodeStats m_stats;
+};
+
+} // unnamed namespace
+
 Chunk::Chunk(
     const Metadata& m, 
     const Io& io,
@@ -164,7 +229,10 @@ void Chunk::doOverflow(ChunkCache& cache, Clipper& clipper, uint64_t dir)
     }
 }
 
-uint64_t Chunk::save(const Endpoints& endpoints) const
+uint64_t Chunk::save(
+    const Endpoints& endpoints,
+    NodeStats* stats,
+    TimeIndex::Entry* times) const
 {
     uint64_t np(m_gridBlock.size());
     for (const auto& o : m_overflows) if (o) np += o->block.size();
@@ -173,18 +241,77 @@ uint64_t Chunk::save(const Endpoints& endpoints) const
         m_metadata.absoluteSchema, 
         m_metadata.dataType == io::Type::Laszip);
     BlockPointTable table(layout);
-    table.reserve(np);
-    table.insert(m_gridBlock);
-    for (auto& o : m_overflows) if (o) table.insert(o->block);
+
+    const io::Order order(io::getOrder(m_metadata));
+    if (io::isSpatial(order)) table.refs() = getSpatialRefs(order, np);
+    else
+    {
+        table.reserve(np);
+        table.insert(m_gridBlock);
+        for (auto& o : m_overflows) if (o) table.insert(o->block);
+
+        if (order == io::Order::GpsTime) io::order::sortByGpsTime(table);
+    }
 
     const auto filename =
         m_chunkKey.toString() + getPostfix(m_metadata, m_chunkKey.depth());
 
-    m_io.write(filename, table, m_chunkKey.bounds());
+    StatsVisitor visitor(table, times);
+    m_io.write(
+        filename,
+        table,
+        m_chunkKey.bounds(),
+        stats || times ? &visitor : nullptr);
+
+    if (stats) *stats = visitor.stats();
 
     return np;
 }
 
+std::vector<char*> Chunk::getSpatialRefs(
+    const io::Order order,
+    const uint64_t np) const
+{
+    std::vector<uint64_t> keys;
+    std::vector<char*> refs;
+    keys.reserve(np);
+    refs.reserve(np);
+
+    unsigned bits(0);
+    while ((uint64_t(1) << bits) < m_span) ++bits;
+
+    // Voxel positions are taken modulo the span, so they are relative to this
+    // node, matching the layout of our grid.
+    const auto add = [&](uint64_t x, uint64_t y, uint64_t z, const Voxel& v)
+    {
+        keys.push_back(io::order::toCode(order, x, y, z, bits));
+        refs.push_back(const_cast<char*>(v.data()));
+    };
+
+    for (uint64_t i(0); i < m_grid.size(); ++i)
+    {
+        const uint64_t x(i % m_span);
+        const uint64_t y(i / m_span);
+        for (const auto& p : m_grid[i].map)
+        {
+            add(x, y, p.first % m_span, p.second);
+        }
+    }
+
+    for (const auto& o : m_overflows)
+    {
+        if (!o) continue;
+        for (const auto& entry : o->list)
+        {
+            const Xyz& pos(entry.key.position());
+            add(pos.x % m_span, pos.y % m_span, pos.z % m_span, entry.voxel);
+        }
+    }
+
+    io::order::sort(keys, refs);
+    return refs;
+}
+
 void Chunk::load(
         ChunkCache& cache,
         Clipper& clipper,
@@ -16,7 +16,9 @@
 
 #include <entwine/builder/hierarchy.hpp>
 #include <entwine/builder/overflow.hpp>
+#include <entwine/builder/time-index.hpp>
 #include <entwine/io/io.hpp>
+#include <entwine/io/order.hpp>
 #include <entwine/third/arbiter/arbiter.hpp>
 #include <entwine/types/endpoints.hpp>
 #include <entwine/types/vector-point-table.hpp>
@@ -44,7 +46,13 @@ public:
         const Hierarchy& hierarchy);
 
     bool insert(ChunkCache& cache, Clipper& clipper, Voxel& voxel, Key& key);
-    uint64_t save(const Endpoints& endpoints) const;
+    // If stats is given, the tight bounds and attribute ranges of the saved
+    // points are gathered into it, and if times is given, their time index
+    // entry is created, as the points are written.
+    uint64_t save(
+        const Endpoints& endpoints,
+        NodeStats* stats = nullptr,
+        TimeIndex::Entry* times = nullptr) const;
     void load(
         ChunkCache& cache,
         Clipper& clipper,
@@ -67,6 +75,9 @@ private:
         Key& key);
 
     void maybeOverflow(ChunkCache& cache, Clipper& clipper);
+
+    // Point references of this node sorted along a spatial curve.
+    std::vector<char*> getSpatialRefs(io::Order order, uint64_t np) const;
     void doOverflow(ChunkCache& cache, Clipper& clipper, uint64_t dir);
 
     const Metadata& m_metadata;
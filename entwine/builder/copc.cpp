@@ -0,0 +1,1077 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/builder/copc.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef ENTWINE_HAVE_LASZIP
+#include <laszip/laszip_api.h>
+#endif
+
+#include <entwine/builder/builder.hpp>
+#include <entwine/builder/native-reader.hpp>
+#include <entwine/types/defs.hpp>
+#include <entwine/types/dimension.hpp>
+#include <entwine/types/exceptions.hpp>
+#include <entwine/types/metadata.hpp>
+#include <entwine/types/vector-point-table.hpp>
+#include <entwine/util/pool.hpp>
+#include <entwine/util/time.hpp>
+
+namespace entwine
+{
+namespace copc
+{
+
+#ifndef ENTWINE_HAVE_LASZIP
+
+void write(const Builder&, std::string, unsigned)
+{
+    throw ConfigurationError("COPC output requires LASzip support");
+}
+
+#else
+
+namespace
+{
+
+// The LAZ chunk table is compressed with LASzip's arithmetic coder, which is
+// not exposed by its API, so this is the subset of it needed to encode one.
+// The semantics here must match LASzip exactly.
+constexpr uint32_t minLength = 0x01000000u;
+constexpr uint32_t maxLength = 0xffffffffu;
+constexpr uint32_t bitLengthShift = 13;
+constexpr uint32_t bitMaxCount = 1u << bitLengthShift;
+constexpr uint32_t symbolLengthShift = 15;
+constexpr uint32_t symbolMaxCount = 1u << symbolLengthShift;
+
+struct BitModel
+{
+    void update()
+    {
+        if ((bitCount += updateCycle) > bitMaxCount)
+        {
+            bitCount = (bitCount + 1) >> 1;
+            bit0Count = (bit0Count + 1) >> 1;
+            if (bit0Count == bitCount) ++bitCount;
+        }
+
+        const uint32_t scale(0x80000000u / bitCount);
+        bit0Prob = (bit0Count * scale) >> (31 - bitLengthShift);
+
+        updateCycle = std::min<uint32_t>((5 * updateCycle) >> 2, 64);
+        bitsUntilUpdate = updateCycle;
+    }
+
+    uint32_t bit0Count = 1;
+    uint32_t bitCount = 2;
+    uint32_t bit0Prob = 1u << (bitLengthShift - 1);
+    uint32_t updateCycle = 4;
+    uint32_t bitsUntilUpdate = 4;
+};
+
+struct SymbolModel
+{
+    explicit SymbolModel(const uint32_t symbols)
+        : symbols(symbols)
+        , lastSymbol(symbols - 1)
+        , distribution(symbols)
+        , counts(symbols, 1)
+        , updateCycle(symbols)
+    {
+        update();
+        symbolsUntilUpdate = updateCycle = (symbols + 6) >> 1;
+    }
+
+    void update()
+    {
+        if ((totalCount += updateCycle) > symbolMaxCount)
+        {
+            totalCount = 0;
+            for (uint32_t& c : counts) totalCount += (c = (c + 1) >> 1);
+        }
+
+        const uint32_t scale(0x80000000u / totalCount);
+        uint32_t sum(0);
+        for (uint32_t k(0); k < symbols; ++k)
+        {
+            distribution[k] = (scale * sum) >> (31 - symbolLengthShift);
+            sum += counts[k];
+        }
+
+        updateCycle = std::min((5 * updateCycle) >> 2, (symbols + 6) << 3);
+        symbolsUntilUpdate = updateCycle;
+    }
+
+    uint32_t symbols;
+    uint32_t lastSymbol;
+    std::vector<uint32_t> distribution;
+    std::vector<uint32_t> counts;
+    uint32_t totalCount = 0;
+    uint32_t updateCycle;
+    uint32_t symbolsUntilUpdate = 0;
+};
+
+class Encoder
+{
+public:
+    void encodeBit(BitModel& m, const uint32_t bit)
+    {
+        const uint32_t x(m.bit0Prob * (m_length >> bitLengthShift));
+        if (!bit)
+        {
+            m_length = x;
+            ++m.bit0Count;
+        }
+        else
+        {
+            const uint32_t init(m_base);
+            m_base += x;
+            m_length -= x;
+            if (init > m_base) carry();
+        }
+
+        if (m_length < minLength) renormalize();
+        if (--m.bitsUntilUpdate == 0) m.update();
+    }
+
+    void encodeSymbol(SymbolModel& m, const uint32_t s)
+    {
+        const uint32_t init(m_base);
+        if (s == m.lastSymbol)
+        {
+            const uint32_t x(m.distribution[s] * (m_length >> symbolLengthShift));
+            m_base += x;
+            m_length -= x;
+        }
+        else
+        {
+            m_length >>= symbolLengthShift;
+            const uint32_t x(m.distribution[s] * m_length);
+            m_base += x;
+            m_length = m.distribution[s + 1] * m_length - x;
+        }
+
+        if (init > m_base) carry();
+        if (m_length < minLength) renormalize();
+
+        ++m.counts[s];
+        if (--m.symbolsUntilUpdate == 0) m.update();
+    }
+
+    void writeBits(uint32_t bits, uint32_t s)
+    {
+        if (bits > 19)
+        {
+            writeRaw(16, s & 0xffff);
+            s >>= 16;
+            bits -= 16;
+        }
+        writeRaw(bits, s);
+    }
+
+    std::vector<char> done()
+    {
+        const uint32_t init(m_base);
+        bool another(true);
+        if (m_length > 2 * minLength)
+        {
+            m_base += minLength;
+            m_length = minLength >> 1;
+        }
+        else
+        {
+            m_base += minLength >> 1;
+            m_length = minLength >> 9;
+            another = false;
+        }
+
+        if (init > m_base) carry();
+        renormalize();
+
+        m_out.push_back(0);
+        m_out.push_back(0);
+        if (another) m_out.push_back(0);
+        return std::move(m_out);
+    }
+
+private:
+    void writeRaw(const uint32_t bits, const uint32_t s)
+    {
+        const uint32_t init(m_base);
+        m_length >>= bits;
+        m_base += s * m_length;
+        if (init > m_base) carry();
+        if (m_length < minLength) renormalize();
+    }
+
+    void carry()
+    {
+        auto i(m_out.size());
+        while (i && static_cast<uint8_t>(m_out[i - 1]) == 0xff) m_out[--i] = 0;
+        if (i) ++m_out[i - 1];
+    }
+
+    void renormalize()
+    {
+        do
+        {
+            m_out.push_back(static_cast<char>(m_base >> 24));
+            m_base <<= 8;
+        }
+        while ((m_length <<= 8) < minLength);
+    }
+
+    uint32_t m_base = 0;
+    uint32_t m_length = maxLength;
+    std::vector<char> m_out;
+};
+
+// LASzip's IntegerCompressor with 32 bits and the default high-bit count.
+class IntegerCompressor
+{
+    static constexpr uint32_t bitsHigh = 8;
+
+public:
+    IntegerCompressor(Encoder& encoder, const uint32_t contexts)
+        : m_encoder(encoder)
+    {
+        for (uint32_t i(0); i < contexts; ++i) m_bits.emplace_back(33);
+        for (uint32_t i(1); i <= 32; ++i)
+        {
+            m_correctors.emplace_back(1u << std::min(i, bitsHigh));
+        }
+    }
+
+    void compress(const int32_t pred, const int32_t real, const uint32_t ctx)
+    {
+        const int32_t c(static_cast<int32_t>(
+                static_cast<uint32_t>(real) - static_cast<uint32_t>(pred)));
+        const uint32_t magnitude(c <= 0
+                ? 0u - static_cast<uint32_t>(c)
+                : static_cast<uint32_t>(c) - 1);
+
+        uint32_t k(0);
+        for (uint32_t v(magnitude); v; v >>= 1) ++k;
+        m_encoder.encodeSymbol(m_bits.at(ctx), k);
+
+        if (!k)
+        {
+            m_encoder.encodeBit(m_zero, static_cast<uint32_t>(c));
+            return;
+        }
+        if (k == 32) return;
+
+        const uint32_t v(c < 0
+                ? static_cast<uint32_t>(int64_t(c) + ((int64_t(1) << k) - 1))
+                : static_cast<uint32_t>(c - 1));
+
+        SymbolModel& corrector(m_correctors[k - 1]);
+        if (k <= bitsHigh) m_encoder.encodeSymbol(corrector, v);
+        else
+        {
+            const uint32_t low(k - bitsHigh);
+            m_encoder.encodeSymbol(corrector, v >> low);
+            m_encoder.writeBits(low, v & ((1u << low) - 1));
+        }
+    }
+
+private:
+    Encoder& m_encoder;
+    std::vector<SymbolModel> m_bits;
+    BitModel m_zero;
+    std::vector<SymbolModel> m_correctors;
+};
+
+// Little-endian serialization of the LAS structures we write ourselves.
+class Buffer
+{
+public:
+    template <typename T>
+    void put(const T v)
+    {
+        const char* p(reinterpret_cast<const char*>(&v));
+        m_data.insert(m_data.end(), p, p + sizeof(T));
+    }
+
+    void put(const std::string& s, const std::size_t size)
+    {
+        std::string padded(s.substr(0, size));
+        padded.resize(size, '\0');
+        m_data.insert(m_data.end(), padded.begin(), padded.end());
+    }
+
+    void put(const std::vector<char>& v)
+    {
+        m_data.insert(m_data.end(), v.begin(), v.end());
+    }
+
+    void vlr(
+        const std::string user,
+        const uint16_t record,
+        const std::vector<char>& payload)
+    {
+        if (payload.size() > std::numeric_limits<uint16_t>::max())
+        {
+            throw std::runtime_error("VLR too large: " + user);
+        }
+
+        put<uint16_t>(0);
+        put(user, 16);
+        put<uint16_t>(record);
+        put<uint16_t>(payload.size());
+        put(std::string(), 32);
+        put(payload);
+    }
+
+    std::vector<char>& data() { return m_data; }
+
+private:
+    std::vector<char> m_data;
+};
+
+template <typename T>
+T peek(const std::vector<char>& data, const std::size_t pos)
+{
+    if (pos + sizeof(T) > data.size())
+    {
+        throw std::runtime_error("Invalid LAZ chunk data");
+    }
+
+    T v;
+    std::memcpy(&v, data.data() + pos, sizeof(T));
+    return v;
+}
+
+const std::vector<std::string> standardDimensions(getNativeDimensions(8));
+
+bool isStandard(const std::string& name)
+{
+    return std::find(
+            standardDimensions.begin(),
+            standardDimensions.end(),
+            name) != standardDimensions.end();
+}
+
+uint8_t getExtraBytesType(const Type type)
+{
+    switch (type)
+    {
+        case Type::Unsigned8:   return 1;
+        case Type::Signed8:     return 2;
+        case Type::Unsigned16:  return 3;
+        case Type::Signed16:    return 4;
+        case Type::Unsigned32:  return 5;
+        case Type::Signed32:    return 6;
+        case Type::Unsigned64:  return 7;
+        case Type::Signed64:    return 8;
+        case Type::Float:       return 9;
+        case Type::Double:      return 10;
+        default: throw std::runtime_error("Invalid extra-bytes type");
+    }
+}
+
+// Totals for the LAS header, accumulated per node and then combined.
+struct Summary
+{
+    void add(const Summary& b)
+    {
+        points += b.points;
+        for (std::size_t i(0); i < 3; ++i)
+        {
+            min[i] = std::min(min[i], b.min[i]);
+            max[i] = std::max(max[i], b.max[i]);
+        }
+        for (std::size_t i(0); i < returns.size(); ++i)
+        {
+            returns[i] += b.returns[i];
+        }
+        gpsMin = std::min(gpsMin, b.gpsMin);
+        gpsMax = std::max(gpsMax, b.gpsMax);
+    }
+
+    uint64_t points = 0;
+    std::array<double, 3> min { {
+        std::numeric_limits<double>::max(),
+        std::numeric_limits<double>::max(),
+        std::numeric_limits<double>::max() } };
+    std::array<double, 3> max { {
+        std::numeric_limits<double>::lowest(),
+        std::numeric_limits<double>::lowest(),
+        std::numeric_limits<double>::lowest() } };
+    std::array<uint64_t, 15> returns { { } };
+    double gpsMin = std::numeric_limits<double>::max();
+    double gpsMax = std::numeric_limits<double>::lowest();
+};
+
+struct Chunk
+{
+    // Compressed point data, without the leading chunk table offset.
+    std::vector<char> data;
+
+    // The payload of the LASzip VLR describing the encoding.
+    std::vector<char> laszip;
+
+    Summary summary;
+};
+
+struct Entry
+{
+    Dxyz key;
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    uint64_t points = 0;
+};
+
+class Writer
+{
+public:
+    Writer(const Builder& builder)
+        : m_metadata(builder.metadata)
+        , m_io(*builder.io)
+        , m_layout(toLayout(
+                m_metadata.absoluteSchema,
+                m_metadata.dataType == io::Type::Laszip))
+    {
+        const Schema& schema(m_metadata.absoluteSchema);
+
+        const bool hasColor(contains(schema, "Red"));
+        m_format = contains(schema, "Infrared") ? 8 : hasColor ? 7 : 6;
+        m_recordLength = m_format == 8 ? 38 : m_format == 7 ? 36 : 30;
+
+        for (const auto& dim : schema)
+        {
+            if (isStandard(dim.name)) continue;
+
+            const DimId id(m_layout.findDim(dim.name));
+            m_extras.push_back(id);
+            m_recordLength += m_layout.dimSize(id);
+
+            Buffer eb;
+            eb.put<uint16_t>(0);
+            eb.put<uint8_t>(getExtraBytesType(m_layout.dimType(id)));
+            eb.put<uint8_t>(0);
+            eb.put(dim.name, 32);
+            eb.put(std::string(), 4 + 24 * 5);
+            eb.put(std::string(), 32);
+            m_extraBytes.insert(
+                m_extraBytes.end(),
+                eb.data().begin(),
+                eb.data().end());
+        }
+
+        if (const auto so = getScaleOffset(m_metadata.schema))
+        {
+            m_scale = so->scale;
+            m_offset = so->offset;
+        }
+        else
+        {
+            m_scale = Scale(0.01);
+            m_offset = m_metadata.bounds.mid();
+        }
+
+        const auto find([this](const std::string& name)
+        {
+            return m_layout.findDim(name);
+        });
+        m_dims.returnNumber = find("ReturnNumber");
+        m_dims.numberOfReturns = find("NumberOfReturns");
+        m_dims.intensity = find("Intensity");
+        m_dims.scanDirectionFlag = find("ScanDirectionFlag");
+        m_dims.edgeOfFlightLine = find("EdgeOfFlightLine");
+        m_dims.classification = find("Classification");
+        m_dims.classFlags = find("ClassFlags");
+        m_dims.synthetic = find("Synthetic");
+        m_dims.keyPoint = find("KeyPoint");
+        m_dims.withheld = find("Withheld");
+        m_dims.overlap = find("Overlap");
+        m_dims.scanChannel = find("ScanChannel");
+        m_dims.scanAngleRank = find("ScanAngleRank");
+        m_dims.userData = find("UserData");
+        m_dims.pointSourceId = find("PointSourceId");
+        m_dims.gpsTime = find("GpsTime");
+        m_dims.red = find("Red");
+        m_dims.green = find("Green");
+        m_dims.blue = find("Blue");
+        m_dims.infrared = find("Infrared");
+    }
+
+    Chunk encode(const Dxyz& key, const uint64_t count) const
+    {
+        laszip_POINTER laszip(nullptr);
+        if (laszip_create(&laszip)) throw std::runtime_error("LASzip failed");
+
+        try
+        {
+            Chunk chunk(encode(laszip, key, count));
+            laszip_destroy(laszip);
+            return chunk;
+        }
+        catch (...)
+        {
+            laszip_destroy(laszip);
+            throw;
+        }
+    }
+
+    uint8_t format() const { return m_format; }
+    uint16_t recordLength() const { return m_recordLength; }
+    const Scale& scale() const { return m_scale; }
+    const Offset& offset() const { return m_offset; }
+    const std::vector<char>& extraBytes() const { return m_extraBytes; }
+    bool hasTime() const { return m_dims.gpsTime != DimId::Unknown; }
+
+private:
+    static void check(laszip_POINTER laszip, const laszip_I32 code)
+    {
+        if (!code) return;
+
+        laszip_CHAR* error(nullptr);
+        laszip_get_error(laszip, &error);
+        throw std::runtime_error(
+            std::string("LASzip: ") + (error ? error : "unknown error"));
+    }
+
+    Chunk encode(
+        laszip_POINTER laszip,
+        const Dxyz& key,
+        const uint64_t count) const
+    {
+        laszip_header* header(nullptr);
+        check(laszip, laszip_get_header_pointer(laszip, &header));
+
+        header->version_major = 1;
+        header->version_minor = 4;
+        header->header_size = 375;
+        header->offset_to_point_data = 375;
+        header->point_data_format = m_format;
+        header->point_data_record_length = m_recordLength;
+        header->number_of_point_records = 0;
+        header->extended_number_of_point_records = count;
+        header->x_scale_factor = m_scale.x;
+        header->y_scale_factor = m_scale.y;
+        header->z_scale_factor = m_scale.z;
+        header->x_offset = m_offset.x;
+        header->y_offset = m_offset.y;
+        header->z_offset = m_offset.z;
+
+        // One chunk per node: the chunk size is later marked as variable.
+        check(laszip, laszip_set_chunk_size(
+                    laszip,
+                    std::max<uint64_t>(count, 1)));
+
+        std::ostringstream os(std::ios::out | std::ios::binary);
+        check(laszip, laszip_open_writer_stream(laszip, os, 1, 0));
+
+        laszip_point* point(nullptr);
+        check(laszip, laszip_get_point_pointer(laszip, &point));
+
+        Chunk chunk;
+        Summary& summary(chunk.summary);
+
+        auto layout(m_layout);
+        VectorPointTable table(layout, count);
+        table.setProcess([&]()
+        {
+            for (auto it(table.begin()); it != table.end(); ++it)
+            {
+                fill(*point, it.pointRef(), it.data(), summary);
+                check(laszip, laszip_write_point(laszip));
+                ++summary.points;
+            }
+        });
+        m_io.read(key.toString() + getPostfix(m_metadata, key.d), table);
+
+        check(laszip, laszip_close_writer(laszip));
+
+        if (summary.points != count)
+        {
+            throw std::runtime_error(
+                "Unexpected point count in " + key.toString() + ": " +
+                std::to_string(summary.points) + " != " +
+                std::to_string(count));
+        }
+
+        // Pick out the chunk, which follows the chunk table offset at the
+        // start of the point data and precedes the chunk table itself.
+        const std::string s(os.str());
+        const std::vector<char> data(s.begin(), s.end());
+
+        const uint16_t headerSize(peek<uint16_t>(data, 94));
+        const uint32_t pointOffset(peek<uint32_t>(data, 96));
+        const uint32_t vlrs(peek<uint32_t>(data, 100));
+        const int64_t tableOffset(peek<int64_t>(data, pointOffset));
+
+        if (tableOffset <= pointOffset + 8 || uint64_t(tableOffset) > s.size())
+        {
+            throw std::runtime_error("Invalid LAZ chunk table offset");
+        }
+
+        chunk.data.assign(
+            data.begin() + pointOffset + 8,
+            data.begin() + tableOffset);
+
+        uint64_t pos(headerSize);
+        for (uint32_t i(0); i < vlrs; ++i)
+        {
+            const std::string user(data.data() + pos + 2, 16);
+            const uint16_t record(peek<uint16_t>(data, pos + 18));
+            const uint16_t length(peek<uint16_t>(data, pos + 20));
+            pos += 54;
+
+            if (user.c_str() == std::string("laszip encoded") &&
+                record == 22204)
+            {
+                if (pos + length > data.size() || length < 16)
+                {
+                    throw std::runtime_error("Invalid LASzip VLR");
+                }
+
+                chunk.laszip.assign(
+                    data.begin() + pos,
+                    data.begin() + pos + length);
+
+                // Mark the chunking as variable-sized.
+                const uint32_t variable(std::numeric_limits<uint32_t>::max());
+                std::memcpy(chunk.laszip.data() + 12, &variable, 4);
+            }
+            pos += length;
+        }
+
+        if (chunk.laszip.empty())
+        {
+            throw std::runtime_error("Failed to find LASzip VLR");
+        }
+
+        return chunk;
+    }
+
+    double get(const pdal::PointRef& pr, const DimId id) const
+    {
+        return id == DimId::Unknown ? 0 : pr.getFieldAs<double>(id);
+    }
+
+    int32_t quantize(const double v, const std::size_t i) const
+    {
+        const double q(std::round((v - m_offset[i]) / m_scale[i]));
+        if (
+            q < std::numeric_limits<int32_t>::lowest() ||
+            q > std::numeric_limits<int32_t>::max())
+        {
+            throw std::runtime_error("Coordinate out of range for scale");
+        }
+        return static_cast<int32_t>(q);
+    }
+
+    void fill(
+        laszip_point& p,
+        const pdal::PointRef& pr,
+        const char* data,
+        Summary& summary) const
+    {
+        const std::array<double, 3> xyz { {
+            pr.getFieldAs<double>(DimId::X),
+            pr.getFieldAs<double>(DimId::Y),
+            pr.getFieldAs<double>(DimId::Z) } };
+
+        p.X = quantize(xyz[0], 0);
+        p.Y = quantize(xyz[1], 1);
+        p.Z = quantize(xyz[2], 2);
+
+        const std::array<int32_t, 3> q { { p.X, p.Y, p.Z } };
+        for (std::size_t i(0); i < 3; ++i)
+        {
+            const double v(q[i] * m_scale[i] + m_offset[i]);
+            summary.min[i] = std::min(summary.min[i], v);
+            summary.max[i] = std::max(summary.max[i], v);
+        }
+
+        const uint32_t ret(get(pr, m_dims.returnNumber));
+        const uint32_t rets(get(pr, m_dims.numberOfReturns));
+        p.extended_return_number = ret;
+        p.extended_number_of_returns = rets;
+        p.return_number = std::min<uint32_t>(ret, 7);
+        p.number_of_returns = std::min<uint32_t>(rets, 7);
+        if (ret >= 1 && ret <= 15) ++summary.returns[ret - 1];
+
+        p.intensity = get(pr, m_dims.intensity);
+        p.scan_direction_flag = get(pr, m_dims.scanDirectionFlag);
+        p.edge_of_flight_line = get(pr, m_dims.edgeOfFlightLine);
+
+        const uint32_t cls(get(pr, m_dims.classification));
+        p.extended_classification = cls;
+        p.classification = cls < 32 ? cls : 0;
+
+        const uint32_t flags(m_dims.classFlags != DimId::Unknown
+            ? uint32_t(get(pr, m_dims.classFlags))
+            : uint32_t(get(pr, m_dims.synthetic)) |
+                uint32_t(get(pr, m_dims.keyPoint)) << 1 |
+                uint32_t(get(pr, m_dims.withheld)) << 2 |
+                uint32_t(get(pr, m_dims.overlap)) << 3);
+        p.extended_classification_flags = flags & 0xf;
+        p.synthetic_flag = flags & 1;
+        p.keypoint_flag = (flags >> 1) & 1;
+        p.withheld_flag = (flags >> 2) & 1;
+
+        p.extended_point_type = 1;
+        p.extended_scanner_channel = get(pr, m_dims.scanChannel);
+
+        const double angle(get(pr, m_dims.scanAngleRank));
+        p.extended_scan_angle = std::round(angle / 0.006);
+        p.scan_angle_rank = std::max(-90.0, std::min(90.0, std::round(angle)));
+
+        p.user_data = get(pr, m_dims.userData);
+        p.point_source_ID = get(pr, m_dims.pointSourceId);
+
+        p.gps_time = get(pr, m_dims.gpsTime);
+        summary.gpsMin = std::min(summary.gpsMin, p.gps_time);
+        summary.gpsMax = std::max(summary.gpsMax, p.gps_time);
+
+        p.rgb[0] = get(pr, m_dims.red);
+        p.rgb[1] = get(pr, m_dims.green);
+        p.rgb[2] = get(pr, m_dims.blue);
+        p.rgb[3] = get(pr, m_dims.infrared);
+
+        laszip_U8* extra(p.extra_bytes);
+        for (const DimId id : m_extras)
+        {
+            const std::size_t size(m_layout.dimSize(id));
+            std::memcpy(extra, data + m_layout.dimOffset(id), size);
+            extra += size;
+        }
+    }
+
+    const Metadata& m_metadata;
+    const Io& m_io;
+    FixedPointLayout m_layout;
+
+    uint8_t m_format = 6;
+    uint16_t m_recordLength = 30;
+    std::vector<DimId> m_extras;
+    std::vector<char> m_extraBytes;
+
+    // The standard dimensions of our layout, any of which may be Unknown.
+    struct Dims
+    {
+        DimId returnNumber;
+        DimId numberOfReturns;
+        DimId intensity;
+        DimId scanDirectionFlag;
+        DimId edgeOfFlightLine;
+        DimId classification;
+        DimId classFlags;
+        DimId synthetic;
+        DimId keyPoint;
+        DimId withheld;
+        DimId overlap;
+        DimId scanChannel;
+        DimId scanAngleRank;
+        DimId userData;
+        DimId pointSourceId;
+        DimId gpsTime;
+        DimId red;
+        DimId green;
+        DimId blue;
+        DimId infrared;
+    };
+    Dims m_dims;
+
+    Scale m_scale;
+    Offset m_offset;
+};
+
+std::vector<char> makeChunkTable(const std::vector<Entry>& entries)
+{
+    Buffer buffer;
+    buffer.put<uint32_t>(0);
+    buffer.put<uint32_t>(entries.size());
+
+    if (entries.empty()) return buffer.data();
+
+    Encoder encoder;
+    IntegerCompressor ic(encoder, 2);
+
+    // Variable-sized chunks store their point counts as well as their sizes,
+    // each predicted from the previous chunk.
+    int32_t points(0);
+    int32_t bytes(0);
+    for (const Entry& entry : entries)
+    {
+        ic.compress(points, entry.points, 0);
+        ic.compress(bytes, entry.size, 1);
+        points = entry.points;
+        bytes = entry.size;
+    }
+
+    buffer.put(encoder.done());
+    return buffer.data();
+}
+
+std::vector<char> makeHeader(
+    const Writer& writer,
+    const Summary& summary,
+    const uint32_t pointOffset,
+    const uint32_t vlrs,
+    const uint64_t evlrOffset,
+    const bool hasWkt)
+{
+    const std::time_t now(std::time(nullptr));
+    const std::tm* tm(std::gmtime(&now));
+
+    Buffer b;
+    b.put("LASF", 4);
+    b.put<uint16_t>(0);
+    b.put<uint16_t>(hasWkt ? 0x10 : 0);
+    b.put(std::string(), 16);
+    b.put<uint8_t>(1);
+    b.put<uint8_t>(4);
+    b.put("Entwine", 32);
+    b.put("Entwine " + currentEntwineVersion().toString(), 32);
+    b.put<uint16_t>(tm ? tm->tm_yday + 1 : 0);
+    b.put<uint16_t>(tm ? tm->tm_year + 1900 : 0);
+    b.put<uint16_t>(375);
+    b.put<uint32_t>(pointOffset);
+    b.put<uint32_t>(vlrs);
+    b.put<uint8_t>(writer.format() | 0x80);
+    b.put<uint16_t>(writer.recordLength());
+    b.put<uint32_t>(0);
+    for (int i(0); i < 5; ++i) b.put<uint32_t>(0);
+    for (std::size_t i(0); i < 3; ++i) b.put<double>(writer.scale()[i]);
+    for (std::size_t i(0); i < 3; ++i) b.put<double>(writer.offset()[i]);
+    for (std::size_t i(0); i < 3; ++i)
+    {
+        b.put<double>(summary.max[i]);
+        b.put<double>(summary.min[i]);
+    }
+    b.put<uint64_t>(0);
+    b.put<uint64_t>(evlrOffset);
+    b.put<uint32_t>(1);
+    b.put<uint64_t>(summary.points);
+    for (const uint64_t n : summary.returns) b.put<uint64_t>(n);
+
+    assert(b.data().size() == 375);
+    return b.data();
+}
+
+} // unnamed namespace
+
+void write(const Builder& builder, const std::string path, unsigned threads)
+{
+    const Metadata& metadata(builder.metadata);
+    const Endpoints& endpoints(builder.endpoints);
+    const bool verbose(builder.verbose);
+
+    if (metadata.subset)
+    {
+        throw ConfigurationError(
+            "COPC output cannot be written for a subset - merge first");
+    }
+
+    std::vector<Entry> entries;
+    for (const auto& node : builder.hierarchy.nodes())
+    {
+        if (node.second <= 0) continue;
+        if (node.second > std::numeric_limits<int32_t>::max())
+        {
+            throw std::runtime_error("Node too large for COPC");
+        }
+
+        Entry entry;
+        entry.key = node.first;
+        entry.points = node.second;
+        entries.push_back(entry);
+    }
+
+    const auto root(std::find_if(
+        entries.begin(),
+        entries.end(),
+        [](const Entry& e) { return e.key == Dxyz(); }));
+    if (root == entries.end())
+    {
+        throw std::runtime_error("Cannot write COPC output without points");
+    }
+    std::iter_swap(entries.begin(), root);
+
+    const arbiter::Arbiter& a(*endpoints.arbiter);
+    const bool local(a.isLocal(path));
+    const std::string filename(local
+        ? arbiter::expandTilde(arbiter::stripProtocol(path))
+        : endpoints.tmp.prefixedRoot() + "copc-" +
+            arbiter::getBasename(path));
+    if (local) arbiter::mkdirp(arbiter::getDirname(filename));
+
+    if (verbose) std::cout << "Writing COPC: " << path << std::endl;
+    const auto start = now();
+
+    const Writer writer(builder);
+
+    // The root chunk is encoded first, since the VLRs it produces determine
+    // the size of our header and therefore the position of the first chunk.
+    const Chunk first(writer.encode(entries[0].key, entries[0].points));
+
+    const std::string wkt(metadata.srs ? metadata.srs->wkt() : "");
+    std::vector<char> wktPayload(wkt.begin(), wkt.end());
+    if (wktPayload.size()) wktPayload.push_back(0);
+
+    const uint32_t vlrs(
+        2 + (writer.extraBytes().size() ? 1 : 0) + (wkt.size() ? 1 : 0));
+    const uint32_t pointOffset(
+        375 +
+        54 + 160 +
+        54 + first.laszip.size() +
+        (writer.extraBytes().size() ? 54 + writer.extraBytes().size() : 0) +
+        (wktPayload.size() ? 54 + wktPayload.size() : 0));
+
+    std::fstream file(
+        filename,
+        std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.good()) throw std::runtime_error("Could not open " + filename);
+
+    std::mutex mutex;
+    Summary summary;
+    std::atomic_uint64_t next(pointOffset + 8);
+
+    const auto place = [&](Entry& entry, const Chunk& chunk)
+    {
+        entry.size = chunk.data.size();
+        entry.offset = next.fetch_add(entry.size);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        file.seekp(entry.offset);
+        file.write(chunk.data.data(), chunk.data.size());
+        if (!file.good()) throw std::runtime_error("Failed to write COPC");
+        summary.add(chunk.summary);
+    };
+
+    place(entries[0], first);
+
+    Pool pool(threads, threads, verbose);
+    for (auto it(entries.begin() + 1); it != entries.end(); ++it)
+    {
+        Entry& entry(*it);
+        pool.add([&]()
+        {
+            place(entry, writer.encode(entry.key, entry.points));
+        });
+    }
+    pool.join();
+
+    if (pool.errors().size())
+    {
+        throw std::runtime_error("COPC encoding failed: " + pool.errors()[0]);
+    }
+
+    // The chunk table must be ordered by position in the file.
+    std::sort(
+        entries.begin(),
+        entries.end(),
+        [](const Entry& a, const Entry& b) { return a.offset < b.offset; });
+
+    const uint64_t tableOffset(next);
+    const std::vector<char> table(makeChunkTable(entries));
+    const uint64_t evlrOffset(tableOffset + table.size());
+
+    // The hierarchy is written as a single page.
+    Buffer hierarchy;
+    for (const Entry& e : entries)
+    {
+        hierarchy.put<int32_t>(e.key.d);
+        hierarchy.put<int32_t>(e.key.p.x);
+        hierarchy.put<int32_t>(e.key.p.y);
+        hierarchy.put<int32_t>(e.key.p.z);
+        hierarchy.put<uint64_t>(e.offset);
+        hierarchy.put<int32_t>(e.size);
+        hierarchy.put<int32_t>(e.points);
+    }
+
+    Buffer evlr;
+    evlr.put<uint16_t>(0);
+    evlr.put("copc", 16);
+    evlr.put<uint16_t>(1000);
+    evlr.put<uint64_t>(hierarchy.data().size());
+    evlr.put("EPT hierarchy", 32);
+    evlr.put(hierarchy.data());
+
+    const Bounds& cube(metadata.bounds);
+    const double halfSize((cube.max().x - cube.min().x) / 2.0);
+    const Point center(cube.mid());
+
+    Buffer info;
+    info.put<double>(center.x);
+    info.put<double>(center.y);
+    info.put<double>(center.z);
+    info.put<double>(halfSize);
+    info.put<double>(halfSize * 2.0 / metadata.span);
+    info.put<uint64_t>(evlrOffset + 60);
+    info.put<uint64_t>(hierarchy.data().size());
+    info.put<double>(writer.hasTime() ? summary.gpsMin : 0);
+    info.put<double>(writer.hasTime() ? summary.gpsMax : 0);
+    for (int i(0); i < 11; ++i) info.put<uint64_t>(0);
+
+    Buffer prefix;
+    prefix.put(makeHeader(
+        writer,
+        summary,
+        pointOffset,
+        vlrs,
+        evlrOffset,
+        wkt.size()));
+    prefix.vlr("copc", 1, info.data());
+    prefix.vlr("laszip encoded", 22204, first.laszip);
+    if (writer.extraBytes().size())
+    {
+        prefix.vlr("LASF_Spec", 4, writer.extraBytes());
+    }
+    if (wktPayload.size()) prefix.vlr("LASF_Projection", 2112, wktPayload);
+    prefix.put<int64_t>(tableOffset);
+
+    assert(prefix.data().size() == pointOffset + 8);
+
+    file.seekp(0);
+    file.write(prefix.data().data(), prefix.data().size());
+    file.seekp(tableOffset);
+    file.write(table.data(), table.size());
+    file.write(evlr.data().data(), evlr.data().size());
+    file.close();
+    if (!file) throw std::runtime_error("Failed to write " + filename);
+
+    if (!local)
+    {
+        if (verbose) std::cout << "Uploading COPC" << std::endl;
+        a.copyFile(filename, path);
+        arbiter::remove(filename);
+    }
+
+    if (verbose)
+    {
+        std::cout << "Wrote " << entries.size() << " nodes, " <<
+            summary.points << " points in " << since<std::chrono::seconds>(start)
+            << " seconds" << std::endl;
+    }
+}
+
+#endif
+
+} // namespace copc
+} // namespace entwine
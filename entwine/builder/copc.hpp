@@ -0,0 +1,33 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <string>
+
+namespace entwine
+{
+
+struct Builder;
+
+namespace copc
+{
+
+// Write the completed index held by this builder as a single cloud-optimized
+// point cloud (COPC) LAZ file at the given path, which may be remote.  Each
+// node of the hierarchy becomes one LAZ chunk, encoded in parallel, and the
+// COPC hierarchy is written as a single page at the end of the file.
+//
+// The builder's output must be complete: subset builds must be merged first.
+// Requires LASzip support.
+void write(const Builder& builder, std::string path, unsigned threads);
+
+} // namespace copc
+} // namespace entwine
@@ -31,6 +31,21 @@ const uint64_t cacheSize(64);
 // work threads to clip threads.
 const float defaultWorkToClipRatio(0.33f);
 
+// Serialized nodes destined for a remote output are uploaded by a dedicated
+// pool of threads.  Uploading is latency-bound rather than CPU-bound, so this
+// pool may be much wider than the number of serialization threads.
+const uint64_t uploadThreads(32);
+
+// Maximum number of bytes of serialized node data awaiting upload.  When this
+// is reached, serialization threads block until uploads complete.
+const uint64_t uploadBufferSize(1024ull * 1024ull * 512ull);
+
+// Number of remote inputs which may be downloaded ahead of their insertion.
+const uint64_t prefetch(4);
+
+// Maximum number of bytes of downloaded inputs awaiting insertion.
+const uint64_t prefetchBufferSize(1024ull * 1024ull * 1024ull * 16ull);
+
 // Max number of nodes to store in a single hierarchy file.
 const uint64_t maxHierarchyNodesPerFile(32768);
 
@@ -13,32 +13,751 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
 
 #include <entwine/builder/heuristics.hpp>
 #include <entwine/types/metadata.hpp>
+#include <entwine/util/binary-file.hpp>
 #include <entwine/util/io.hpp>
+#include <entwine/util/local-writer.hpp>
+#include <entwine/util/mmap.hpp>
 #include <entwine/util/pool.hpp>
+#include <entwine/util/sax.hpp>
+#include <entwine/util/unique.hpp>
 
 namespace entwine
 {
 
+namespace
+{
+
+// Packed keys hold 8 bits of depth and 40 bits for each of X, Y, and Z.
+constexpr uint64_t coordMask = (1ull << 40) - 1;
+
+// The output buffer for run merges.
+constexpr std::size_t mergeBufferSize = 1 << 20;
+
+} // unnamed namespace
+
+class Hierarchy::Run
+{
+public:
+    explicit Run(std::string path)
+        : m_path(path)
+        , m_file(makeUnique<MappedFile>(path))
+    { }
+
+    ~Run()
+    {
+        m_file.reset();
+        arbiter::remove(m_path);
+    }
+
+    const Record* begin() const
+    {
+        return reinterpret_cast<const Record*>(m_file->data());
+    }
+    const Record* end() const { return begin() + size(); }
+    uint64_t size() const { return m_file->size() / sizeof(Record); }
+
+    const Record* find(const Packed& k) const
+    {
+        const Record* it(std::lower_bound(
+            begin(),
+            end(),
+            k,
+            [](const Record& r, const Packed& p)
+            {
+                return r.hi < p.hi || (r.hi == p.hi && r.lo < p.lo);
+            }));
+
+        if (it != end() && it->hi == k.hi && it->lo == k.lo) return it;
+        return nullptr;
+    }
+
+private:
+    Run(const Run&);
+    Run& operator=(const Run&);
+
+    const std::string m_path;
+    std::unique_ptr<MappedFile> m_file;
+};
+
+class Hierarchy::ReadGuard
+{
+public:
+    explicit ReadGuard(const Shard& shard)
+        : m_shard(shard)
+    {
+        // If a writer advances the epoch while we register, we may have
+        // registered too late for it to wait on us, so try again.
+        while (true)
+        {
+            m_epoch = shard.epoch.load();
+            shard.readers[m_epoch & 1].fetch_add(1);
+            if (shard.epoch.load() == m_epoch) return;
+            shard.readers[m_epoch & 1].fetch_sub(1);
+        }
+    }
+
+    ~ReadGuard() { m_shard.readers[m_epoch & 1].fetch_sub(1); }
+
+private:
+    const Shard& m_shard;
+    uint64_t m_epoch = 0;
+};
+
+Hierarchy::Packed::Packed(const uint64_t hi, const uint64_t lo)
+    : hi(hi)
+    , lo(lo)
+{
+    // SplitMix64 finalizer - the high bits select the shard and the low bits
+    // select the slot, so both must be well mixed.
+    uint64_t h(hi * 0x9e3779b97f4a7c15ull ^ lo);
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+    hash = h ^ (h >> 31);
+}
+
+Hierarchy::Hierarchy() : Hierarchy(Spill()) { }
+
+Hierarchy::Hierarchy(const Spill spill)
+    : m_spill(spill)
+    , m_spillSize(
+        spill.nodes ? std::max<uint64_t>(spill.nodes >> shardBits, 1) : 0)
+{
+    if (m_spillSize) arbiter::mkdirp(m_spill.dir);
+    clear();
+    set(Dxyz(), 0);
+}
+
+Hierarchy::Hierarchy(const Hierarchy& other)
+{
+    clear();
+    *this = other;
+}
+
+Hierarchy::~Hierarchy() { }
+
+Hierarchy& Hierarchy::operator=(const Hierarchy& other)
+{
+    if (this == &other) return *this;
+
+    m_spill = other.m_spill;
+    m_spillSize = other.m_spillSize;
+    m_tracking = other.m_tracking;
+
+    for (std::size_t i(0); i < m_shards.size(); ++i)
+    {
+        const Shard& src(other.m_shards[i]);
+        Shard& dst(m_shards[i]);
+
+        SpinGuard srcLock(src.spin);
+        SpinGuard dstLock(dst.spin);
+
+        // Runs and frozen tables are immutable, so they are shared rather
+        // than copied.
+        dst.currentSpilled = src.currentSpilled
+            ? makeUnique<Spilled>(*src.currentSpilled)
+            : nullptr;
+        dst.spilled.store(dst.currentSpilled.get());
+        dst.spilling = false;
+
+        uint64_t capacity(initialCapacity);
+        while (src.size * 4 > capacity * 3) capacity *= 2;
+
+        dst.current.reset();
+        dst.size = 0;
+        grow(dst, capacity);
+
+        const Table& table(*src.current);
+        for (uint64_t s(0); s <= table.mask; ++s)
+        {
+            const Slot& slot(table.slots[s]);
+            const uint64_t hi(slot.hi.load(std::memory_order_relaxed));
+            if (!hi) continue;
+
+            insert(
+                dst,
+                Packed(hi, slot.lo.load(std::memory_order_relaxed)),
+                slot.val.load(std::memory_order_relaxed));
+        }
+
+        dst.count = src.count;
+        dst.changed = src.changed;
+    }
+
+    return *this;
+}
+
+void Hierarchy::clear()
+{
+    for (Shard& shard : m_shards)
+    {
+        shard.current.reset();
+        shard.currentSpilled.reset();
+        shard.spilled.store(nullptr);
+        shard.spilling = false;
+        shard.size = 0;
+        shard.count = 0;
+        shard.changed.clear();
+        grow(shard, initialCapacity);
+    }
+}
+
+void Hierarchy::track()
+{
+    m_tracking = true;
+    for (Shard& shard : m_shards)
+    {
+        SpinGuard lock(shard.spin);
+        shard.changed.clear();
+    }
+}
+
+std::vector<Dxyz> Hierarchy::changed() const
+{
+    std::vector<std::pair<uint64_t, uint64_t>> packed;
+    for (const Shard& shard : m_shards)
+    {
+        SpinGuard lock(shard.spin);
+        packed.insert(packed.end(), shard.changed.begin(), shard.changed.end());
+    }
+
+    std::sort(packed.begin(), packed.end());
+    packed.erase(std::unique(packed.begin(), packed.end()), packed.end());
+
+    std::vector<Dxyz> keys;
+    keys.reserve(packed.size());
+    for (const auto& k : packed) keys.push_back(unpack(k.first, k.second));
+    return keys;
+}
+
+std::pair<uint64_t, uint64_t> Hierarchy::pack(const Dxyz& key)
+{
+    if (key.d > maxDepth || ((key.p.x | key.p.y | key.p.z) & ~coordMask))
+    {
+        throw std::runtime_error("Invalid hierarchy key: " + key.toString());
+    }
+
+    // The depth is stored offset by one so that no packed key is zero.
+    return std::make_pair(
+        ((key.d + 1) << 56) | (key.p.x << 16) | (key.p.y >> 24),
+        ((key.p.y & 0xffffff) << 40) | key.p.z);
+}
+
+Hierarchy::Packed Hierarchy::packed(const Dxyz& key)
+{
+    const auto k(pack(key));
+    return Packed(k.first, k.second);
+}
+
+Dxyz Hierarchy::unpack(const uint64_t hi, const uint64_t lo)
+{
+    return Dxyz(
+        (hi >> 56) - 1,
+        (hi >> 16) & coordMask,
+        ((hi & 0xffff) << 24) | (lo >> 40),
+        lo & coordMask);
+}
+
+bool Hierarchy::find(const Dxyz& key, int64_t& count) const
+{
+    if (key.d > maxDepth) return false;
+
+    const Packed k(packed(key));
+    const Shard& shard(shardFor(k));
+    ReadGuard guard(shard);
+
+    // Spilled nodes are published before the table which replaces them, so
+    // loading in the opposite order never misses a node.
+    const Table* table(shard.table.load(std::memory_order_acquire));
+    if (const Slot* slot = lookup(*table, k))
+    {
+        count = slot->val.load(std::memory_order_acquire);
+        return true;
+    }
+
+    const Spilled* spilled(shard.spilled.load(std::memory_order_acquire));
+    if (!spilled) return false;
+
+    const auto& frozen(spilled->frozen);
+    for (auto it(frozen.rbegin()); it != frozen.rend(); ++it)
+    {
+        if (const Slot* slot = lookup(**it, k))
+        {
+            count = slot->val.load(std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    const Runs& runs(spilled->runs);
+    for (auto it(runs.rbegin()); it != runs.rend(); ++it)
+    {
+        if (const Record* r = (*it)->find(k))
+        {
+            count = r->val;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Hierarchy::set(const Dxyz& key, const int64_t val)
+{
+    const Packed k(packed(key));
+    Shard& shard(shardFor(k));
+
+    bool frozen(false);
+    bool spiller(false);
+    {
+        SpinGuard lock(shard.spin);
+        if (insert(shard, k, val) && m_tracking)
+        {
+            shard.changed.emplace_back(k.hi, k.lo);
+        }
+
+        if (m_spillSize && shard.size >= m_spillSize)
+        {
+            freeze(shard);
+            frozen = true;
+            spiller = !shard.spilling;
+            shard.spilling = true;
+        }
+    }
+
+    // A single writer per shard writes out its frozen tables, while the
+    // others carry on inserting into the fresh table - unless the spill has
+    // fallen far enough behind that its frozen tables must be bounded.
+    if (spiller) spill(shard);
+    else if (frozen)
+    {
+        const auto behind = [&shard]()
+        {
+            SpinGuard lock(shard.spin);
+            return shard.spilling &&
+                shard.currentSpilled->frozen.size() > maxFrozen;
+        };
+        while (behind()) std::this_thread::yield();
+    }
+}
+
+const Hierarchy::Slot* Hierarchy::lookup(const Table& table, const Packed& k)
+{
+    for (uint64_t i(k.hash & table.mask); ; i = (i + 1) & table.mask)
+    {
+        const Slot& slot(table.slots[i]);
+        const uint64_t hi(slot.hi.load(std::memory_order_acquire));
+        if (!hi) return nullptr;
+        if (hi == k.hi && slot.lo.load(std::memory_order_relaxed) == k.lo)
+        {
+            return &slot;
+        }
+    }
+}
+
+bool Hierarchy::insert(Shard& shard, const Packed& k, const int64_t val)
+{
+    Table& table(*shard.current);
+
+    uint64_t i(k.hash & table.mask);
+    for ( ; ; i = (i + 1) & table.mask)
+    {
+        Slot& slot(table.slots[i]);
+        const uint64_t hi(slot.hi.load(std::memory_order_relaxed));
+        if (!hi) break;
+        if (hi == k.hi && slot.lo.load(std::memory_order_relaxed) == k.lo)
+        {
+            const bool changed(
+                slot.val.load(std::memory_order_relaxed) != val);
+            slot.val.store(val, std::memory_order_release);
+            return changed;
+        }
+    }
+
+    // Keep the load factor at or below 3/4 so probe sequences stay short.
+    if ((shard.size + 1) * 4 > (table.mask + 1) * 3)
+    {
+        grow(shard, (table.mask + 1) * 2);
+        return insert(shard, k, val);
+    }
+
+    bool spilled(false);
+    if (const Spilled* s = shard.currentSpilled.get())
+    {
+        spilled =
+            std::any_of(
+                s->frozen.begin(),
+                s->frozen.end(),
+                [&k](const std::shared_ptr<const Table>& frozen)
+                {
+                    return lookup(*frozen, k);
+                }) ||
+            std::any_of(
+                s->runs.begin(),
+                s->runs.end(),
+                [&k](const std::shared_ptr<const Run>& run)
+                {
+                    return run->find(k);
+                });
+    }
+
+    // Publish the key last, so a reader who finds it also sees its value.
+    Slot& slot(table.slots[i]);
+    slot.lo.store(k.lo, std::memory_order_relaxed);
+    slot.val.store(val, std::memory_order_relaxed);
+    slot.hi.store(k.hi, std::memory_order_release);
+    ++shard.size;
+    if (!spilled) ++shard.count;
+    return true;
+}
+
+void Hierarchy::grow(Shard& shard, const uint64_t capacity)
+{
+    auto next(makeUnique<Table>(capacity));
+
+    if (shard.current)
+    {
+        const Table& prev(*shard.current);
+        for (uint64_t s(0); s <= prev.mask; ++s)
+        {
+            const Slot& src(prev.slots[s]);
+            const uint64_t hi(src.hi.load(std::memory_order_relaxed));
+            if (!hi) continue;
+
+            const uint64_t lo(src.lo.load(std::memory_order_relaxed));
+            uint64_t i(Packed(hi, lo).hash & next->mask);
+            while (next->slots[i].hi.load(std::memory_order_relaxed))
+            {
+                i = (i + 1) & next->mask;
+            }
+
+            Slot& dst(next->slots[i]);
+            dst.hi.store(hi, std::memory_order_relaxed);
+            dst.lo.store(lo, std::memory_order_relaxed);
+            dst.val.store(
+                src.val.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+        }
+    }
+
+    std::unique_ptr<Table> prev(std::move(shard.current));
+    shard.current = std::move(next);
+    shard.table.store(shard.current.get(), std::memory_order_release);
+    synchronize(shard);
+}
+
+void Hierarchy::freeze(Shard& shard)
+{
+    // The full table is published as frozen before it is replaced, and is
+    // never written to again.  Writing it out is left to spill().
+    auto next(shard.currentSpilled
+        ? makeUnique<Spilled>(*shard.currentSpilled)
+        : makeUnique<Spilled>());
+    next->frozen.emplace_back(std::move(shard.current));
+    publish(shard, std::move(next));
+
+    shard.size = 0;
+    grow(shard, initialCapacity);
+}
+
+void Hierarchy::spill(Shard& shard)
+{
+    // Only this thread changes the runs of the shard until spilling is
+    // cleared, so they may be rewritten without holding the lock.
+    try
+    {
+        while (true)
+        {
+            std::shared_ptr<const Table> table;
+            Runs runs;
+            {
+                SpinGuard lock(shard.spin);
+                const Spilled& spilled(*shard.currentSpilled);
+                if (spilled.frozen.empty())
+                {
+                    shard.spilling = false;
+                    return;
+                }
+
+                table = spilled.frozen.front();
+                runs = spilled.runs;
+            }
+
+            std::vector<Record> sorted(records(*table));
+            std::sort(
+                sorted.begin(),
+                sorted.end(),
+                [](const Record& a, const Record& b)
+                {
+                    return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo);
+                });
+            runs.push_back(createRun(sorted));
+
+            // Merge runs of similar size, so that each node is rewritten only
+            // a logarithmic number of times and lookups search few runs.
+            while (runs.size() > 1)
+            {
+                const Run& older(*runs[runs.size() - 2]);
+                const Run& newer(*runs.back());
+                if (older.size() > newer.size() * 2) break;
+
+                auto merged(mergeRuns(older, newer));
+                runs.pop_back();
+                runs.back() = merged;
+            }
+
+            SpinGuard lock(shard.spin);
+            auto next(makeUnique<Spilled>(*shard.currentSpilled));
+            next->runs = std::move(runs);
+            next->frozen.erase(next->frozen.begin());
+            publish(shard, std::move(next));
+        }
+    }
+    catch (...)
+    {
+        // The frozen tables are retained, so no nodes are lost.
+        SpinGuard lock(shard.spin);
+        shard.spilling = false;
+        throw;
+    }
+}
+
+void Hierarchy::publish(Shard& shard, std::unique_ptr<Spilled> spilled)
+{
+    // The previous snapshot, along with any table or runs only it refers to,
+    // is freed only once readers who may be using it have finished.
+    std::unique_ptr<Spilled> prev(std::move(shard.currentSpilled));
+    shard.currentSpilled = std::move(spilled);
+    shard.spilled.store(shard.currentSpilled.get(), std::memory_order_release);
+    synchronize(shard);
+}
+
+void Hierarchy::synchronize(Shard& shard)
+{
+    // Readers registered against the prior epoch may still hold pointers to
+    // the previous table or spilled nodes - wait for them to finish.
+    const uint64_t epoch(shard.epoch.fetch_add(1));
+    while (shard.readers[epoch & 1].load()) std::this_thread::yield();
+}
+
+std::vector<Hierarchy::Record> Hierarchy::records(const Table& table)
+{
+    std::vector<Record> records;
+    for (uint64_t s(0); s <= table.mask; ++s)
+    {
+        const Slot& slot(table.slots[s]);
+        const uint64_t hi(slot.hi.load(std::memory_order_relaxed));
+        if (!hi) continue;
+
+        records.push_back(Record {
+            hi,
+            slot.lo.load(std::memory_order_relaxed),
+            slot.val.load(std::memory_order_relaxed) });
+    }
+    return records;
+}
+
+std::string Hierarchy::runPath() const
+{
+    return m_spill.dir + "hierarchy-" +
+        std::to_string(arbiter::randomNumber()) + ".run";
+}
+
+std::shared_ptr<const Hierarchy::Run> Hierarchy::createRun(
+    const std::vector<Record>& records) const
+{
+    const std::string path(runPath());
+
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(
+            reinterpret_cast<const char*>(records.data()),
+            records.size() * sizeof(Record));
+        file.close();
+        if (!file) throw std::runtime_error("Could not write " + path);
+    }
+
+    return std::make_shared<Run>(path);
+}
+
+std::shared_ptr<const Hierarchy::Run> Hierarchy::mergeRuns(
+    const Run& older,
+    const Run& newer) const
+{
+    const std::string path(runPath());
+
+    {
+        // Stream from the mapped runs straight into a buffered file, rather
+        // than gathering the merged run in memory.
+        std::vector<char> buffer(mergeBufferSize);
+        std::ofstream file;
+        file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+        file.open(path, std::ios::binary | std::ios::trunc);
+
+        const auto write = [&file](const Record& r)
+        {
+            file.write(reinterpret_cast<const char*>(&r), sizeof(Record));
+        };
+
+        const Record* a(older.begin());
+        const Record* b(newer.begin());
+        while (a != older.end() || b != newer.end())
+        {
+            if (b == newer.end() ||
+                (a != older.end() &&
+                    (a->hi < b->hi || (a->hi == b->hi && a->lo < b->lo))))
+            {
+                write(*a++);
+            }
+            else
+            {
+                // The newer run takes precedence for duplicate keys.
+                if (a != older.end() && a->hi == b->hi && a->lo == b->lo) ++a;
+                write(*b++);
+            }
+        }
+
+        file.close();
+        if (!file) throw std::runtime_error("Could not write " + path);
+    }
+
+    return std::make_shared<Run>(path);
+}
+
+uint64_t Hierarchy::size() const
+{
+    uint64_t size(0);
+    for (const Shard& shard : m_shards)
+    {
+        SpinGuard lock(shard.spin);
+        size += shard.count;
+    }
+    return size;
+}
+
+void Hierarchy::forEach(std::function<void(const Dxyz&, int64_t)> f) const
+{
+    // Snapshot each shard: its in-memory nodes, including those of frozen
+    // tables, are copied and sorted, while its runs are already sorted and
+    // simply retained.
+    struct Source
+    {
+        const Record* pos;
+        const Record* end;
+        uint64_t priority;
+    };
+
+    // Tables are held with their priorities: frozen tables are newer than
+    // every run, and the current table is the newest of all.
+    std::vector<std::pair<std::vector<Record>, uint64_t>> tables;
+    std::vector<std::shared_ptr<const Run>> runs;
+    std::vector<Source> sources;
+
+    for (const Shard& shard : m_shards)
+    {
+        SpinGuard lock(shard.spin);
+
+        uint64_t priority(0);
+        if (const Spilled* spilled = shard.currentSpilled.get())
+        {
+            for (const auto& run : spilled->runs)
+            {
+                runs.push_back(run);
+                sources.push_back(
+                    Source { run->begin(), run->end(), ++priority });
+            }
+
+            for (const auto& frozen : spilled->frozen)
+            {
+                tables.emplace_back(records(*frozen), ++priority);
+            }
+        }
+
+        tables.emplace_back(
+            records(*shard.current),
+            std::numeric_limits<uint64_t>::max());
+    }
+
+    const auto less = [](const Record& a, const Record& b)
+    {
+        return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo);
+    };
+
+    for (auto& table : tables)
+    {
+        auto& records(table.first);
+        std::sort(records.begin(), records.end(), less);
+        sources.push_back(Source {
+            records.data(),
+            records.data() + records.size(),
+            table.second });
+    }
+
+    // A min-heap of sources, by key and then by descending priority.
+    const auto after = [&less](const Source& a, const Source& b)
+    {
+        if (less(*b.pos, *a.pos)) return true;
+        if (less(*a.pos, *b.pos)) return false;
+        return a.priority < b.priority;
+    };
+
+    std::vector<Source> heap;
+    for (const auto& s : sources) if (s.pos != s.end) heap.push_back(s);
+    std::make_heap(heap.begin(), heap.end(), after);
+
+    bool any(false);
+    Record last { 0, 0, 0 };
+    while (!heap.empty())
+    {
+        std::pop_heap(heap.begin(), heap.end(), after);
+        Source& s(heap.back());
+        const Record r(*s.pos);
+
+        if (!any || less(last, r))
+        {
+            f(unpack(r.hi, r.lo), r.val);
+            last = r;
+            any = true;
+        }
+
+        if (++s.pos == s.end) heap.pop_back();
+        else std::push_heap(heap.begin(), heap.end(), after);
+    }
+}
+
+std::vector<Hierarchy::Node> Hierarchy::nodes() const
+{
+    std::vector<Node> nodes;
+    forEach([&nodes](const Dxyz& key, int64_t val)
+    {
+        nodes.emplace_back(key, val);
+    });
+    return nodes;
+}
+
 void to_json(json& j, const Hierarchy& h)
 {
     j = json::object();
-    for (const auto& entry : h.map) j[entry.first.toString()] = entry.second;
+    h.forEach([&j](const Dxyz& key, int64_t val) { j[key.toString()] = val; });
 }
 
 void from_json(const json& j, Hierarchy& h)
 {
-    h.map = j.get<Hierarchy::Map>();
-    /*
-    for (const auto& p : j.items())
+    h.clear();
+    for (const auto& node : j.items())
     {
-        const Dxyz key(p.key());
-        const uint64_t value = p.value().get<uint64_t>();
-        h.map[key] = value;
+        h.set(Dxyz(node.key()), node.value().get<int64_t>());
     }
-    */
 }
 
 namespace hierarchy
@@ -50,22 +769,22 @@ namespace
 struct Analysis
 {
     Analysis() = default;
-    Analysis(const Hierarchy::ChunkMap& chunks)
+    Analysis(const std::map<Dxyz, uint64_t>& files)
     {
-        const double totalFiles = chunks.size();
+        const double totalFiles = files.size();
         double totalNodes = 0;
-        for (const auto& chunk : chunks)
+        for (const auto& file : files)
         {
-            const uint64_t chunkSize = chunk.second.size();
-            totalNodes += chunkSize;
-            maxNodesPerFile = std::max(maxNodesPerFile, chunkSize);
+            const uint64_t fileSize = file.second;
+            totalNodes += fileSize;
+            maxNodesPerFile = std::max(maxNodesPerFile, fileSize);
         }
 
         double mean = totalNodes / totalFiles;
         double ss = 0;
-        for (const auto& chunk : chunks)
+        for (const auto& file : files)
         {
-            const double n = chunk.second.size();
+            const double n = file.second;
             ss += std::pow(n - mean, 2.0);
         }
         double stddev = std::sqrt(ss / (totalNodes - 1.0));
@@ -76,6 +795,12 @@ struct Analysis
     double rsd = 0;
 };
 
+Dxyz getAncestor(const Dxyz& key, const uint64_t depth)
+{
+    const uint64_t shift(key.d - depth);
+    return Dxyz(depth, key.x >> shift, key.y >> shift, key.z >> shift);
+}
+
 Dxyz getChild(const Dxyz& key, const int dir)
 {
     return Dxyz(
@@ -89,11 +814,11 @@ void getChunks(
     Hierarchy::ChunkMap& result,
     const Dxyz& root,
     const Dxyz& curr,
-    const Hierarchy::Map& h,
+    const Hierarchy& h,
     const unsigned step)
 {
-    if (!h.count(curr)) return;
-    const int64_t n = h.at(curr);
+    int64_t n(0);
+    if (!h.find(curr, n)) return;
 
     if (step && curr.d > root.d && curr.d % step == 0)
     {
@@ -111,23 +836,184 @@ void getChunks(
     }
 }
 
+// Collect the nodes of the hierarchy file rooted at root, along with the roots
+// of its child files.
+void traverse(
+    const Hierarchy& h,
+    const Dxyz& root,
+    const Dxyz& curr,
+    const unsigned step,
+    std::vector<Hierarchy::Node>& nodes,
+    std::vector<Dxyz>& children)
+{
+    int64_t n(0);
+    if (!h.find(curr, n)) return;
+
+    if (step && curr.d > root.d && curr.d % step == 0)
+    {
+        children.push_back(curr);
+    }
+    else
+    {
+        nodes.emplace_back(curr, n);
+        for (int dir = 0; dir < 8; ++dir)
+        {
+            traverse(h, root, getChild(curr, dir), step, nodes, children);
+        }
+    }
+}
+
+// Writes the file rooted at the given key, returning the roots of its child
+// files.
+using FileWriter = std::function<std::vector<Dxyz>(const Dxyz& root)>;
+
+// Files are written a level at a time, each traversed from its root, so only
+// the files of the level in progress are held in memory.
+void writeAll(const unsigned threads, const FileWriter& write)
+{
+    Pool pool(threads);
+
+    std::mutex mutex;
+    std::vector<Dxyz> roots { Dxyz() };
+    while (!roots.empty())
+    {
+        std::vector<Dxyz> next;
+        for (const Dxyz& root : roots)
+        {
+            pool.add([&, root]()
+            {
+                const std::vector<Dxyz> children(write(root));
+
+                std::lock_guard<std::mutex> lock(mutex);
+                next.insert(next.end(), children.begin(), children.end());
+            });
+        }
+
+        pool.await();
+        roots = std::move(next);
+    }
+
+    pool.join();
+}
+
+void writeSome(
+    const std::vector<Dxyz>& roots,
+    const unsigned threads,
+    const FileWriter& write)
+{
+    Pool pool(threads);
+    for (const Dxyz& root : roots) pool.add([&, root]() { write(root); });
+    pool.join();
+}
+
+// Local writes are submitted asynchronously and completed in batches.  Remote
+// endpoints have no writer, so that they never set up a ring of their own.
+std::unique_ptr<LocalWriter> makeWriter(const arbiter::Endpoint& ep)
+{
+    if (!ep.isLocal()) return std::unique_ptr<LocalWriter>();
+    return makeUnique<LocalWriter>();
+}
+
+void put(
+    const arbiter::Endpoint& ep,
+    const std::string& filename,
+    const json& data,
+    const int indent,
+    LocalWriter* writer)
+{
+    if (writer) writer->put(ep.fullPath(filename), data.dump(indent));
+    else ensurePut(ep, filename, data.dump(indent));
+}
+
+std::vector<Dxyz> writeFile(
+    const Hierarchy& h,
+    const arbiter::Endpoint& ep,
+    const Dxyz& root,
+    const unsigned step,
+    const std::string& postfix,
+    LocalWriter* writer)
+{
+    std::vector<Hierarchy::Node> nodes;
+    std::vector<Dxyz> children;
+    traverse(h, root, root, step, nodes, children);
+
+    json data = json::object();
+    for (const auto& node : nodes) data[node.first.toString()] = node.second;
+    for (const Dxyz& child : children) data[child.toString()] = -1;
+
+    const std::string filename = root.toString() + postfix + ".json";
+    put(ep, filename, data, root.d ? -1 : 2, writer);
+    return children;
+}
+
+std::vector<Dxyz> writeStatsFile(
+    const Hierarchy& h,
+    const NodeStatsMap& stats,
+    const arbiter::Endpoint& ep,
+    const Dxyz& root,
+    const unsigned step,
+    const std::string& postfix,
+    LocalWriter* writer)
+{
+    std::vector<Hierarchy::Node> nodes;
+    std::vector<Dxyz> children;
+    traverse(h, root, root, step, nodes, children);
+
+    // Nodes without points have no stats, and children are linked just as
+    // they are in the hierarchy.
+    json data = json::object();
+    NodeStats s;
+    for (const auto& node : nodes)
+    {
+        if (stats.find(node.first, s)) data[node.first.toString()] = s;
+    }
+    for (const Dxyz& child : children) data[child.toString()] = -1;
+
+    put(ep, getStatsFilename(root, postfix), data, -1, writer);
+    return children;
+}
+
 } // unnamed namespace
 
 Hierarchy::ChunkMap getChunks(const Hierarchy& h, const unsigned step)
 {
     Hierarchy::ChunkMap result;
-    getChunks(result, Dxyz(), Dxyz(), h.map, step);
+    getChunks(result, Dxyz(), Dxyz(), h, step);
     return result;
 }
 
 unsigned determineStep(const Hierarchy& h)
 {
-    if (h.map.size() < heuristics::maxHierarchyNodesPerFile) return 0;
+    if (h.size() < heuristics::maxHierarchyNodesPerFile) return 0;
+
+    const std::vector<unsigned> steps { 4, 5, 6, 8, 10 };
+
+    // Tally the node count of every file for all candidate steps in a single
+    // pass, rather than partitioning the whole hierarchy once per step.  A
+    // node belongs to the file rooted at its nearest ancestor whose depth is
+    // a multiple of the step, and each file root is also listed, as a link,
+    // in the file above it.
+    std::vector<std::map<Dxyz, uint64_t>> sizes(steps.size());
+    h.forEach([&](const Dxyz& key, int64_t)
+    {
+        for (std::size_t i(0); i < steps.size(); ++i)
+        {
+            const uint64_t step(steps[i]);
+            const uint64_t depth((key.d / step) * step);
+            auto& files(sizes[i]);
+
+            ++files[getAncestor(key, depth)];
+            if (key.d && key.d == depth)
+            {
+                ++files[getAncestor(key, depth - step)];
+            }
+        }
+    });
 
     struct AnalysisEntry
     {
-        AnalysisEntry(const Hierarchy& h, unsigned step)
-            : analysis(getChunks(h, step))
+        AnalysisEntry(const std::map<Dxyz, uint64_t>& files, unsigned step)
+            : analysis(files)
             , step(step)
         { }
         Analysis analysis;
@@ -135,9 +1021,9 @@ unsigned determineStep(const Hierarchy& h)
     };
 
     std::vector<AnalysisEntry> entries;
-    for (const uint64_t step : { 4, 5, 6, 8, 10 })
+    for (std::size_t i(0); i < steps.size(); ++i)
     {
-        entries.emplace_back(h, step);
+        entries.emplace_back(sizes[i], steps[i]);
     }
 
     const auto best = std::min_element(
@@ -169,71 +1055,432 @@ void save(
     const unsigned threads,
     const std::string postfix)
 {
-    Pool pool(threads);
+    const auto writer(makeWriter(ep));
+    writeAll(threads, [&](const Dxyz& root)
+    {
+        return writeFile(h, ep, root, step, postfix, writer.get());
+    });
+    if (writer) writer->wait();
+}
 
-    const auto chunks = getChunks(h, step);
-    for (const auto& chunk : chunks)
+std::vector<Dxyz> getFileRoots(
+    const std::vector<Dxyz>& keys,
+    const unsigned step)
+{
+    std::set<Dxyz> roots;
+    for (const Dxyz& key : keys)
     {
-        pool.add([&]()
+        if (!step)
         {
-            const Dxyz& root = chunk.first;
-            const Hierarchy::Map& counts = chunk.second;
-
-            const std::string filename = root.toString() + postfix + ".json";
-            json data = json::object();
-            for (const auto& node : counts)
-            {
-                data[node.first.toString()] = node.second;
-            }
+            roots.insert(Dxyz());
+            break;
+        }
 
-            const int indent = root.d ? -1 : 2;
-            ensurePut(ep, filename, data.dump(indent));
-        });
+        // A node is listed in the file rooted at its nearest ancestor at a
+        // multiple of the step, and a file root is also linked from above.
+        const uint64_t depth((key.d / step) * step);
+        roots.insert(getAncestor(key, depth));
+        if (key.d && key.d == depth)
+        {
+            roots.insert(getAncestor(key, depth - step));
+        }
     }
+    return std::vector<Dxyz>(roots.begin(), roots.end());
+}
 
-    pool.join();
+void save(
+    const Hierarchy& h,
+    const arbiter::Endpoint& ep,
+    const unsigned step,
+    const std::vector<Dxyz>& roots,
+    const unsigned threads,
+    const std::string postfix)
+{
+    const auto writer(makeWriter(ep));
+    writeSome(roots, threads, [&](const Dxyz& root)
+    {
+        return writeFile(h, ep, root, step, postfix, writer.get());
+    });
+    if (writer) writer->wait();
+}
+
+std::string getStatsFilename(const Dxyz& root, const std::string postfix)
+{
+    return root.toString() + postfix + ".stats.json";
 }
 
-void load(
-    Hierarchy& h,
+void saveStats(
+    const Hierarchy& h,
+    const NodeStatsMap& stats,
     const arbiter::Endpoint& ep,
-    Pool& pool,
-    const std::string& postfix,
-    const Dxyz& root = Dxyz())
+    const unsigned step,
+    const unsigned threads,
+    const std::string postfix)
 {
-    const json j = json::parse(
-        ensureGet(ep, root.toString() + postfix + ".json"));
+    const auto writer(makeWriter(ep));
+    writeAll(threads, [&](const Dxyz& root)
+    {
+        return writeStatsFile(
+            h, stats, ep, root, step, postfix, writer.get());
+    });
+    if (writer) writer->wait();
+}
 
-    for (const auto& node : j.items())
+void saveStats(
+    const Hierarchy& h,
+    const NodeStatsMap& stats,
+    const arbiter::Endpoint& ep,
+    const unsigned step,
+    const std::vector<Dxyz>& roots,
+    const unsigned threads,
+    const std::string postfix)
+{
+    const auto writer(makeWriter(ep));
+    writeSome(roots, threads, [&](const Dxyz& root)
     {
-        const Dxyz key(node.key());
-        const int64_t val(node.value().get<int64_t>());
+        return writeStatsFile(
+            h, stats, ep, root, step, postfix, writer.get());
+    });
+    if (writer) writer->wait();
+}
+
+void loadStats(
+    NodeStatsMap& stats,
+    const arbiter::Endpoint& ep,
+    const unsigned threads,
+    const std::string postfix,
+    Hedge* hedge)
+{
+    Pool pool(threads, 1, false);
 
-        if (val == -1)
+    std::mutex mutex;
+    std::vector<Dxyz> roots { Dxyz() };
+    while (!roots.empty())
+    {
+        std::vector<Dxyz> next;
+        for (const Dxyz& root : roots)
         {
-            pool.add([&h, &ep, &pool, &postfix, key]()
+            pool.add([&, root]()
             {
-                load(h, ep, pool, postfix, key);
+                const std::string filename(getStatsFilename(root, postfix));
+                const json data(json::parse(
+                    hedge ? ensureGet(ep, filename, *hedge)
+                        : ensureGet(ep, filename)));
+
+                std::vector<Dxyz> children;
+                for (const auto& node : data.items())
+                {
+                    const Dxyz key(node.key());
+                    if (node.value().is_object())
+                    {
+                        stats.set(key, node.value().get<NodeStats>());
+                    }
+                    else children.push_back(key);
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                next.insert(next.end(), children.begin(), children.end());
             });
         }
-        else set(h, key, val);
+
+        pool.await();
+        if (pool.errors().size()) break;
+        roots = std::move(next);
+    }
+
+    pool.join();
+
+    if (pool.errors().size())
+    {
+        throw std::runtime_error(
+            "Node stats load failed: " + pool.errors().front());
+    }
+
+    stats.clearChanged();
+}
+
+namespace
+{
+
+uint64_t parseKeyPart(const std::string& s, std::size_t& pos)
+{
+    const std::size_t begin(pos);
+    uint64_t v(0);
+    while (pos < s.size() && s[pos] >= '0' && s[pos] <= '9')
+    {
+        v = v * 10 + (s[pos++] - '0');
     }
+    if (pos == begin || pos - begin > 19)
+    {
+        throw std::runtime_error("Invalid hierarchy key: " + s);
+    }
+    return v;
 }
 
+// Parse a D-X-Y-Z key in place, without splitting it into substrings.
+Dxyz parseKey(const std::string& s)
+{
+    uint64_t v[4];
+    std::size_t pos(0);
+    for (int i(0); i < 4; ++i)
+    {
+        if (i && (pos >= s.size() || s[pos++] != '-'))
+        {
+            throw std::runtime_error("Invalid hierarchy key: " + s);
+        }
+        v[i] = parseKeyPart(s, pos);
+    }
+    if (pos != s.size())
+    {
+        throw std::runtime_error("Invalid hierarchy key: " + s);
+    }
+    return Dxyz(v[0], v[1], v[2], v[3]);
+}
+
+// Streams the nodes of a hierarchy file directly into the hierarchy, and
+// collects the roots of its child files, without building a DOM.
+class HierarchyReader : public SaxHandler
+{
+public:
+    HierarchyReader(Hierarchy& h, std::vector<Dxyz>& children)
+        : m_h(h)
+        , m_children(children)
+    { }
+
+protected:
+    void onStart(bool object) override
+    {
+        if (!object || m_open) throw std::runtime_error("Invalid hierarchy");
+        m_open = true;
+    }
+
+    void onKey(std::string& key) override { m_key = parseKey(key); }
+
+    void onValue(json value) override
+    {
+        if (!m_open || !value.is_number_integer())
+        {
+            throw std::runtime_error("Invalid hierarchy");
+        }
+
+        const int64_t val(value.get<int64_t>());
+        if (val == -1) m_children.push_back(m_key);
+        else m_h.set(m_key, val);
+    }
+
+    void onEnd() override { }
+
+private:
+    Hierarchy& m_h;
+    std::vector<Dxyz>& m_children;
+    bool m_open = false;
+    Dxyz m_key;
+};
+
+} // unnamed namespace
+
 Hierarchy load(
     const arbiter::Endpoint& ep,
     const unsigned threads,
-    const std::string postfix)
+    const std::string postfix,
+    Hedge* hedge,
+    const Hierarchy::Spill spill,
+    unsigned* step)
 {
-    Hierarchy hierarchy;
-    Pool pool(threads);
+    Hierarchy hierarchy(spill);
+    Pool pool(threads, 1, false);
+    if (step) *step = 0;
+
+    // Files are fetched and parsed a level at a time, in parallel, since the
+    // roots of the next level are only known once their parents are parsed.
+    std::mutex mutex;
+    std::vector<Dxyz> roots { Dxyz() };
+    while (!roots.empty())
+    {
+        std::vector<Dxyz> next;
+        for (const Dxyz& root : roots)
+        {
+            pool.add([&, root]()
+            {
+                const std::string filename =
+                    root.toString() + postfix + ".json";
+                const std::string data(
+                    hedge ? ensureGet(ep, filename, *hedge)
+                        : ensureGet(ep, filename));
+
+                std::vector<Dxyz> children;
+                HierarchyReader reader(hierarchy, children);
+                reader.parse(data);
 
-    load(hierarchy, ep, pool, postfix);
+                // The files below the root are split at the depth of its
+                // links.
+                if (step && !root.d && children.size())
+                {
+                    *step = children.front().d;
+                }
 
-    pool.await();
+                std::lock_guard<std::mutex> lock(mutex);
+                next.insert(next.end(), children.begin(), children.end());
+            });
+        }
+
+        pool.await();
+        if (pool.errors().size()) break;
+        roots = std::move(next);
+    }
+
+    pool.join();
+
+    if (pool.errors().size())
+    {
+        throw std::runtime_error(
+            "Hierarchy load failed: " + pool.errors().front());
+    }
 
     return hierarchy;
 }
 
+namespace
+{
+
+// The header holds a magic number, a format version, and the node count.  As
+// of version 2, it is followed by the step with which the JSON files were
+// split, as a uint64.
+const std::string binaryMagic("EHIB");
+constexpr uint32_t binaryVersion = 2;
+constexpr uint64_t binaryRecordSize = 24;
+constexpr uint64_t binaryStepSize = 8;
+
+std::vector<char> makeBinaryHeader(const uint64_t count, const uint64_t step)
+{
+    std::vector<char> header(
+        BinaryFile::makeHeader(binaryMagic, binaryVersion, count));
+    header.resize(header.size() + binaryStepSize);
+    std::memcpy(header.data() + BinaryFile::headerSize, &step, binaryStepSize);
+    return header;
+}
+
+} // unnamed namespace
+
+void saveBinary(
+    const Hierarchy& h,
+    const arbiter::Endpoint& ep,
+    const unsigned step,
+    const std::string postfix)
+{
+    const std::string filename(getBinaryFilename(postfix));
+
+    // Local output is streamed straight to disk.  Remote output must be
+    // buffered, since it is written as a single object.
+    const bool local(ep.isLocal());
+    std::ofstream file;
+    std::vector<char> data;
+
+    if (local)
+    {
+        file.open(ep.fullPath(filename), std::ios::binary | std::ios::trunc);
+        const std::vector<char> header(makeBinaryHeader(0, step));
+        file.write(header.data(), header.size());
+    }
+    else data = makeBinaryHeader(0, step);
+
+    uint64_t count(0);
+    char record[binaryRecordSize];
+    h.forEach([&](const Dxyz& key, const int64_t val)
+    {
+        const auto k(Hierarchy::pack(key));
+        std::memcpy(record, &k.first, 8);
+        std::memcpy(record + 8, &k.second, 8);
+        std::memcpy(record + 16, &val, 8);
+
+        if (local) file.write(record, binaryRecordSize);
+        else data.insert(data.end(), record, record + binaryRecordSize);
+        ++count;
+    });
+
+    const std::vector<char> header(makeBinaryHeader(count, step));
+    if (local)
+    {
+        file.seekp(0);
+        file.write(header.data(), header.size());
+        if (!file.good())
+        {
+            throw std::runtime_error("Could not write " + filename);
+        }
+    }
+    else
+    {
+        std::copy(header.begin(), header.end(), data.begin());
+        ensurePut(ep, filename, data);
+    }
+}
+
+Hierarchy loadBinary(
+    const arbiter::Endpoint& ep,
+    const unsigned threads,
+    const std::string postfix,
+    Hedge* hedge,
+    const Hierarchy::Spill spill,
+    optional<unsigned>* step)
+{
+    const BinaryFile file(
+        ep,
+        getBinaryFilename(postfix),
+        binaryMagic,
+        binaryVersion,
+        "binary hierarchy",
+        hedge);
+
+    // Files from version 1 do not record the step of the JSON files.
+    const uint64_t skip(file.version() > 1 ? binaryStepSize : 0);
+    file.checkRecords(binaryRecordSize, skip);
+    if (step) *step = optional<unsigned>();
+    if (step && skip)
+    {
+        uint64_t s(0);
+        std::memcpy(&s, file.data() + BinaryFile::headerSize, binaryStepSize);
+        *step = static_cast<unsigned>(s);
+    }
+
+    const char* data(file.data() + skip);
+    const uint64_t count(file.count());
+
+    Hierarchy h(spill);
+    h.clear();
+
+    // Nodes are spread over the hierarchy's shards, so blocks of records may
+    // be inserted in parallel.
+    const uint64_t block = 65536;
+    Pool pool(threads, 1, false);
+    for (uint64_t begin(0); begin < count; begin += block)
+    {
+        pool.add([&h, data, begin, count]()
+        {
+            const uint64_t end(std::min(begin + block, count));
+            for (uint64_t i(begin); i < end; ++i)
+            {
+                const char* pos(
+                    data + BinaryFile::headerSize + i * binaryRecordSize);
+
+                uint64_t hi(0), lo(0);
+                int64_t val(0);
+                std::memcpy(&hi, pos, 8);
+                std::memcpy(&lo, pos + 8, 8);
+                std::memcpy(&val, pos + 16, 8);
+                h.set(Hierarchy::unpack(hi, lo), val);
+            }
+        });
+    }
+    pool.join();
+
+    if (pool.errors().size())
+    {
+        throw std::runtime_error(
+            "Invalid binary hierarchy: " + pool.errors().front());
+    }
+
+    return h;
+}
+
 } // namespace hierarchy
 } // namespace entwine
@@ -10,30 +10,216 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <entwine/types/key.hpp>
+#include <entwine/types/node-stats.hpp>
+#include <entwine/util/optional.hpp>
 #include <entwine/util/spin-lock.hpp>
 
 namespace entwine
 {
 
-struct Hierarchy
+class Hedge;
+
+// A concurrent map of node keys to point counts.  Keys are packed into 128
+// bits and spread over a fixed number of shards, each of which is an
+// open-addressed hash table guarded by its own lock for writers.  Readers
+// never lock - a replaced table is freed only once every reader which may
+// have been probing it has finished.
+//
+// If spilling is enabled, each shard holds a bounded number of nodes in
+// memory.  Beyond that, its table is frozen and replaced by an empty one, and
+// the frozen table is then written out, outside of the lock, as a sorted run
+// file in the spill directory which is memory mapped and binary searched.
+// Runs of similar size are merged, so lookups touch O(log n) runs.
+class Hierarchy
 {
+public:
     using Map = std::map<Dxyz, int64_t>;
     using ChunkMap = std::map<Dxyz, Hierarchy::Map>;
+    using Node = std::pair<Dxyz, int64_t>;
+
+    // Where, and beyond how many in-memory nodes, to spill to disk.  If nodes
+    // is zero, the hierarchy is held entirely in memory.
+    struct Spill
+    {
+        std::string dir;
+        uint64_t nodes = 0;
+    };
+
+    Hierarchy();
+    explicit Hierarchy(Spill spill);
+    Hierarchy(const Hierarchy& other);
+    Hierarchy& operator=(const Hierarchy& other);
+    ~Hierarchy();
+
+    // Keys deeper than this cannot be stored.
+    static constexpr uint64_t maxDepth = 40;
+
+    // Fetch the count for this key, returning false if it does not exist.
+    bool find(const Dxyz& key, int64_t& count) const;
+
+    // The count for this key, or 0 if it does not exist.
+    int64_t get(const Dxyz& key) const
+    {
+        int64_t count(0);
+        find(key, count);
+        return count;
+    }
+
+    bool contains(const Dxyz& key) const
+    {
+        int64_t count(0);
+        return find(key, count);
+    }
+
+    void set(const Dxyz& key, int64_t val);
+
+    // Remove all nodes, including the root.  Not thread-safe.
+    void clear();
+
+    // Begin recording the keys of nodes whose counts are set or changed,
+    // discarding any recorded so far.  Not thread-safe.
+    void track();
+    bool tracking() const { return m_tracking; }
+
+    // The keys recorded since track() was called, sorted.
+    std::vector<Dxyz> changed() const;
+
+    uint64_t size() const;
+
+    // Whether nodes beyond the configured cache size are spilled to disk.
+    bool spills() const { return m_spillSize; }
+
+    // Visit every node in key order, without materializing the hierarchy.
+    // Nodes set during the traversal may or may not be visited.
+    void forEach(std::function<void(const Dxyz&, int64_t)> f) const;
+
+    // All nodes, sorted by key.
+    std::vector<Node> nodes() const;
+
+    // Keys packed into 128 bits, whose order matches that of Dxyz.
+    static std::pair<uint64_t, uint64_t> pack(const Dxyz& key);
+    static Dxyz unpack(uint64_t hi, uint64_t lo);
+
+private:
+    struct Packed
+    {
+        Packed(uint64_t hi, uint64_t lo);
+
+        uint64_t hi = 0;
+        uint64_t lo = 0;
+        uint64_t hash = 0;
+    };
+
+    // Records sort by their packed keys, which is also the order of Dxyz.
+    struct Record
+    {
+        uint64_t hi;
+        uint64_t lo;
+        int64_t val;
+    };
+
+    // A zero hi word marks an empty slot - packed keys never have one.
+    struct Slot
+    {
+        std::atomic<uint64_t> hi { 0 };
+        std::atomic<uint64_t> lo { 0 };
+        std::atomic<int64_t> val { 0 };
+    };
+
+    struct Table
+    {
+        explicit Table(uint64_t capacity)
+            : mask(capacity - 1)
+            , slots(new Slot[capacity])
+        { }
+
+        const uint64_t mask;
+        std::unique_ptr<Slot[]> slots;
+    };
+
+    class Run;
+    using Runs = std::vector<std::shared_ptr<const Run>>;
+
+    // Nodes no longer in the current table, published for readers as a
+    // whole.  Both are ordered from oldest to newest, and frozen tables,
+    // which are awaiting their write to a run, are newer than every run.
+    struct Spilled
+    {
+        Runs runs;
+        std::vector<std::shared_ptr<const Table>> frozen;
+    };
+
+    struct alignas(64) Shard
+    {
+        mutable SpinLock spin;
+
+        // Published for readers.
+        std::atomic<const Table*> table { nullptr };
+        std::atomic<const Spilled*> spilled { nullptr };
+
+        // Readers register against the current epoch, so that writers may
+        // wait for those of a prior epoch to finish.
+        mutable std::atomic<uint64_t> epoch { 0 };
+        mutable std::atomic<uint64_t> readers[2] { { 0 }, { 0 } };
+
+        // Owned by writers, under the lock.
+        std::unique_ptr<Table> current;
+        std::unique_ptr<Spilled> currentSpilled;
+        bool spilling = false;
+        uint64_t size = 0;
+        uint64_t count = 0;
+        std::vector<std::pair<uint64_t, uint64_t>> changed;
+    };
 
-    Hierarchy() = default;
-    Hierarchy(const Hierarchy& other) : map(other.map) { }
-    Hierarchy& operator=(const Hierarchy& other)
+    class ReadGuard;
+
+    static constexpr uint64_t shardBits = 6;
+    static constexpr uint64_t initialCapacity = 16;
+
+    // Beyond this many frozen tables in a shard, writers wait for its spill.
+    static constexpr std::size_t maxFrozen = 4;
+
+    static Packed packed(const Dxyz& key);
+
+    const Shard& shardFor(const Packed& k) const
+    {
+        return m_shards[k.hash >> (64 - shardBits)];
+    }
+    Shard& shardFor(const Packed& k)
     {
-        map = other.map;
-        return *this;
+        return m_shards[k.hash >> (64 - shardBits)];
     }
 
-    mutable SpinLock spin;
-    Map map = { { Dxyz(), 0 } };
+    // Returns true if the key was added or its value was changed.
+    bool insert(Shard& shard, const Packed& k, int64_t val);
+    void grow(Shard& shard, uint64_t capacity);
+    void freeze(Shard& shard);
+    void spill(Shard& shard);
+    void publish(Shard& shard, std::unique_ptr<Spilled> spilled);
+    void synchronize(Shard& shard);
+
+    static const Slot* lookup(const Table& table, const Packed& k);
+    static std::vector<Record> records(const Table& table);
+
+    std::string runPath() const;
+    std::shared_ptr<const Run> createRun(const std::vector<Record>& r) const;
+    std::shared_ptr<const Run> mergeRuns(const Run& a, const Run& b) const;
+
+    Spill m_spill;
+    uint64_t m_spillSize = 0;
+    bool m_tracking = false;
+    std::array<Shard, 1 << shardBits> m_shards;
 };
 
 void to_json(json& j, const Hierarchy& h);
@@ -44,16 +230,12 @@ namespace hierarchy
 
 inline void set(Hierarchy& h, const Dxyz& key, uint64_t val)
 {
-    SpinGuard lock(h.spin);
-    h.map[key] = val;
+    h.set(key, val);
 }
 
 inline uint64_t get(const Hierarchy& h, const Dxyz& key)
 {
-    SpinGuard lock(h.spin);
-    const auto it = h.map.find(key);
-    if (it == h.map.end()) return 0;
-    else return it->second;
+    return h.get(key);
 }
 
 unsigned determineStep(const Hierarchy& h);
@@ -64,10 +246,77 @@ void save(
     unsigned step,
     unsigned threads,
     std::string postfix = "");
+
+// The roots of the files, split with this step, which list any of these keys.
+std::vector<Dxyz> getFileRoots(const std::vector<Dxyz>& keys, unsigned step);
+
+// Rewrite only the files with these roots.  The remaining files must already
+// exist, split with the same step.
+void save(
+    const Hierarchy& h,
+    const arbiter::Endpoint& ep,
+    unsigned step,
+    const std::vector<Dxyz>& roots,
+    unsigned threads,
+    std::string postfix = "");
+// The stats sidecar holds the stats of the nodes of each hierarchy file in a
+// file of its own, which links to its child files just as the hierarchy does.
+std::string getStatsFilename(const Dxyz& root, std::string postfix = "");
+void saveStats(
+    const Hierarchy& h,
+    const NodeStatsMap& stats,
+    const arbiter::Endpoint& ep,
+    unsigned step,
+    unsigned threads,
+    std::string postfix = "");
+void saveStats(
+    const Hierarchy& h,
+    const NodeStatsMap& stats,
+    const arbiter::Endpoint& ep,
+    unsigned step,
+    const std::vector<Dxyz>& roots,
+    unsigned threads,
+    std::string postfix = "");
+void loadStats(
+    NodeStatsMap& stats,
+    const arbiter::Endpoint& ep,
+    unsigned threads,
+    std::string postfix = "",
+    Hedge* hedge = nullptr);
+
+// If step is given, it receives the step with which the files were split, or
+// zero if the hierarchy is a single file.
 Hierarchy load(
     const arbiter::Endpoint& ep,
     unsigned threads,
+    std::string postfix = "",
+    Hedge* hedge = nullptr,
+    Hierarchy::Spill spill = Hierarchy::Spill(),
+    unsigned* step = nullptr);
+
+// A compact binary encoding of the whole hierarchy, for internal use by
+// continued builds and merges.  After a small header, which records the step
+// with which the JSON files were split, each node is written as its packed key
+// and count, in key order.
+inline std::string getBinaryFilename(std::string postfix = "")
+{
+    return "hierarchy" + postfix + ".bin";
+}
+void saveBinary(
+    const Hierarchy& h,
+    const arbiter::Endpoint& ep,
+    unsigned step,
     std::string postfix = "");
 
+// If step is given, it receives the step recorded by saveBinary, or nothing if
+// the file predates it.
+Hierarchy loadBinary(
+    const arbiter::Endpoint& ep,
+    unsigned threads,
+    std::string postfix = "",
+    Hedge* hedge = nullptr,
+    Hierarchy::Spill spill = Hierarchy::Spill(),
+    optional<unsigned>* step = nullptr);
+
 } // namespace hierarchy
 } // namespace entwine
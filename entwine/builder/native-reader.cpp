@@ -0,0 +1,600 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/builder/native-reader.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+#ifdef ENTWINE_HAVE_LASZIP
+#include <laszip/laszip_api.h>
+#endif
+
+#include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/types/defs.hpp>
+#include <entwine/util/unique.hpp>
+
+namespace entwine
+{
+
+namespace
+{
+
+enum class Field
+{
+    X, Y, Z,
+    Intensity,
+    ReturnNumber,
+    NumberOfReturns,
+    ScanDirectionFlag,
+    EdgeOfFlightLine,
+    Classification,
+    Synthetic,
+    KeyPoint,
+    Withheld,
+    Overlap,
+    ClassFlags,
+    ScanChannel,
+    ScanAngleRank,
+    UserData,
+    PointSourceId,
+    GpsTime,
+    Red,
+    Green,
+    Blue,
+    Infrared
+};
+
+const std::array<std::string, 23> fieldNames { {
+    "X", "Y", "Z",
+    "Intensity",
+    "ReturnNumber",
+    "NumberOfReturns",
+    "ScanDirectionFlag",
+    "EdgeOfFlightLine",
+    "Classification",
+    "Synthetic",
+    "KeyPoint",
+    "Withheld",
+    "Overlap",
+    "ClassFlags",
+    "ScanChannel",
+    "ScanAngleRank",
+    "UserData",
+    "PointSourceId",
+    "GpsTime",
+    "Red",
+    "Green",
+    "Blue",
+    "Infrared"
+} };
+
+std::size_t toIndex(const Field f) { return static_cast<std::size_t>(f); }
+
+optional<Field> findField(const std::string& name)
+{
+    const auto it(std::find(fieldNames.begin(), fieldNames.end(), name));
+    if (it == fieldNames.end()) return { };
+    return static_cast<Field>(std::distance(fieldNames.begin(), it));
+}
+
+// Waveform formats, and anything with extra bytes, are left to PDAL.
+bool isSupported(const int format)
+{
+    return (format >= 0 && format <= 3) || (format >= 6 && format <= 8);
+}
+
+bool hasTime(const int f) { return f == 1 || f == 3 || f >= 6; }
+bool hasColor(const int f) { return f == 2 || f == 3 || f == 7 || f == 8; }
+bool hasInfrared(const int f) { return f == 8; }
+bool isExtended(const int f) { return f >= 6; }
+
+#ifdef ENTWINE_HAVE_LASZIP
+uint64_t getBaseRecordLength(const int format)
+{
+    static const std::array<uint64_t, 9> lengths { {
+        20, 28, 26, 34, 57, 63, 30, 36, 38
+    } };
+    return lengths.at(format);
+}
+
+bool isTrivial(const json& pipeline, const std::string path)
+{
+    std::string extension(arbiter::getExtension(path));
+    std::transform(
+        extension.begin(),
+        extension.end(),
+        extension.begin(),
+        [](unsigned char c) { return std::tolower(c); });
+    const bool isLas = extension == "las" || extension == "laz";
+
+    if (pipeline.is_null()) return isLas;
+    if (!pipeline.is_array() || pipeline.size() != 1) return false;
+
+    const json& reader(pipeline.at(0));
+    if (!reader.is_object()) return false;
+
+    for (const auto& option : reader.items())
+    {
+        if (option.key() != "filename" && option.key() != "type") return false;
+    }
+
+    if (reader.count("type"))
+    {
+        return reader.at("type").get<std::string>() == "readers.las";
+    }
+    return isLas;
+}
+#endif
+
+// Matches PDAL's conversion semantics: integral values are rounded, and
+// out-of-range values are an error.
+template <typename T>
+T cast(double d)
+{
+    if (std::is_integral<T>::value)
+    {
+        d = std::round(d);
+        if (
+            d < static_cast<double>(std::numeric_limits<T>::lowest()) ||
+            d > static_cast<double>(std::numeric_limits<T>::max()))
+        {
+            throw std::runtime_error("Native reader: value out of range");
+        }
+    }
+    return static_cast<T>(d);
+}
+
+template <typename T>
+void convert(
+    const std::vector<double>& column,
+    const uint64_t n,
+    char* pos,
+    const uint64_t pointSize)
+{
+    for (uint64_t i(0); i < n; ++i, pos += pointSize)
+    {
+        const T value(cast<T>(column[i]));
+        std::memcpy(pos, &value, sizeof(T));
+    }
+}
+
+void convert(
+    const std::vector<double>& column,
+    const uint64_t n,
+    char* pos,
+    const uint64_t pointSize,
+    const DimType type)
+{
+    switch (type)
+    {
+        case DimType::Signed8:
+            return convert<int8_t>(column, n, pos, pointSize);
+        case DimType::Signed16:
+            return convert<int16_t>(column, n, pos, pointSize);
+        case DimType::Signed32:
+            return convert<int32_t>(column, n, pos, pointSize);
+        case DimType::Signed64:
+            return convert<int64_t>(column, n, pos, pointSize);
+        case DimType::Unsigned8:
+            return convert<uint8_t>(column, n, pos, pointSize);
+        case DimType::Unsigned16:
+            return convert<uint16_t>(column, n, pos, pointSize);
+        case DimType::Unsigned32:
+            return convert<uint32_t>(column, n, pos, pointSize);
+        case DimType::Unsigned64:
+            return convert<uint64_t>(column, n, pos, pointSize);
+        case DimType::Float:
+            return convert<float>(column, n, pos, pointSize);
+        case DimType::Double:
+            return convert<double>(column, n, pos, pointSize);
+        default:
+            throw std::runtime_error("Native reader: invalid dimension type");
+    }
+}
+
+// Streaming statistics matching those of filters.stats.
+struct Accumulator
+{
+    void add(const double v)
+    {
+        if (!count || v < minimum) minimum = v;
+        if (!count || v > maximum) maximum = v;
+
+        ++count;
+        const double delta(v - mean);
+        mean += delta / count;
+        m2 += delta * (v - mean);
+
+        if (enumerate) ++values[v];
+    }
+
+    DimensionStats get() const
+    {
+        DimensionStats s;
+        s.minimum = minimum;
+        s.maximum = maximum;
+        s.mean = mean;
+        s.variance = count ? m2 / count : 0;
+        s.count = count;
+        s.values = values;
+        return s;
+    }
+
+    bool enumerate = false;
+    uint64_t count = 0;
+    double minimum = 0;
+    double maximum = 0;
+    double mean = 0;
+    double m2 = 0;
+    DimensionStats::Values values;
+};
+
+} // unnamed namespace
+
+std::vector<std::string> getNativeDimensions(const int f)
+{
+    if (!isSupported(f)) return { };
+
+    std::vector<std::string> dims {
+        "X", "Y", "Z",
+        "Intensity",
+        "ReturnNumber",
+        "NumberOfReturns",
+        "ScanDirectionFlag",
+        "EdgeOfFlightLine",
+        "Classification",
+        "Synthetic",
+        "KeyPoint",
+        "Withheld",
+        "Overlap",
+        "ClassFlags",
+        "ScanAngleRank",
+        "UserData",
+        "PointSourceId"
+    };
+
+    if (isExtended(f)) dims.push_back("ScanChannel");
+    if (hasTime(f)) dims.push_back("GpsTime");
+    if (hasColor(f))
+    {
+        dims.push_back("Red");
+        dims.push_back("Green");
+        dims.push_back("Blue");
+    }
+    if (hasInfrared(f)) dims.push_back("Infrared");
+
+    return dims;
+}
+
+#ifdef ENTWINE_HAVE_LASZIP
+
+struct NativeReader::Impl
+{
+    explicit Impl(const std::string path)
+    {
+        if (laszip_create(&laszip)) throw std::runtime_error("LASzip failed");
+
+        laszip_BOOL compressed(0);
+        check(laszip_open_reader(laszip, path.c_str(), &compressed));
+        init();
+    }
+
+    explicit Impl(std::unique_ptr<std::istream> s)
+        : stream(std::move(s))
+    {
+        if (laszip_create(&laszip)) throw std::runtime_error("LASzip failed");
+
+        laszip_BOOL compressed(0);
+        check(laszip_open_reader_stream(laszip, *stream, &compressed));
+        init();
+    }
+
+    void init()
+    {
+        check(laszip_get_header_pointer(laszip, &header));
+        check(laszip_get_point_pointer(laszip, &point));
+
+        format = header->point_data_format & 0x3f;
+        points = header->number_of_point_records;
+        if (header->version_minor >= 4)
+        {
+            const uint64_t extended(header->extended_number_of_point_records);
+            if (extended) points = extended;
+        }
+    }
+
+    ~Impl()
+    {
+        laszip_close_reader(laszip);
+        laszip_destroy(laszip);
+    }
+
+    void check(const laszip_I32 code) const
+    {
+        if (!code) return;
+
+        laszip_CHAR* error(nullptr);
+        laszip_get_error(laszip, &error);
+        throw std::runtime_error(
+            std::string("LASzip: ") + (error ? error : "unknown error"));
+    }
+
+    void next() { check(laszip_read_point(laszip)); }
+
+    double get(const Field f) const
+    {
+        const laszip_point& p(*point);
+        const bool ext(isExtended(format));
+        const uint8_t flags(ext
+            ? p.extended_classification_flags
+            : (p.synthetic_flag | p.keypoint_flag << 1 | p.withheld_flag << 2));
+
+        switch (f)
+        {
+            case Field::X:
+                return p.X * header->x_scale_factor + header->x_offset;
+            case Field::Y:
+                return p.Y * header->y_scale_factor + header->y_offset;
+            case Field::Z:
+                return p.Z * header->z_scale_factor + header->z_offset;
+            case Field::Intensity: return p.intensity;
+            case Field::ReturnNumber:
+                return ext ? p.extended_return_number : p.return_number;
+            case Field::NumberOfReturns:
+                return ext ? p.extended_number_of_returns : p.number_of_returns;
+            case Field::ScanDirectionFlag: return p.scan_direction_flag;
+            case Field::EdgeOfFlightLine: return p.edge_of_flight_line;
+            case Field::Classification:
+                return ext ? p.extended_classification : p.classification;
+            case Field::Synthetic: return flags & 0x01;
+            case Field::KeyPoint: return (flags >> 1) & 0x01;
+            case Field::Withheld: return (flags >> 2) & 0x01;
+            case Field::Overlap: return (flags >> 3) & 0x01;
+            case Field::ClassFlags: return flags;
+            case Field::ScanChannel: return p.extended_scanner_channel;
+            case Field::ScanAngleRank:
+                return ext
+                    ? static_cast<float>(p.extended_scan_angle * .006f)
+                    : p.scan_angle_rank;
+            case Field::UserData: return p.user_data;
+            case Field::PointSourceId: return p.point_source_ID;
+            case Field::GpsTime: return p.gps_time;
+            case Field::Red: return p.rgb[0];
+            case Field::Green: return p.rgb[1];
+            case Field::Blue: return p.rgb[2];
+            case Field::Infrared: return p.rgb[3];
+        }
+        return 0;
+    }
+
+    // LASzip reads from this stream until it is closed, so it must outlive
+    // the reader.
+    std::unique_ptr<std::istream> stream;
+
+    laszip_POINTER laszip = nullptr;
+    laszip_header* header = nullptr;
+    laszip_point* point = nullptr;
+    int format = 0;
+    uint64_t points = 0;
+};
+
+#else
+
+struct NativeReader::Impl
+{
+    explicit Impl(std::string) { }
+    explicit Impl(std::unique_ptr<std::istream>) { }
+
+    int format = 0;
+    uint64_t points = 0;
+
+    void next() { }
+    double get(Field) const { return 0; }
+};
+
+#endif
+
+bool NativeReader::accepts(const SourceInfo& info, const std::string path)
+{
+#ifdef ENTWINE_HAVE_LASZIP
+    if (!isTrivial(info.pipeline, path) || info.schema.empty()) return false;
+
+    // Point format 8 produces every dimension which we are able to decode.
+    const auto native(getNativeDimensions(8));
+    for (const auto& d : info.schema)
+    {
+        if (d.name == "OriginId") continue;
+        if (std::find(native.begin(), native.end(), d.name) == native.end())
+        {
+            return false;
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::unique_ptr<NativeReader> NativeReader::create(
+    const SourceInfo& info,
+    const std::string path,
+    const std::string localPath)
+{
+    if (!accepts(info, path)) return { };
+    return create(info, makeUnique<Impl>(localPath));
+}
+
+std::unique_ptr<NativeReader> NativeReader::create(
+    const SourceInfo& info,
+    const std::string path,
+    std::unique_ptr<std::istream> stream)
+{
+    if (!accepts(info, path)) return { };
+    return create(info, makeUnique<Impl>(std::move(stream)));
+}
+
+std::unique_ptr<NativeReader> NativeReader::create(
+    const SourceInfo& info,
+    std::unique_ptr<Impl> impl)
+{
+#ifdef ENTWINE_HAVE_LASZIP
+    const int format(impl->format);
+    if (!isSupported(format)) return { };
+
+    const uint64_t length(impl->header->point_data_record_length);
+    if (length != getBaseRecordLength(format)) return { };
+
+    // If our analysis found any dimensions that we wouldn't produce, then
+    // PDAL knows something that we don't.
+    const auto native(getNativeDimensions(format));
+    for (const auto& d : info.schema)
+    {
+        if (d.name == "OriginId") continue;
+        if (std::find(native.begin(), native.end(), d.name) == native.end())
+        {
+            return { };
+        }
+    }
+
+    return std::unique_ptr<NativeReader>(new NativeReader(std::move(impl)));
+#else
+    return { };
+#endif
+}
+
+NativeReader::NativeReader(std::unique_ptr<Impl> impl)
+    : m_impl(std::move(impl))
+{ }
+
+NativeReader::~NativeReader() { }
+
+void NativeReader::read(VectorPointTable& table, optional<Bounds> statsBounds)
+{
+    Impl& impl(*m_impl);
+
+    const pdal::PointLayout& layout(*table.layout());
+    const uint64_t pointSize(layout.pointSize());
+    const uint64_t capacity(table.capacity());
+
+    struct Target
+    {
+        Field field;
+        uint64_t offset;
+        DimType type;
+    };
+
+    // Dimensions of the output which this file doesn't have are left alone,
+    // as PDAL would leave them.
+    const auto native(getNativeDimensions(impl.format));
+
+    std::vector<Target> targets;
+    for (const DimId id : layout.dims())
+    {
+        const std::string name(layout.dimName(id));
+        if (std::find(native.begin(), native.end(), name) != native.end())
+        {
+            targets.push_back(
+                { *findField(name), layout.dimOffset(id), layout.dimType(id) });
+        }
+    }
+
+    std::vector<Field> stats;
+    if (statsBounds)
+    {
+        for (const auto& name : native) stats.push_back(*findField(name));
+    }
+
+    std::vector<Field> fields;
+    for (const auto& t : targets) fields.push_back(t.field);
+    fields.insert(fields.end(), stats.begin(), stats.end());
+    if (statsBounds)
+    {
+        fields.push_back(Field::X);
+        fields.push_back(Field::Y);
+    }
+    std::sort(fields.begin(), fields.end());
+    fields.erase(std::unique(fields.begin(), fields.end()), fields.end());
+
+    std::array<std::vector<double>, fieldNames.size()> columns;
+    for (const Field f : fields) columns[toIndex(f)].resize(capacity);
+
+    std::array<Accumulator, fieldNames.size()> accumulators;
+    accumulators[toIndex(Field::Classification)].enumerate = true;
+
+    std::vector<char> inBounds(capacity);
+
+    uint64_t remaining(impl.points);
+    while (remaining)
+    {
+        const uint64_t n(std::min(remaining, capacity));
+        remaining -= n;
+
+        // Decode this batch into columns.
+        for (uint64_t i(0); i < n; ++i)
+        {
+            impl.next();
+            for (const Field f : fields) columns[toIndex(f)][i] = impl.get(f);
+        }
+
+        // Convert each column into the table layout.
+        char* base(table.getPoint(0));
+        for (const Target& t : targets)
+        {
+            convert(
+                columns[toIndex(t.field)],
+                n,
+                base + t.offset,
+                pointSize,
+                t.type);
+        }
+
+        if (statsBounds)
+        {
+            const auto& min(statsBounds->min());
+            const auto& max(statsBounds->max());
+            const auto& xs(columns[toIndex(Field::X)]);
+            const auto& ys(columns[toIndex(Field::Y)]);
+
+            for (uint64_t i(0); i < n; ++i)
+            {
+                inBounds[i] =
+                    xs[i] >= min.x && xs[i] < max.x &&
+                    ys[i] >= min.y && ys[i] < max.y;
+            }
+
+            for (const Field f : stats)
+            {
+                const auto& column(columns[toIndex(f)]);
+                Accumulator& a(accumulators[toIndex(f)]);
+                for (uint64_t i(0); i < n; ++i)
+                {
+                    if (inBounds[i]) a.add(column[i]);
+                }
+            }
+        }
+
+        table.clear(n);
+    }
+
+    m_stats.clear();
+    for (const Field f : stats)
+    {
+        m_stats[fieldNames[toIndex(f)]] = accumulators[toIndex(f)].get();
+    }
+}
+
+} // namespace entwine
@@ -0,0 +1,87 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <entwine/types/bounds.hpp>
+#include <entwine/types/dimension-stats.hpp>
+#include <entwine/types/source.hpp>
+#include <entwine/types/vector-point-table.hpp>
+#include <entwine/util/optional.hpp>
+
+namespace entwine
+{
+
+// Reads LAS/LAZ files with LASzip directly, bypassing PDAL pipeline
+// construction.  Points are decoded a batch at a time into columns, which are
+// then converted into the table's layout one dimension at a time.
+//
+// This is only used for sources whose pipeline is a lone LAS reader with no
+// options, and whose dimensions we know how to decode - for anything else,
+// create() returns null and PDAL should be used.  Without LASzip support, that
+// is always the case.
+class NativeReader
+{
+public:
+    using Stats = std::map<std::string, DimensionStats>;
+
+    // Whether this source may be read natively, as far as can be told without
+    // reading its header.  If true, create() may still return null.
+    static bool accepts(const SourceInfo& info, std::string path);
+
+    static std::unique_ptr<NativeReader> create(
+        const SourceInfo& info,
+        std::string path,
+        std::string localPath);
+
+    // Read from a stream rather than a local file, for example a RangedStream
+    // over a remote file.  The stream is owned by the reader.
+    static std::unique_ptr<NativeReader> create(
+        const SourceInfo& info,
+        std::string path,
+        std::unique_ptr<std::istream> stream);
+
+    ~NativeReader();
+
+    // Read every point into the table, calling its process function after
+    // each batch.  If stats bounds are supplied, then stats are accumulated
+    // for the points whose XY coordinates fall within them.
+    void read(VectorPointTable& table, optional<Bounds> statsBounds = { });
+
+    // Statistics for each native dimension of the source, populated by read.
+    const Stats& stats() const { return m_stats; }
+
+private:
+    struct Impl;
+    explicit NativeReader(std::unique_ptr<Impl> impl);
+
+    static std::unique_ptr<NativeReader> create(
+        const SourceInfo& info,
+        std::unique_ptr<Impl> impl);
+
+    NativeReader(const NativeReader&);
+    NativeReader& operator=(const NativeReader&);
+
+    std::unique_ptr<Impl> m_impl;
+    Stats m_stats;
+};
+
+// The names of the dimensions produced for a given LAS point format, or an
+// empty list if the format is not supported natively.
+std::vector<std::string> getNativeDimensions(int pointFormat);
+
+} // namespace entwine
@@ -0,0 +1,190 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/builder/prefetcher.hpp>
+
+#include <stdexcept>
+
+#include <entwine/util/io.hpp>
+
+namespace entwine
+{
+
+Prefetcher::Prefetcher(
+    const arbiter::Arbiter& a,
+    const StringList& paths,
+    const uint64_t maxFiles,
+    const uint64_t maxBytes)
+    : m_arbiter(a)
+    , m_maxFiles(maxFiles)
+    , m_maxBytes(maxBytes)
+{
+    for (const auto& path : paths)
+    {
+        if (m_arbiter.isLocal(path) || m_index.count(path)) continue;
+        m_index[path] = m_entries.size();
+        m_entries.emplace_back(path);
+    }
+
+    const uint64_t threads(std::min<uint64_t>(m_maxFiles, m_entries.size()));
+    for (uint64_t i(0); i < threads; ++i)
+    {
+        m_threads.emplace_back([this]() { work(); });
+    }
+}
+
+Prefetcher::~Prefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_done = true;
+    }
+    m_cv.notify_all();
+
+    for (auto& t : m_threads) t.join();
+
+    // Any unclaimed downloads are removed here, which calls back into our
+    // budget accounting, so do this while we are still intact.
+    m_entries.clear();
+}
+
+void Prefetcher::work()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true)
+    {
+        m_cv.wait(lock, [this]()
+        {
+            return
+                m_done ||
+                m_next >= m_entries.size() ||
+                m_active < m_maxFiles;
+        });
+
+        if (m_done || m_next >= m_entries.size()) return;
+
+        Entry& entry(m_entries[m_next++]);
+        if (entry.state != State::Queued) continue;
+
+        entry.state = State::Reserved;
+        ++m_active;
+
+        lock.unlock();
+        uint64_t size(0);
+        try
+        {
+            if (const auto s = m_arbiter.tryGetSize(entry.path)) size = *s;
+        }
+        catch (...) { }
+        lock.lock();
+
+        m_cv.wait(lock, [this, &entry, size]()
+        {
+            return
+                m_done ||
+                entry.state == State::Taken ||
+                !m_bytes ||
+                m_bytes + size <= m_maxBytes;
+        });
+
+        // While we were waiting for room, a worker may have arrived for this
+        // path and fetched it itself.
+        if (m_done) return;
+        if (entry.state == State::Taken) continue;
+
+        entry.state = State::Fetching;
+        m_bytes += size;
+
+        lock.unlock();
+
+        Handle handle;
+        std::string error;
+        try
+        {
+            auto local(ensureGetLocalHandle(m_arbiter, entry.path));
+            const std::string localPath(local.release());
+            handle = Handle(
+                new arbiter::LocalHandle(localPath, true),
+                [this, size](arbiter::LocalHandle* h)
+                {
+                    delete h;
+                    release(size);
+                });
+        }
+        catch (std::exception& e) { error = e.what(); }
+        catch (...) { error = "Unknown error fetching " + entry.path; }
+
+        lock.lock();
+
+        if (!handle) m_bytes -= size;
+        entry.handle = handle;
+        entry.error = error;
+        entry.state = State::Ready;
+
+        m_cv.notify_all();
+    }
+}
+
+Prefetcher::Handle Prefetcher::get(const std::string& path)
+{
+    const auto it(m_index.find(path));
+    if (it == m_index.end()) return fetch(path);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    Entry& entry(m_entries[it->second]);
+
+    if (entry.state == State::Taken) return fetch(path);
+
+    if (entry.state == State::Queued || entry.state == State::Reserved)
+    {
+        // We've gotten ahead of the prefetcher - rather than waiting for it,
+        // fetch this one ourselves.
+        if (entry.state == State::Reserved) --m_active;
+        entry.state = State::Taken;
+
+        lock.unlock();
+        m_cv.notify_all();
+        return fetch(path);
+    }
+
+    m_cv.wait(lock, [&entry]() { return entry.state == State::Ready; });
+
+    entry.state = State::Taken;
+    --m_active;
+
+    Handle handle;
+    std::swap(handle, entry.handle);
+    const std::string error(entry.error);
+
+    lock.unlock();
+    m_cv.notify_all();
+
+    if (!handle) throw std::runtime_error(error);
+    return handle;
+}
+
+Prefetcher::Handle Prefetcher::fetch(const std::string& path) const
+{
+    auto local(ensureGetLocalHandle(m_arbiter, path));
+    const bool remote(!m_arbiter.isLocal(path));
+    return std::make_shared<arbiter::LocalHandle>(local.release(), remote);
+}
+
+void Prefetcher::release(const uint64_t size)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bytes -= size;
+    }
+    m_cv.notify_all();
+}
+
+} // namespace entwine
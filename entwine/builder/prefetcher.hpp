@@ -0,0 +1,92 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/types/defs.hpp>
+
+namespace entwine
+{
+
+// Downloads upcoming remote inputs to local temporary files while earlier
+// ones are being inserted.  At most maxFiles inputs are downloading or
+// awaiting insertion at once, and at most maxBytes of them may be on disk.  A
+// single input larger than this budget may still be fetched once nothing else
+// is outstanding.
+//
+// Paths should be listed in the order in which they will be requested.  Local
+// paths are not prefetched.
+class Prefetcher
+{
+public:
+    using Handle = std::shared_ptr<arbiter::LocalHandle>;
+
+    Prefetcher(
+        const arbiter::Arbiter& a,
+        const StringList& paths,
+        uint64_t maxFiles,
+        uint64_t maxBytes);
+    ~Prefetcher();
+
+    // Get a local handle for this path, waiting for it if its download is in
+    // progress.  If the download has not started yet, the path is fetched on
+    // the calling thread instead.  The file is removed, and its space in our
+    // budget released, when the last copy of the returned handle is destroyed.
+    Handle get(const std::string& path);
+
+private:
+    Prefetcher(const Prefetcher&);
+    Prefetcher& operator=(const Prefetcher&);
+
+    enum class State { Queued, Reserved, Fetching, Ready, Taken };
+
+    struct Entry
+    {
+        Entry(std::string path) : path(path) { }
+
+        std::string path;
+        State state = State::Queued;
+        Handle handle;
+        std::string error;
+    };
+
+    void work();
+    Handle fetch(const std::string& path) const;
+    void release(uint64_t size);
+
+    const arbiter::Arbiter& m_arbiter;
+    const uint64_t m_maxFiles;
+    const uint64_t m_maxBytes;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+
+    std::vector<Entry> m_entries;
+    std::map<std::string, uint64_t> m_index;
+
+    uint64_t m_next = 0;
+    uint64_t m_active = 0;
+    uint64_t m_bytes = 0;
+    bool m_done = false;
+
+    std::vector<std::thread> m_threads;
+};
+
+} // namespace entwine
@@ -0,0 +1,226 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/builder/time-index.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#include <entwine/builder/hierarchy.hpp>
+#include <entwine/util/binary-file.hpp>
+#include <entwine/util/io.hpp>
+
+namespace entwine
+{
+
+namespace
+{
+
+unsigned getBin(const Range& r, const double t)
+{
+    const double width((r.max - r.min) / TimeIndex::bins);
+    if (width <= 0) return 0;
+    return std::min<unsigned>(
+        TimeIndex::bins - 1,
+        static_cast<unsigned>((t - r.min) / width));
+}
+
+} // unnamed namespace
+
+bool TimeIndex::Entry::overlaps(const double begin, const double end) const
+{
+    if (!range.overlaps(begin, end)) return false;
+
+    const unsigned lo(getBin(range, std::max(begin, range.min)));
+    const unsigned hi(getBin(range, std::min(end, range.max)));
+    for (unsigned bin(lo); bin <= hi; ++bin)
+    {
+        if (mask & (uint32_t(1) << bin)) return true;
+    }
+    return false;
+}
+
+void TimeIndex::Entry::mark(const double t)
+{
+    mask |= uint32_t(1) << getBin(range, t);
+}
+
+TimeIndex::Entry TimeIndex::create(const Range& range)
+{
+    Entry entry;
+    entry.range = range;
+    entry.subtree = range;
+    return entry;
+}
+
+void TimeIndex::set(const Dxyz& key, const Entry& entry)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Entry& e(m_entries[key]);
+    e.range = entry.range;
+    e.mask = entry.mask;
+    e.subtree.grow(entry.range);
+
+    // Our ancestors may not have been written yet, in which case they are
+    // created with empty ranges of their own.
+    Dxyz k(key);
+    while (k.d)
+    {
+        k = Dxyz(k.d - 1, k.x >> 1, k.y >> 1, k.z >> 1);
+        m_entries[k].subtree.grow(entry.range);
+    }
+
+    m_changed = true;
+}
+
+void TimeIndex::restore(const Dxyz& key, const Entry& entry)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries[key] = entry;
+}
+
+bool TimeIndex::find(const Dxyz& key, Entry& entry) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto it(m_entries.find(key));
+    if (it == m_entries.end()) return false;
+    entry = it->second;
+    return true;
+}
+
+uint64_t TimeIndex::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+}
+
+bool TimeIndex::changed() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_changed;
+}
+
+void TimeIndex::clearChanged()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_changed = false;
+}
+
+std::vector<Dxyz> TimeIndex::query(const double begin, const double end) const
+{
+    std::vector<Dxyz> out;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    query(Dxyz(), begin, end, out);
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+void TimeIndex::query(
+    const Dxyz& key,
+    const double begin,
+    const double end,
+    std::vector<Dxyz>& out) const
+{
+    const auto it(m_entries.find(key));
+    if (it == m_entries.end()) return;
+
+    const Entry& entry(it->second);
+    if (!entry.subtree.overlaps(begin, end)) return;
+    if (entry.overlaps(begin, end)) out.push_back(key);
+
+    for (uint64_t dir(0); dir < 8; ++dir)
+    {
+        const Dxyz child(
+            key.d + 1,
+            (key.x << 1) | (dir & 1),
+            (key.y << 1) | ((dir >> 1) & 1),
+            (key.z << 1) | ((dir >> 2) & 1));
+        query(child, begin, end, out);
+    }
+}
+
+namespace timeindex
+{
+
+namespace
+{
+
+const std::string magic("ETIX");
+constexpr uint32_t version = 1;
+constexpr uint64_t recordSize = 56;
+
+} // unnamed namespace
+
+void save(
+    const TimeIndex& index,
+    const arbiter::Endpoint& ep,
+    const std::string postfix)
+{
+    std::vector<char> data(BinaryFile::makeHeader(magic, version, 0));
+
+    uint64_t count(0);
+    char record[recordSize] = { };
+    index.forEach([&](const Dxyz& key, const TimeIndex::Entry& e)
+    {
+        const auto k(Hierarchy::pack(key));
+        std::memcpy(record, &k.first, 8);
+        std::memcpy(record + 8, &k.second, 8);
+        std::memcpy(record + 16, &e.range.min, 8);
+        std::memcpy(record + 24, &e.range.max, 8);
+        std::memcpy(record + 32, &e.subtree.min, 8);
+        std::memcpy(record + 40, &e.subtree.max, 8);
+        std::memcpy(record + 48, &e.mask, 4);
+
+        data.insert(data.end(), record, record + recordSize);
+        ++count;
+    });
+
+    std::memcpy(data.data() + 8, &count, sizeof(count));
+    ensurePut(ep, getFilename(postfix), data);
+}
+
+void load(
+    TimeIndex& index,
+    const arbiter::Endpoint& ep,
+    const std::string postfix,
+    Hedge* hedge)
+{
+    const BinaryFile file(
+        ep,
+        getFilename(postfix),
+        magic,
+        version,
+        "time index",
+        hedge);
+    file.checkRecords(recordSize);
+
+    for (uint64_t i(0); i < file.count(); ++i)
+    {
+        const char* pos(file.data() + BinaryFile::headerSize + i * recordSize);
+
+        uint64_t hi(0), lo(0);
+        TimeIndex::Entry e;
+        std::memcpy(&hi, pos, 8);
+        std::memcpy(&lo, pos + 8, 8);
+        std::memcpy(&e.range.min, pos + 16, 8);
+        std::memcpy(&e.range.max, pos + 24, 8);
+        std::memcpy(&e.subtree.min, pos + 32, 8);
+        std::memcpy(&e.subtree.max, pos + 40, 8);
+        std::memcpy(&e.mask, pos + 48, 4);
+        index.restore(Hierarchy::unpack(hi, lo), e);
+    }
+
+    index.clearChanged();
+}
+
+} // namespace timeindex
+} // namespace entwine
@@ -0,0 +1,113 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/types/key.hpp>
+#include <entwine/types/range.hpp>
+
+namespace entwine
+{
+
+class Hedge;
+
+// A secondary index of the GpsTime values of each node, so that the nodes
+// which may hold points within a time window can be found without fetching
+// any node data.
+//
+// Each node records the range of its own times, split into equal bins of
+// which those holding any points are flagged, along with the range of times
+// of its entire subtree.  Setting a node grows the subtree ranges of its
+// ancestors, so queries may skip whole subtrees.  As for NodeStatsMap, the
+// index is held entirely in memory.
+class TimeIndex
+{
+public:
+    static constexpr unsigned bins = 32;
+
+    struct Entry
+    {
+        Range range;
+        uint32_t mask = 0;
+        Range subtree;
+
+        // Flag the bin holding this time, which must lie within our range.
+        void mark(double t);
+
+        // Whether any of our own points may lie within [begin, end].
+        bool overlaps(double begin, double end) const;
+    };
+
+    // Create the entry for a node from the range of its times, which must be
+    // known before its points are visited.  Each point then flags its bin
+    // with Entry::mark.
+    static Entry create(const Range& range);
+
+    void set(const Dxyz& key, const Entry& entry);
+    bool find(const Dxyz& key, Entry& entry) const;
+    uint64_t size() const;
+
+    // True if any node has been set since the last call to clearChanged().
+    bool changed() const;
+    void clearChanged();
+
+    // The nodes which may hold points within [begin, end], in key order.
+    std::vector<Dxyz> query(double begin, double end) const;
+
+    // Entries are read back as they were written, with their subtree ranges.
+    void restore(const Dxyz& key, const Entry& entry);
+    template <typename F> void forEach(F f) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& p : m_entries) f(p.first, p.second);
+    }
+
+private:
+    void query(
+        const Dxyz& key,
+        double begin,
+        double end,
+        std::vector<Dxyz>& out) const;
+
+    mutable std::mutex m_mutex;
+    std::map<Dxyz, Entry> m_entries;
+    bool m_changed = false;
+};
+
+namespace timeindex
+{
+
+// The index is a single binary file.  After a header holding a magic number,
+// a format version, and the node count, each node is written as its packed
+// key, its time range, the range of its subtree, and its bin mask, in key
+// order.  Nodes with no points of their own have an empty range and mask.
+inline std::string getFilename(std::string postfix = "")
+{
+    return "ept-time-index" + postfix + ".bin";
+}
+void save(
+    const TimeIndex& index,
+    const arbiter::Endpoint& ep,
+    std::string postfix = "");
+void load(
+    TimeIndex& index,
+    const arbiter::Endpoint& ep,
+    std::string postfix = "",
+    Hedge* hedge = nullptr);
+
+} // namespace timeindex
+} // namespace entwine
@@ -11,13 +11,15 @@
 #include <entwine/io/binary.hpp>
 
 #include <algorithm>
+#include <memory>
 
 #include <pdal/PointRef.hpp>
 
 #include <entwine/types/dimension.hpp>
 #include <entwine/types/metadata.hpp>
 #include <entwine/types/scale-offset.hpp>
-#include <entwine/util/io.hpp>
+#include <entwine/util/mmap.hpp>
+#include <entwine/util/unique.hpp>
 
 namespace entwine
 {
@@ -27,22 +29,48 @@ namespace io
 void Binary::write(
     const std::string filename,
     BlockPointTable& table,
-    const Bounds bounds) const
+    const Bounds bounds,
+    PointVisitor* visitor) const
 {
-    const auto packed = binary::pack(metadata, table);
-    ensurePut(endpoints.data, filename + ".bin", packed);
+    put(filename + ".bin", binary::pack(metadata, table, visitor));
 }
 
 void Binary::read(std::string filename, VectorPointTable& table) const
 {
-    auto packed = ensureGetBinary(endpoints.data, filename + ".bin");
+    // This node may have been serialized recently and still be in flight.
+    await(filename + ".bin");
+
+    // For local data, decode directly from a mapping of the file rather than
+    // copying it into memory first.  If it can't be opened, fall back to a
+    // regular read, which retries before failing.
+    if (endpoints.data.isLocal() && !isBundled(filename + ".bin"))
+    {
+        std::unique_ptr<MappedFile> file;
+        try
+        {
+            file = makeUnique<MappedFile>(
+                endpoints.data.fullPath(filename + ".bin"));
+        }
+        catch (...) { }
+
+        if (file)
+        {
+            binary::unpack(metadata, table, file->data(), file->size());
+            return;
+        }
+    }
+
+    auto packed = get(filename + ".bin");
     binary::unpack(metadata, table, std::move(packed));
 }
 
 namespace binary
 {
 
-std::vector<char> pack(const Metadata& m, BlockPointTable& src)
+std::vector<char> pack(
+    const Metadata& m,
+    BlockPointTable& src,
+    PointVisitor* visitor)
 {
     const uint64_t np(src.size());
 
@@ -76,6 +104,8 @@ std::vector<char> pack(const Metadata& m, BlockPointTable& src)
         dstPr.setPointId(i);
         char* pos(dst.getPoint(i));
 
+        if (visitor) visitor->visit(srcPr);
+
         // Handle XYZ, applying transformation if needed.
         p.x = srcPr.getFieldAs<double>(DimId::X);
         p.y = srcPr.getFieldAs<double>(DimId::Y);
@@ -101,9 +131,18 @@ void unpack(
     const Metadata& m,
     VectorPointTable& dst,
     std::vector<char>&& packed)
+{
+    unpack(m, dst, packed.data(), packed.size());
+}
+
+void unpack(
+    const Metadata& m,
+    VectorPointTable& dst,
+    const char* data,
+    const uint64_t size)
 {
     auto scaledLayout = toLayout(m.schema, false);
-    VectorPointTable src(scaledLayout, std::move(packed));
+    BufferPointTable src(scaledLayout, data, size);
 
     const uint64_t np(src.capacity());
     assert(np == dst.capacity());
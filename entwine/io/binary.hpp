@@ -26,7 +26,8 @@ struct Binary : public Io
     virtual void write(
         std::string filename,
         BlockPointTable& table,
-        const Bounds bounds) const override;
+        const Bounds bounds,
+        PointVisitor* visitor = nullptr) const override;
 
     void read(std::string filename, VectorPointTable& table) const override;
 };
@@ -34,11 +35,19 @@ struct Binary : public Io
 namespace binary
 {
 
-std::vector<char> pack(const Metadata& metadata, BlockPointTable& src);
+std::vector<char> pack(
+    const Metadata& metadata,
+    BlockPointTable& src,
+    PointVisitor* visitor = nullptr);
 void unpack(
     const Metadata& m,
     VectorPointTable& dst,
     std::vector<char>&& buffer);
+void unpack(
+    const Metadata& m,
+    VectorPointTable& dst,
+    const char* data,
+    uint64_t size);
 
 } // namespace binary
 } // namespace io
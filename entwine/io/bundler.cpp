@@ -0,0 +1,413 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/io/bundler.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include <entwine/types/exceptions.hpp>
+#include <entwine/types/key.hpp>
+#include <entwine/util/io.hpp>
+#include <entwine/util/json.hpp>
+#include <entwine/util/memory-driver.hpp>
+#include <entwine/util/pool.hpp>
+
+namespace entwine
+{
+
+namespace
+{
+
+std::vector<char> readFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.good()) throw std::runtime_error("Could not open " + path);
+
+    std::vector<char> data(static_cast<std::size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(data.data(), data.size());
+    if (!file.good()) throw std::runtime_error("Could not read " + path);
+    return data;
+}
+
+std::vector<char> readRange(
+    const std::string& path,
+    const uint64_t begin,
+    const uint64_t end)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::vector<char> data(end - begin);
+    file.seekg(begin);
+    file.read(data.data(), data.size());
+    if (!file.good()) throw std::runtime_error("Could not read " + path);
+    return data;
+}
+
+void writeFile(const std::string& path, const std::vector<char>& data)
+{
+    // Write to a temporary file first, so a concurrent reader never sees a
+    // partially written node.
+    const std::string partial(path + ".partial");
+    {
+        std::ofstream file(partial, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), data.size());
+        if (!file.good()) throw std::runtime_error("Could not write " + path);
+    }
+
+    if (std::rename(partial.c_str(), path.c_str()))
+    {
+        throw std::runtime_error("Could not write " + path);
+    }
+}
+
+// Order filenames by their node keys, so shards are laid out breadth-first.
+bool byKey(const std::string& a, const std::string& b)
+{
+    const Dxyz da(a.substr(0, a.find('.')));
+    const Dxyz db(b.substr(0, b.find('.')));
+    if (da == db) return a < b;
+    return da < db;
+}
+
+// The most retained bytes carried over from a prior shard by a single read.
+constexpr uint64_t maxRangeSize = 64 * 1024 * 1024;
+
+} // unnamed namespace
+
+Bundler::Bundler(
+    const Endpoints& endpoints,
+    const uint64_t step,
+    const uint64_t splits)
+    : m_endpoints(endpoints)
+    , m_step(step)
+    , m_staging(
+        endpoints.tmp.prefixedRoot() + "bundle-" +
+        std::to_string(arbiter::randomNumber()) + "/")
+{
+    if (!m_step) throw ConfigurationError("Invalid bundle step");
+    if (m_step < splits)
+    {
+        throw ConfigurationError(
+            "Bundle step must be at least the subset split depth, so that "
+            "each shard is written by only one subset");
+    }
+    if (!endpoints.tmp.isLocal())
+    {
+        throw ConfigurationError("Bundling requires a local tmp directory");
+    }
+
+    arbiter::mkdirp(m_staging);
+}
+
+Bundler::~Bundler()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& shard : m_staged)
+    {
+        for (const auto& f : shard.second) arbiter::remove(stagedPath(f));
+    }
+    arbiter::remove(m_staging);
+}
+
+std::string Bundler::getShard(const std::string& filename, const uint64_t step)
+{
+    if (!step) return "";
+
+    // Data files are named by their key, possibly followed by a subset
+    // postfix, and then an extension.  Postfixed files are never bundled.
+    const std::string stem(filename.substr(0, filename.find('.')));
+    if (std::count(stem.begin(), stem.end(), '-') != 3) return "";
+
+    const bool valid(std::all_of(stem.begin(), stem.end(), [](char c)
+    {
+        return c == '-' || std::isdigit(static_cast<unsigned char>(c));
+    }));
+    if (!valid || stem.front() == '-' || stem.back() == '-') return "";
+
+    const Dxyz key(stem);
+    if (key.d < step) return "";
+
+    const uint64_t d((key.d / step) * step);
+    const uint64_t shift(key.d - d);
+    return Dxyz(d, key.p.x >> shift, key.p.y >> shift, key.p.z >> shift)
+        .toString();
+}
+
+bool Bundler::isBundled(const std::string& filename) const
+{
+    return getShard(filename, m_step).size();
+}
+
+std::string Bundler::stagedPath(const std::string& filename) const
+{
+    return m_staging + filename;
+}
+
+void Bundler::put(const std::string& filename, const std::vector<char>& data)
+{
+    const std::string shard(getShard(filename, m_step));
+    if (shard.empty())
+    {
+        throw std::runtime_error("Not a bundled file: " + filename);
+    }
+
+    writeFile(stagedPath(filename), data);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_staged[shard].insert(filename);
+}
+
+std::vector<char> Bundler::get(const std::string& filename) const
+{
+    const std::string shard(getShard(filename, m_step));
+    if (shard.empty())
+    {
+        throw std::runtime_error("Not a bundled file: " + filename);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto it(m_staged.find(shard));
+        if (it != m_staged.end() && it->second.count(filename))
+        {
+            return readFile(stagedPath(filename));
+        }
+    }
+
+    const auto index(getIndex(shard));
+    const auto it(index->find(filename));
+    if (it == index->end())
+    {
+        throw std::runtime_error("Node not found in shard: " + filename);
+    }
+
+    const uint64_t offset(it->second.first);
+    const uint64_t size(it->second.second);
+    return getRange(shard, offset, offset + size);
+}
+
+std::shared_ptr<const Bundler::Index> Bundler::getIndex(
+    const std::string& shard) const
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto it(m_indexes.find(shard));
+        if (it != m_indexes.end()) return it->second;
+    }
+
+    // Fetch outside of the lock - a concurrent duplicate fetch is harmless.
+    auto index(std::make_shared<Index>());
+    const std::string name(bundle::getIndexName(shard));
+    if (m_endpoints.hierarchy.tryGetSize(name))
+    {
+        const json j(json::parse(ensureGet(m_endpoints.hierarchy, name)));
+        for (const auto& node : j.items())
+        {
+            (*index)[node.key()] = std::make_pair(
+                node.value().at(0).get<uint64_t>(),
+                node.value().at(1).get<uint64_t>());
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_indexes.emplace(shard, index).first->second;
+}
+
+std::vector<char> Bundler::getRange(
+    const std::string& shard,
+    const uint64_t begin,
+    const uint64_t end) const
+{
+    const arbiter::Endpoint& ep(m_endpoints.data);
+    const std::string name(bundle::getShardName(shard));
+
+    if (ep.isLocal()) return readRange(ep.fullPath(name), begin, end);
+
+    if (ep.isHttpDerived())
+    {
+        return ep.getBinary(name, getRangeHeader(begin, end));
+    }
+
+    const std::string path(ep.prefixedRoot() + name);
+    if (auto mem = getMemoryDriver(path))
+    {
+        return mem->getRange(arbiter::stripProtocol(path), begin, end);
+    }
+
+    // Other drivers have no ranged reads, so fetch the whole shard.
+    const std::vector<char> data(ensureGetBinary(ep, name));
+    if (end > data.size()) throw std::runtime_error("Invalid shard: " + name);
+    return std::vector<char>(data.begin() + begin, data.begin() + end);
+}
+
+void Bundler::bundle(const unsigned threads)
+{
+    std::map<std::string, std::set<std::string>> staged;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        staged = m_staged;
+    }
+    if (staged.empty()) return;
+
+    Pool pool(threads, 1, false);
+    for (const auto& shard : staged)
+    {
+        pool.add([this, &shard]() { write(shard.first, shard.second); });
+    }
+    pool.join();
+
+    if (pool.errors().size())
+    {
+        throw std::runtime_error("Bundling failed: " + pool.errors().front());
+    }
+}
+
+std::shared_ptr<MemoryDriver> Bundler::getMemoryDriver(
+    const std::string& path) const
+{
+    return std::dynamic_pointer_cast<MemoryDriver>(
+        m_endpoints.arbiter->getDriver(path));
+}
+
+bool Bundler::hasRanges() const
+{
+    const arbiter::Endpoint& ep(m_endpoints.data);
+    return ep.isLocal() || ep.isHttpDerived() ||
+        getMemoryDriver(ep.prefixedRoot());
+}
+
+void Bundler::write(
+    const std::string& shard,
+    const std::set<std::string>& staged)
+{
+    const auto previous(getIndex(shard));
+
+    std::vector<std::string> members(staged.begin(), staged.end());
+    bool retained(false);
+    for (const auto& node : *previous)
+    {
+        if (!staged.count(node.first))
+        {
+            members.push_back(node.first);
+            retained = true;
+        }
+    }
+    std::sort(members.begin(), members.end(), byKey);
+
+    const arbiter::Endpoint& ep(m_endpoints.data);
+    const std::string name(bundle::getShardName(shard));
+
+    // The shard is assembled in a staged file and then copied into place, so
+    // neither it nor its predecessor is ever held in memory as a whole.
+    const std::string path(stagedPath(name));
+
+    // Without ranged reads, the prior shard is fetched once into a staged
+    // file, from which the retained nodes are then read.
+    std::string prior;
+
+    try
+    {
+        if (retained && !hasRanges())
+        {
+            prior = stagedPath(name + ".prior");
+            ensureCopyFile(
+                *m_endpoints.arbiter,
+                ep.prefixedRoot() + name,
+                prior);
+        }
+
+        auto index(std::make_shared<Index>());
+        json j = json::object();
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        uint64_t offset(0);
+
+        const auto add = [&](const std::string& filename, uint64_t size)
+        {
+            (*index)[filename] = std::make_pair(offset, size);
+            j[filename] = { offset, size };
+            offset += size;
+        };
+
+        for (std::size_t i(0); i < members.size(); )
+        {
+            if (staged.count(members[i]))
+            {
+                const auto node(readFile(stagedPath(members[i])));
+                file.write(node.data(), node.size());
+                add(members[i++], node.size());
+                continue;
+            }
+
+            // Nodes which were not rewritten are carried over from the prior
+            // shard, with a single read for each stretch of them which is
+            // contiguous there.
+            const uint64_t begin(previous->at(members[i]).first);
+            uint64_t end(begin);
+            std::size_t n(i);
+            for ( ; n < members.size() && !staged.count(members[n]); ++n)
+            {
+                const auto& range(previous->at(members[n]));
+                if (range.first != end) break;
+                if (n > i && end + range.second - begin > maxRangeSize) break;
+                end += range.second;
+            }
+
+            const auto data(prior.size()
+                ? readRange(prior, begin, end)
+                : getRange(shard, begin, end));
+            if (data.size() != end - begin)
+            {
+                throw std::runtime_error("Invalid shard: " + shard);
+            }
+            file.write(data.data(), data.size());
+
+            for ( ; i < n; ++i)
+            {
+                add(members[i], previous->at(members[i]).second);
+            }
+        }
+
+        file.close();
+        if (!file) throw std::runtime_error("Could not write " + path);
+
+        if (prior.size()) arbiter::remove(prior);
+
+        // The shard precedes its index, so an index never refers to a shard
+        // which has not been written.
+        ensureCopyFile(*m_endpoints.arbiter, path, ep.prefixedRoot() + name);
+        arbiter::remove(path);
+        ensurePut(m_endpoints.hierarchy, bundle::getIndexName(shard), j.dump());
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_indexes[shard] = index;
+    }
+    catch (...)
+    {
+        arbiter::remove(path);
+        if (prior.size()) arbiter::remove(prior);
+        throw;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& current(m_staged[shard]);
+    for (const auto& filename : staged)
+    {
+        current.erase(filename);
+        arbiter::remove(stagedPath(filename));
+    }
+    if (current.empty()) m_staged.erase(shard);
+}
+
+} // namespace entwine
@@ -0,0 +1,109 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <entwine/types/endpoints.hpp>
+
+namespace entwine
+{
+
+class MemoryDriver;
+
+// Packs the data files of deep nodes into shard objects, rather than writing
+// one object per node.  Each node at a depth of at least the bundle step
+// belongs to the shard rooted at its ancestor whose depth is the nearest
+// multiple of the step, so a shard spans up to step levels of the tree.
+//
+// During a build, node data destined for a shard is staged on local disk.
+// When bundle() is called, each shard with staged nodes is assembled in key
+// order in a staged file, along with any of its existing nodes which were not
+// rewritten - fetched by ranged reads of the prior shard where possible - and
+// copied into place as a single object.  Its offset table is written
+// alongside the hierarchy, and nodes are then fetched from the shard with
+// range requests.
+//
+// Staged data is only released by bundle(), so the staging directory must
+// hold every bundled node written since the previous call, and is lost if the
+// process exits without making one.
+//
+// All member functions are thread-safe.
+class Bundler
+{
+public:
+    // Byte offset and size of each node within a shard, by filename.
+    using Index = std::map<std::string, std::pair<uint64_t, uint64_t>>;
+
+    // Shards must not be rooted above the subset split depth, so that each is
+    // written by only one subset.
+    Bundler(const Endpoints& endpoints, uint64_t step, uint64_t splits = 0);
+    ~Bundler();
+
+    // The root key of the shard holding this data file, or an empty string if
+    // it is not bundled.
+    static std::string getShard(const std::string& filename, uint64_t step);
+    bool isBundled(const std::string& filename) const;
+
+    void put(const std::string& filename, const std::vector<char>& data);
+    std::vector<char> get(const std::string& filename) const;
+
+    // Assemble and write every shard containing staged nodes.
+    void bundle(unsigned threads);
+
+private:
+    Bundler(const Bundler&);
+    Bundler& operator=(const Bundler&);
+
+    std::string stagedPath(const std::string& filename) const;
+    std::shared_ptr<const Index> getIndex(const std::string& shard) const;
+    std::vector<char> getRange(
+        const std::string& shard,
+        uint64_t begin,
+        uint64_t end) const;
+    std::shared_ptr<MemoryDriver> getMemoryDriver(
+        const std::string& path) const;
+
+    // Whether ranges of shards may be read without fetching them whole.
+    bool hasRanges() const;
+    void write(const std::string& shard, const std::set<std::string>& staged);
+
+    const Endpoints& m_endpoints;
+    const uint64_t m_step;
+    const std::string m_staging;
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, std::set<std::string>> m_staged;
+    mutable std::map<std::string, std::shared_ptr<const Index>> m_indexes;
+};
+
+namespace bundle
+{
+
+// The names of the shard object and its offset table for a shard root.
+inline std::string getShardName(const std::string& root)
+{
+    return root + ".shard";
+}
+inline std::string getIndexName(const std::string& root)
+{
+    return root + ".shard.json";
+}
+
+} // namespace bundle
+} // namespace entwine
@@ -14,11 +14,147 @@
 #include <entwine/types/metadata.hpp>
 
 #include <entwine/io/binary.hpp>
+#include <entwine/io/bundler.hpp>
 #include <entwine/io/laszip.hpp>
+#include <entwine/util/hedge.hpp>
+#include <entwine/util/io.hpp>
+#include <entwine/util/local-writer.hpp>
+#include <entwine/util/unique.hpp>
+#include <entwine/util/uploader.hpp>
 
 namespace entwine
 {
 
+Io::Io(const Metadata& metadata, const Endpoints& endpoints)
+    : metadata(metadata)
+    , endpoints(endpoints)
+{
+    if (endpoints.data.isLocal()) m_local = makeUnique<LocalWriter>();
+    else
+    {
+        const BuildParameters& params(metadata.internal);
+
+        m_scheduler = makeUnique<Scheduler>(params.uploadThreads);
+        m_scheduler->limit(
+            endpoints.data.prefixedRoot(),
+            { params.ioConcurrency, params.ioRate });
+
+        m_remote = makeUnique<Uploader>(
+            endpoints.data,
+            *m_scheduler,
+            params.uploadBufferSize);
+
+        // Hedged reads, and their duplicates, count against our limits.
+        if (params.hedge > 0)
+        {
+            m_hedge = makeUnique<Hedge>(*m_scheduler, params.hedge);
+        }
+    }
+
+    if (metadata.internal.bundleStep)
+    {
+        m_bundler = makeUnique<Bundler>(
+            endpoints,
+            metadata.internal.bundleStep,
+            getSharedDepth(metadata));
+    }
+}
+
+Io::~Io() { }
+
+void Io::put(const std::string path, std::vector<char> data) const
+{
+    if (isBundled(path)) m_bundler->put(path, data);
+    else if (m_local)
+    {
+        m_local->put(endpoints.data.fullPath(path), std::move(data));
+    }
+    else m_remote->put(path, std::move(data));
+}
+
+void Io::await(const std::string& path) const
+{
+    // Staged nodes are written synchronously.
+    if (isBundled(path)) return;
+
+    if (m_local) m_local->wait(endpoints.data.fullPath(path));
+    else m_remote->wait(path);
+}
+
+void Io::flush() const
+{
+    if (m_local) m_local->wait();
+    else m_remote->wait();
+}
+
+void Io::bundle(const unsigned threads) const
+{
+    if (m_bundler) m_bundler->bundle(threads);
+}
+
+bool Io::isBundled(const std::string& path) const
+{
+    return m_bundler && m_bundler->isBundled(path);
+}
+
+std::map<std::string, Scheduler::Stats> Io::stats() const
+{
+    if (m_scheduler) return m_scheduler->stats();
+    return { };
+}
+
+std::vector<char> Io::get(const std::string path) const
+{
+    if (isBundled(path)) return m_bundler->get(path);
+    if (m_local) return ensureGetBinary(endpoints.data, path);
+
+    // A hedge runs its attempts on our scheduler itself.
+    if (m_hedge) return m_hedge->getBinary(endpoints.data, path);
+
+    std::vector<char> data;
+    m_scheduler->run(
+        endpoints.data.prefixedRoot(),
+        Scheduler::Priority::High,
+        [this, &path, &data]() { data = endpoints.data.getBinary(path); });
+    return data;
+}
+
+arbiter::LocalHandle Io::getLocalHandle(const std::string path) const
+{
+    if (isBundled(path))
+    {
+        const std::string name(
+            std::to_string(arbiter::randomNumber()) + "-" + path);
+        endpoints.tmp.put(name, m_bundler->get(path));
+        return arbiter::LocalHandle(endpoints.tmp.fullPath(name), true);
+    }
+
+    if (m_local) return endpoints.data.getLocalHandle(path);
+
+    if (m_hedge)
+    {
+        // A hedged download completes in memory, so write out whichever
+        // response won.
+        const std::string name(
+            std::to_string(arbiter::randomNumber()) + "-" +
+            arbiter::getBasename(path));
+        endpoints.tmp.put(name, m_hedge->getBinary(endpoints.data, path));
+        return arbiter::LocalHandle(endpoints.tmp.fullPath(name), true);
+    }
+
+    // Take ownership of the downloaded file from within the operation, so a
+    // failed attempt cleans up after itself.
+    std::string localPath;
+    m_scheduler->run(
+        endpoints.data.prefixedRoot(),
+        Scheduler::Priority::High,
+        [this, &path, &localPath]()
+        {
+            localPath = endpoints.data.getLocalHandle(path).release();
+        });
+    return arbiter::LocalHandle(localPath, true);
+}
+
 std::unique_ptr<Io> Io::create(
     const Metadata& metadata,
     const Endpoints& endpoints)
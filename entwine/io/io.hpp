@@ -11,42 +11,91 @@
 #pragma once
 
 #include <cstdint>
+#include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <entwine/types/bounds.hpp>
 #include <entwine/types/endpoints.hpp>
 #include <entwine/types/vector-point-table.hpp>
 #include <entwine/util/json.hpp>
+#include <entwine/util/scheduler.hpp>
 
 namespace entwine
 {
 
 struct Metadata;
+class Bundler;
+class Hedge;
+class LocalWriter;
+class Uploader;
+
+// Observes each point as a writer encodes it, so that per-point work, such as
+// gathering node stats, shares the writer's pass over the data.
+struct PointVisitor
+{
+    virtual ~PointVisitor() { }
+    virtual void visit(pdal::PointRef& pr) = 0;
+};
 
 struct Io
 {
-    Io(
-        const Metadata& metadata,
-        const Endpoints& endpoints)
-        : metadata(metadata)
-        , endpoints(endpoints)
-    { }
-    virtual ~Io() { }
+    Io(const Metadata& metadata, const Endpoints& endpoints);
+    virtual ~Io();
 
     static std::unique_ptr<Io> create(
         const Metadata& metadata,
         const Endpoints& endpoints);
 
+    // If visitor is given, it is shown each point of the table as it is
+    // written.
     virtual void write(
         std::string filename,
         BlockPointTable& table,
-        const Bounds bounds) const = 0;
+        const Bounds bounds,
+        PointVisitor* visitor = nullptr) const = 0;
 
     virtual void read(std::string filename, VectorPointTable& table) const = 0;
 
+    // Complete any outstanding asynchronous writes, throwing on failure.
+    void flush() const;
+
+    // Write any staged nodes into their shards, if bundling is enabled.
+    void bundle(unsigned threads) const;
+
+    // I/O statistics for a remote data endpoint, or empty for local data.
+    std::map<std::string, Scheduler::Stats> stats() const;
+
     const Metadata& metadata;
     const Endpoints& endpoints;
+
+protected:
+    // Write to the data endpoint asynchronously.  Local writes are batched,
+    // and remote writes are handed off to a write-behind upload stage so the
+    // encoding thread does not wait on the network.
+    void put(std::string path, std::vector<char> data) const;
+
+    // Wait for any pending write of this path to the data endpoint, which must
+    // be done before reading it back.
+    void await(const std::string& path) const;
+
+    // Read from the data endpoint.  Remote reads are scheduled ahead of any
+    // pending uploads since they are on the critical path, and may be hedged
+    // if they are slow.
+    std::vector<char> get(std::string path) const;
+    arbiter::LocalHandle getLocalHandle(std::string path) const;
+
+    // Whether this path is stored within a shard rather than as an object of
+    // its own, in which case it must be written via put.
+    bool isBundled(const std::string& path) const;
+
+private:
+    std::unique_ptr<LocalWriter> m_local;
+    std::unique_ptr<Scheduler> m_scheduler;
+    std::unique_ptr<Uploader> m_remote;
+    std::unique_ptr<Hedge> m_hedge;
+    std::unique_ptr<Bundler> m_bundler;
 };
 
 namespace io
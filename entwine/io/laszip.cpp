@@ -10,7 +10,6 @@
 
 #include <entwine/io/laszip.hpp>
 
-#include <pdal/filters/SortFilter.hpp>
 #include <pdal/io/BufferReader.hpp>
 #include <pdal/io/LasReader.hpp>
 #include <pdal/io/LasWriter.hpp>
@@ -28,12 +27,14 @@ namespace io
 void Laszip::write(
     const std::string filename,
     BlockPointTable& table,
-    const Bounds bounds) const
+    const Bounds bounds,
+    PointVisitor* visitor) const
 {
     const arbiter::Endpoint& out(endpoints.data);
     const arbiter::Endpoint& tmp(endpoints.tmp);
 
-    const bool local(out.isLocal());
+    // Bundled nodes are staged via put rather than written in place.
+    const bool local(out.isLocal() && !isBundled(filename + ".laz"));
     const std::string localDir(local ? out.prefixedRoot() : tmp.prefixedRoot());
     const std::string localFile(
             (local ? filename : arbiter::crypto::encodeAsHex(filename)) +
@@ -41,7 +42,16 @@ void Laszip::write(
 
     pdal::BufferReader reader;
     auto view(std::make_shared<pdal::PointView>(table));
-    for (std::size_t i(0); i < table.size(); ++i) view->getOrAddPoint(i);
+    pdal::PointRef pr(table, 0);
+    for (std::size_t i(0); i < table.size(); ++i)
+    {
+        view->getOrAddPoint(i);
+        if (visitor)
+        {
+            pr.setPointId(i);
+            visitor->visit(pr);
+        }
+    }
     reader.addView(view);
 
     // See https://www.pdal.io/stages/writers.las.html
@@ -85,24 +95,9 @@ void Laszip::write(
 
     std::unique_lock<std::mutex> lock(PdalMutex::get());
 
-    pdal::Stage* prev(&reader);
-
-    std::unique_ptr<pdal::SortFilter> sort;
-    if (contains(metadata.schema, "GpsTime"))
-    {
-        sort = makeUnique<pdal::SortFilter>();
-
-        pdal::Options so;
-        so.add("dimension", "GpsTime");
-        sort->setOptions(so);
-        sort->setInput(*prev);
-
-        prev = sort.get();
-    }
-
     pdal::LasWriter writer;
     writer.setOptions(options);
-    writer.setInput(*prev);
+    writer.setInput(reader);
     writer.prepare(table);
 
     lock.unlock();
@@ -111,14 +106,17 @@ void Laszip::write(
 
     if (!local)
     {
-        ensurePut(out, filename + ".laz", tmp.getBinary(localFile));
+        std::vector<char> data(tmp.getBinary(localFile));
         arbiter::remove(tmp.prefixedRoot() + localFile);
+        put(filename + ".laz", std::move(data));
     }
 }
 
 void Laszip::read(std::string filename, VectorPointTable& table) const
 {
-    auto handle(endpoints.data.getLocalHandle(filename + ".laz"));
+    await(filename + ".laz");
+
+    const auto handle(getLocalHandle(filename + ".laz"));
 
     pdal::Options o;
     o.add("filename", handle.localPath());
@@ -26,7 +26,8 @@ struct Laszip : public Io
     virtual void write(
         std::string filename,
         BlockPointTable& table,
-        const Bounds bounds) const override;
+        const Bounds bounds,
+        PointVisitor* visitor = nullptr) const override;
 
     void read(std::string filename, VectorPointTable& table) const override;
 };
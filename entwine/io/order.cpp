@@ -0,0 +1,257 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/io/order.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+#include <pdal/PointRef.hpp>
+
+#include <entwine/types/dimension.hpp>
+#include <entwine/types/metadata.hpp>
+
+namespace entwine
+{
+namespace io
+{
+
+Order toOrder(const std::string s)
+{
+    if (s == "none") return Order::None;
+    if (s == "gpstime") return Order::GpsTime;
+    if (s == "morton") return Order::Morton;
+    if (s == "hilbert") return Order::Hilbert;
+    throw std::runtime_error("Invalid point order: " + s);
+}
+
+std::string toString(const Order o)
+{
+    if (o == Order::None) return "none";
+    if (o == Order::GpsTime) return "gpstime";
+    if (o == Order::Morton) return "morton";
+    if (o == Order::Hilbert) return "hilbert";
+    throw std::runtime_error("Invalid point order enumeration");
+}
+
+Order getOrder(const Metadata& metadata)
+{
+    if (metadata.internal.order) return *metadata.internal.order;
+    if (
+        (metadata.dataType == Type::Laszip || metadata.internal.timeIndex) &&
+        contains(metadata.schema, "GpsTime"))
+    {
+        return Order::GpsTime;
+    }
+    return Order::None;
+}
+
+namespace order
+{
+
+namespace
+{
+
+uint64_t spread(uint64_t v)
+{
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffff;
+    v = (v | v << 16) & 0x1f0000ff0000ff;
+    v = (v | v << 8) & 0x100f00f00f00f00f;
+    v = (v | v << 4) & 0x10c30c30c30c30c3;
+    v = (v | v << 2) & 0x1249249249249249;
+    return v;
+}
+
+std::vector<uint64_t> getGpsTimeKeys(BlockPointTable& table)
+{
+    const uint64_t np(table.size());
+    std::vector<uint64_t> keys(np);
+
+    const pdal::PointLayout& layout(*table.layout());
+    const DimId id(layout.findDim("GpsTime"));
+
+    if (layout.dimType(id) == DimType::Double)
+    {
+        // Fast path - read the raw value directly from the point data.
+        const std::size_t offset(layout.dimOffset(id));
+        double d(0);
+        for (uint64_t i(0); i < np; ++i)
+        {
+            std::memcpy(&d, table.getPoint(i) + offset, sizeof(double));
+            keys[i] = toSortable(d);
+        }
+    }
+    else
+    {
+        pdal::PointRef pr(table, 0);
+        for (uint64_t i(0); i < np; ++i)
+        {
+            pr.setPointId(i);
+            keys[i] = toSortable(pr.getFieldAs<double>(id));
+        }
+    }
+
+    return keys;
+}
+
+} // unnamed namespace
+
+uint64_t toSortable(const double d)
+{
+    uint64_t u(0);
+    std::memcpy(&u, &d, sizeof(double));
+
+    // Negative values have all of their bits flipped so larger magnitudes sort
+    // lower, positive values have only the sign bit flipped so they sort above
+    // all negative values.
+    const uint64_t sign(uint64_t(1) << 63);
+    return (u & sign) ? ~u : (u | sign);
+}
+
+uint64_t toMorton(const uint64_t x, const uint64_t y, const uint64_t z)
+{
+    return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+}
+
+uint64_t toHilbert(
+    const uint64_t x,
+    const uint64_t y,
+    const uint64_t z,
+    const unsigned bits)
+{
+    if (!bits) return 0;
+    if (bits > 21) throw std::runtime_error("Too many bits for Hilbert code");
+
+    // Transform the axes into the transposed Hilbert index - see Skilling,
+    // "Programming the Hilbert curve", AIP Conference Proceedings 707, 2004.
+    std::array<uint64_t, 3> v { { x, y, z } };
+    const uint64_t m(uint64_t(1) << (bits - 1));
+
+    for (uint64_t q(m); q > 1; q >>= 1)
+    {
+        const uint64_t p(q - 1);
+        for (std::size_t i(0); i < v.size(); ++i)
+        {
+            if (v[i] & q) v[0] ^= p;
+            else
+            {
+                const uint64_t t((v[0] ^ v[i]) & p);
+                v[0] ^= t;
+                v[i] ^= t;
+            }
+        }
+    }
+
+    for (std::size_t i(1); i < v.size(); ++i) v[i] ^= v[i - 1];
+
+    uint64_t t(0);
+    for (uint64_t q(m); q > 1; q >>= 1) if (v[2] & q) t ^= q - 1;
+    for (auto& c : v) c ^= t;
+
+    // Interleave the transposed index, most significant bits first.
+    uint64_t code(0);
+    for (int b(bits - 1); b >= 0; --b)
+    {
+        for (const uint64_t c : v) code = (code << 1) | ((c >> b) & 1);
+    }
+    return code;
+}
+
+uint64_t toCode(
+    const Order order,
+    const uint64_t x,
+    const uint64_t y,
+    const uint64_t z,
+    const unsigned bits)
+{
+    if (order == Order::Morton) return toMorton(x, y, z);
+    if (order == Order::Hilbert) return toHilbert(x, y, z, bits);
+    throw std::runtime_error("Not a spatial order: " + toString(order));
+}
+
+void sort(std::vector<uint64_t>& keys, std::vector<char*>& refs)
+{
+    if (keys.size() != refs.size())
+    {
+        throw std::runtime_error("Mismatched sort keys and references");
+    }
+
+    const std::size_t n(keys.size());
+    if (n < 2) return;
+
+    // Count all digits in a single pass over the keys.
+    constexpr std::size_t passes(sizeof(uint64_t));
+    std::array<std::array<std::size_t, 256>, passes> counts = { };
+    for (const uint64_t k : keys)
+    {
+        for (std::size_t p(0); p < passes; ++p)
+        {
+            ++counts[p][(k >> (p * 8)) & 0xff];
+        }
+    }
+
+    std::vector<uint64_t> keyScratch;
+    std::vector<char*> refScratch;
+
+    for (std::size_t p(0); p < passes; ++p)
+    {
+        auto& count(counts[p]);
+
+        // If every key shares this digit then this pass would be a no-op.
+        if (std::any_of(
+            count.begin(),
+            count.end(),
+            [n](std::size_t c) { return c == n; }))
+        {
+            continue;
+        }
+
+        if (keyScratch.empty())
+        {
+            keyScratch.resize(n);
+            refScratch.resize(n);
+        }
+
+        std::size_t offset(0);
+        for (std::size_t& c : count)
+        {
+            const std::size_t current(c);
+            c = offset;
+            offset += current;
+        }
+
+        const unsigned shift(p * 8);
+        for (std::size_t i(0); i < n; ++i)
+        {
+            const std::size_t dst(count[(keys[i] >> shift) & 0xff]++);
+            keyScratch[dst] = keys[i];
+            refScratch[dst] = refs[i];
+        }
+
+        keys.swap(keyScratch);
+        refs.swap(refScratch);
+    }
+}
+
+void sortByGpsTime(BlockPointTable& table)
+{
+    if (table.size() < 2) return;
+    if (table.layout()->findDim("GpsTime") == DimId::Unknown) return;
+
+    std::vector<uint64_t> keys(getGpsTimeKeys(table));
+    sort(keys, table.refs());
+}
+
+} // namespace order
+} // namespace io
+} // namespace entwine
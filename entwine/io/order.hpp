@@ -0,0 +1,79 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <entwine/types/vector-point-table.hpp>
+#include <entwine/util/json.hpp>
+
+namespace entwine
+{
+
+struct Metadata;
+
+namespace io
+{
+
+// The order in which the points of a node are serialized.
+enum class Order { None, GpsTime, Morton, Hilbert };
+
+Order toOrder(std::string s);
+std::string toString(Order o);
+inline void to_json(json& j, Order o) { j = toString(o); }
+inline void from_json(const json& j, Order& o)
+{
+    o = toOrder(j.get<std::string>());
+}
+
+// The serialization order for nodes of this output.  If none is configured,
+// LAZ outputs are ordered by GpsTime when available since it compresses far
+// better when it is monotonic.  Time indexed outputs are as well, since the
+// index needs the range of each node's times before its points are visited.
+Order getOrder(const Metadata& metadata);
+inline bool isSpatial(Order o)
+{
+    return o == Order::Morton || o == Order::Hilbert;
+}
+
+namespace order
+{
+
+// Map a double onto an unsigned integer which sorts in the same order.
+uint64_t toSortable(double d);
+
+// Interleave the low 21 bits of each coordinate into a 63-bit Morton code.
+uint64_t toMorton(uint64_t x, uint64_t y, uint64_t z);
+
+// Compute the position of a point along a 3D Hilbert curve of the given
+// number of bits per dimension, which must be at most 21.
+uint64_t toHilbert(uint64_t x, uint64_t y, uint64_t z, unsigned bits);
+
+// The key of a voxel position along a spatial curve.
+uint64_t toCode(
+    Order order,
+    uint64_t x,
+    uint64_t y,
+    uint64_t z,
+    unsigned bits);
+
+// Stable LSD radix sort of the references by their corresponding keys.  Both
+// vectors are reordered in place.
+void sort(std::vector<uint64_t>& keys, std::vector<char*>& refs);
+
+// Reorder the point references of this table by GpsTime, if it exists.
+void sortByGpsTime(BlockPointTable& table);
+
+} // namespace order
+} // namespace io
+} // namespace entwine
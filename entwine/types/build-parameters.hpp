@@ -13,8 +13,10 @@
 #include <cstdint>
 
 #include <entwine/builder/heuristics.hpp>
+#include <entwine/io/order.hpp>
 #include <entwine/types/defs.hpp>
 #include <entwine/util/json.hpp>
+#include <entwine/util/optional.hpp>
 
 namespace entwine
 {
@@ -30,7 +32,8 @@ struct BuildParameters
         uint64_t progressInterval,
         uint64_t hierarchyStep,
         bool verbose = true,
-        bool laz_14 = false)
+        bool laz_14 = false,
+        optional<io::Order> order = { })
         : minNodeSize(minNodeSize)
         , maxNodeSize(maxNodeSize)
         , cacheSize(cacheSize)
@@ -39,6 +42,7 @@ struct BuildParameters
         , hierarchyStep(hierarchyStep)
         , verbose(verbose)
         , laz_14(laz_14)
+        , order(order)
     { }
     BuildParameters(uint64_t minNodeSize, uint64_t maxNodeSize)
         : minNodeSize(minNodeSize)
@@ -52,8 +56,21 @@ struct BuildParameters
     uint64_t sleepCount = heuristics::sleepCount;
     uint64_t progressInterval = 10;
     uint64_t hierarchyStep = 0;
+    uint64_t bundleStep = 0;
+    bool binaryHierarchy = false;
+    bool binaryManifest = false;
+    bool nodeStats = false;
+    bool timeIndex = false;
+    uint64_t uploadThreads = heuristics::uploadThreads;
+    uint64_t uploadBufferSize = heuristics::uploadBufferSize;
+    uint64_t ioConcurrency = 0;
+    double ioRate = 0;
+    double hedge = 0;
+    uint64_t prefetch = heuristics::prefetch;
+    uint64_t prefetchBufferSize = heuristics::prefetchBufferSize;
     bool verbose = true;
     bool laz_14 = false;
+    optional<io::Order> order;
 };
 
 inline void to_json(json& j, const BuildParameters& p)
@@ -66,6 +83,12 @@ inline void to_json(json& j, const BuildParameters& p)
         { "laz_14", p.laz_14 }
     };
     if (p.hierarchyStep) j.update({ { "hierarchyStep", p.hierarchyStep } });
+    if (p.bundleStep) j.update({ { "bundleStep", p.bundleStep } });
+    if (p.binaryHierarchy) j.update({ { "binaryHierarchy", true } });
+    if (p.binaryManifest) j.update({ { "binaryManifest", true } });
+    if (p.nodeStats) j.update({ { "nodeStats", true } });
+    if (p.timeIndex) j.update({ { "timeIndex", true } });
+    if (p.order) j.update({ { "order", *p.order } });
 }
 
 } // namespace entwine
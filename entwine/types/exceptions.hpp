@@ -11,6 +11,8 @@
 #pragma once
 
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace entwine
 {
@@ -33,4 +35,19 @@ public:
     FatalError(const std::string& s) : std::runtime_error(s) { }
 };
 
+// If there are any errors, throw the first of them as a FatalError, noting how
+// many others there were.
+inline void throwFailures(const std::vector<std::string>& errors)
+{
+    if (errors.empty()) return;
+
+    std::string message(errors.front());
+    if (errors.size() > 1)
+    {
+        message += " (and " + std::to_string(errors.size() - 1) +
+            " other failures)";
+    }
+    throw FatalError(message);
+}
+
 } // namespace entwine
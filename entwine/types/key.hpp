@@ -75,6 +75,11 @@ struct Dxyz
         : Dxyz(d, p.x, p.y, p.z)
     { }
 
+    // The references must bind to our own position, not that of the source.
+    Dxyz(const Dxyz& other)
+        : Dxyz(other.d, other.p)
+    { }
+
     Dxyz(std::string v)
         : Dxyz()
     {
@@ -0,0 +1,164 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/types/node-stats.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#include <string>
+
+namespace entwine
+{
+
+namespace
+{
+
+const char* const hex = "0123456789abcdef";
+
+// The classification mask is written as a hex string, most significant digit
+// first, since its words do not fit in a double.
+std::string toHex(const std::array<uint64_t, 4>& mask)
+{
+    std::string s;
+    for (int i(255); i >= 0; i -= 4)
+    {
+        const uint64_t nibble((mask[i >> 6] >> ((i & 0x3f) - 3)) & 0xf);
+        if (nibble || s.size()) s.push_back(hex[nibble]);
+    }
+    return s.empty() ? "0" : s;
+}
+
+std::array<uint64_t, 4> fromHex(const std::string& s)
+{
+    if (s.empty() || s.size() > 64)
+    {
+        throw std::runtime_error("Invalid classification mask: " + s);
+    }
+
+    std::array<uint64_t, 4> mask {{ 0, 0, 0, 0 }};
+    uint64_t bit(0);
+    for (auto it(s.rbegin()); it != s.rend(); ++it, bit += 4)
+    {
+        const char* pos(std::find(hex, hex + 16, std::tolower(*it)));
+        if (pos == hex + 16)
+        {
+            throw std::runtime_error("Invalid classification mask: " + s);
+        }
+        mask[bit >> 6] |= uint64_t(pos - hex) << (bit & 0x3f);
+    }
+    return mask;
+}
+
+} // unnamed namespace
+
+void to_json(json& j, const NodeStats& stats)
+{
+    j = { { "bounds", stats.bounds } };
+
+    if (!stats.gpsTime.empty())
+    {
+        j["GpsTime"] = { stats.gpsTime.min, stats.gpsTime.max };
+    }
+    if (!stats.intensity.empty())
+    {
+        j["Intensity"] = { stats.intensity.min, stats.intensity.max };
+    }
+
+    const auto& c(stats.classification);
+    if (std::any_of(c.begin(), c.end(), [](uint64_t w) { return w; }))
+    {
+        j["Classification"] = toHex(c);
+    }
+}
+
+void from_json(const json& j, NodeStats& stats)
+{
+    stats = NodeStats();
+    stats.bounds = j.at("bounds").get<Bounds>();
+
+    const auto range = [&j](const std::string& name, Range& r)
+    {
+        if (!j.count(name)) return;
+        r.min = j.at(name).at(0).get<double>();
+        r.max = j.at(name).at(1).get<double>();
+    };
+    range("GpsTime", stats.gpsTime);
+    range("Intensity", stats.intensity);
+
+    if (j.count("Classification"))
+    {
+        stats.classification =
+            fromHex(j.at("Classification").get<std::string>());
+    }
+}
+
+NodeStatsMap::Shard& NodeStatsMap::shard(const Dxyz& key) const
+{
+    // Mix all of the key, since siblings differ only in their low bits.
+    const uint64_t m(0x9e3779b97f4a7c15ull);
+    uint64_t h(key.d);
+    h = (h * m) ^ key.x;
+    h = (h * m) ^ key.y;
+    h = (h * m) ^ key.z;
+    return m_shards[(h * m) >> 58];
+}
+
+void NodeStatsMap::set(const Dxyz& key, const NodeStats& stats)
+{
+    Shard& s(shard(key));
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.stats[key] = stats;
+    s.changed.insert(key);
+}
+
+bool NodeStatsMap::find(const Dxyz& key, NodeStats& stats) const
+{
+    Shard& s(shard(key));
+    std::lock_guard<std::mutex> lock(s.mutex);
+    const auto it(s.stats.find(key));
+    if (it == s.stats.end()) return false;
+    stats = it->second;
+    return true;
+}
+
+uint64_t NodeStatsMap::size() const
+{
+    uint64_t size(0);
+    for (Shard& s : m_shards)
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        size += s.stats.size();
+    }
+    return size;
+}
+
+std::vector<Dxyz> NodeStatsMap::changed() const
+{
+    std::vector<Dxyz> keys;
+    for (Shard& s : m_shards)
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        keys.insert(keys.end(), s.changed.begin(), s.changed.end());
+    }
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+void NodeStatsMap::clearChanged()
+{
+    for (Shard& s : m_shards)
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.changed.clear();
+    }
+}
+
+} // namespace entwine
@@ -0,0 +1,81 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include <entwine/types/bounds.hpp>
+#include <entwine/types/key.hpp>
+#include <entwine/types/range.hpp>
+#include <entwine/util/json.hpp>
+
+namespace entwine
+{
+
+// The tight bounds of the points of a single node, along with the ranges of
+// some of their attributes, so that queries may be pruned without fetching
+// the node's data.
+struct NodeStats
+{
+    Bounds bounds = Bounds::expander();
+    Range gpsTime;
+    Range intensity;
+
+    // Bit N is set if any point has a classification of N.
+    std::array<uint64_t, 4> classification {{ 0, 0, 0, 0 }};
+
+    void addClassification(uint8_t c)
+    {
+        classification[c >> 6] |= uint64_t(1) << (c & 0x3f);
+    }
+    bool hasClassification(uint8_t c) const
+    {
+        return classification[c >> 6] & (uint64_t(1) << (c & 0x3f));
+    }
+};
+
+void to_json(json& j, const NodeStats& stats);
+void from_json(const json& j, NodeStats& stats);
+
+// A thread-safe map of node stats by key, sharded so that concurrent chunk
+// saves rarely contend.  The keys which have been set are recorded until
+// clearChanged() is called.  Unlike the hierarchy, this is never
+// spilled, so the Builder rejects its use with a hierarchy cache size.
+class NodeStatsMap
+{
+public:
+    void set(const Dxyz& key, const NodeStats& stats);
+    bool find(const Dxyz& key, NodeStats& stats) const;
+    uint64_t size() const;
+
+    // The keys set since the last call to clearChanged(), sorted.
+    std::vector<Dxyz> changed() const;
+    void clearChanged();
+
+private:
+    struct alignas(64) Shard
+    {
+        std::mutex mutex;
+        std::map<Dxyz, NodeStats> stats;
+        std::set<Dxyz> changed;
+    };
+
+    Shard& shard(const Dxyz& key) const;
+
+    mutable std::array<Shard, 64> m_shards;
+};
+
+} // namespace entwine
@@ -0,0 +1,42 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <limits>
+
+namespace entwine
+{
+
+// A closed range of values, which is empty until grown.
+struct Range
+{
+    double min = std::numeric_limits<double>::max();
+    double max = std::numeric_limits<double>::lowest();
+
+    bool empty() const { return min > max; }
+    void grow(double v)
+    {
+        if (v < min) min = v;
+        if (v > max) max = v;
+    }
+    void grow(const Range& r)
+    {
+        if (r.empty()) return;
+        grow(r.min);
+        grow(r.max);
+    }
+    bool overlaps(double begin, double end) const
+    {
+        return !empty() && begin <= max && end >= min;
+    }
+};
+
+} // namespace entwine
@@ -9,9 +9,21 @@
 ******************************************************************************/
 
 #include <entwine/types/source.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include <entwine/util/binary-file.hpp>
 #include <entwine/util/fs.hpp>
 #include <entwine/util/io.hpp>
+#include <entwine/util/local-writer.hpp>
 #include <entwine/util/pool.hpp>
+#include <entwine/util/sax.hpp>
+#include <entwine/util/unique.hpp>
 
 namespace entwine
 {
@@ -19,13 +31,24 @@ namespace entwine
 namespace
 {
 
+// Stems which would collide with our own files in the sources directory.
+bool isReserved(const std::string& stem)
+{
+    const std::string details(".details");
+    return stem == "manifest" || (
+        stem.compare(0, 8, "manifest") == 0 &&
+        stem.size() >= details.size() &&
+        stem.compare(stem.size() - details.size(), std::string::npos, details)
+            == 0);
+}
+
 bool areStemsUnique(const SourceList& sources)
 {
     std::set<std::string> stems;
     for (const auto& source : sources)
     {
         const std::string stem = getStem(source.path);
-        if (stem == "manifest" || !stems.insert(stem).second) return false;
+        if (isReserved(stem) || !stems.insert(stem).second) return false;
     }
     return true;
 }
@@ -39,11 +62,94 @@ bool areStemsUnique(const Manifest& manifest)
 
         // manifest.json is reserved for our overview - if there happens to be a
         // file called manifest.whatever then use origin IDs for metadata paths.
-        if (stem == "manifest" || !stems.insert(stem).second) return false;
+        // The same goes for the details shards of binary manifests.
+        if (isReserved(stem) || !stems.insert(stem).second) return false;
     }
     return true;
 }
 
+// Streams manifest entries into BuildItems without building a DOM for the
+// whole document.  Only nested fields, like the schema, are assembled as json
+// fragments before conversion.
+class ManifestReader : public SaxHandler
+{
+public:
+    // Append each entry of an array of entries to the manifest.
+    explicit ManifestReader(Manifest& manifest) : m_manifest(&manifest) { }
+
+    // Overlay the fields of a single entry onto an existing item.
+    explicit ManifestReader(BuildItem& item) : m_item(&item) { }
+
+protected:
+    void onStart(bool object) override
+    {
+        if (m_manifest && !m_depth && !object)
+        {
+            ++m_depth;
+        }
+        else if (m_depth + 1 == entryDepth() && object)
+        {
+            ++m_depth;
+            if (m_manifest)
+            {
+                m_manifest->emplace_back();
+                m_item = &m_manifest->back();
+                m_hasPath = false;
+            }
+        }
+        else if (m_depth == entryDepth()) capture();
+        else throw std::runtime_error("Invalid manifest");
+    }
+
+    void onKey(std::string& key) override { m_key = std::move(key); }
+
+    void onValue(json v) override
+    {
+        if (m_depth != entryDepth())
+        {
+            throw std::runtime_error("Invalid manifest");
+        }
+
+        auto& info(m_item->source.info);
+        if (m_key == "path")
+        {
+            m_item->source.path = v.get<std::string>();
+            m_hasPath = true;
+        }
+        else if (m_key == "metadataPath")
+        {
+            m_item->metadataPath = v.get<std::string>();
+        }
+        else if (m_key == "inserted") m_item->inserted = v.get<bool>();
+        else if (m_key == "points") info.points = v.get<uint64_t>();
+        else if (m_key == "errors") info.errors = v.get<StringList>();
+        else if (m_key == "warnings") info.warnings = v.get<StringList>();
+        else if (m_key == "pipeline") info.pipeline = std::move(v);
+        else if (m_key == "srs") info.srs = v.get<Srs>();
+        else if (m_key == "bounds") info.bounds = v.get<Bounds>();
+        else if (m_key == "schema") info.schema = v.get<Schema>();
+        else if (m_key == "metadata") info.metadata = std::move(v);
+    }
+
+    void onEnd() override
+    {
+        if (m_manifest && m_depth == entryDepth() && !m_hasPath)
+        {
+            throw std::runtime_error("Manifest entry has no path");
+        }
+        --m_depth;
+    }
+
+private:
+    int entryDepth() const { return m_manifest ? 2 : 1; }
+
+    Manifest* m_manifest = nullptr;
+    BuildItem* m_item = nullptr;
+    int m_depth = 0;
+    bool m_hasPath = false;
+    std::string m_key;
+};
+
 } // unnamed namespace
 
 void to_json(json& j, const SourceInfo& info)
@@ -152,11 +258,11 @@ json toOverview(const Manifest& manifest)
         const auto& info = item.source.info;
         json entry = {
             { "path", item.source.path },
-            { "metadataPath", item.metadataPath },
             { "inserted", item.inserted },
             { "bounds", info.bounds },
             { "points", info.points }
         };
+        if (item.metadataPath.size()) entry["metadataPath"] = item.metadataPath;
         if (info.warnings.size()) entry["warnings"] = info.warnings;
         if (info.errors.size()) entry["errors"] = info.errors;
 
@@ -201,6 +307,10 @@ void saveEach(
 {
     const bool stemsAreUnique = areStemsUnique(sources);
 
+    // Remote endpoints have no local writer, and so no ring of their own.
+    const std::unique_ptr<LocalWriter> writer(
+        ep.isLocal() ? makeUnique<LocalWriter>() : nullptr);
+
     uint64_t i = 0;
     Pool pool(threads);
     for (const Source& source : sources)
@@ -209,15 +319,19 @@ void saveEach(
             ? getStem(source.path)
             : std::to_string(i);
 
-        pool.add([&ep, &source, stem, pretty]()
+        pool.add([&ep, &source, &writer, stem, pretty]()
         {
-            ensurePut(ep, stem + ".json", json(source).dump(getIndent(pretty)));
+            const std::string filename = stem + ".json";
+            const std::string data = json(source).dump(getIndent(pretty));
+            if (writer) writer->put(ep.fullPath(filename), data);
+            else ensurePut(ep, filename, data);
         });
 
         ++i;
     }
 
     pool.join();
+    if (writer) writer->wait();
 }
 
 void saveEach(
@@ -226,31 +340,41 @@ void saveEach(
     const unsigned threads,
     const bool pretty)
 {
+    const std::unique_ptr<LocalWriter> writer(
+        ep.isLocal() ? makeUnique<LocalWriter>() : nullptr);
+
     Pool pool(threads);
 
     for (const auto& item : manifest)
     {
-        pool.add([&ep, &item, pretty]()
+        pool.add([&ep, &item, &writer, pretty]()
         {
-            ensurePut(
-                ep,
-                item.metadataPath,
-                json(item.source).dump(getIndent(pretty)));
+            const std::string data = json(item.source).dump(getIndent(pretty));
+            if (writer) writer->put(ep.fullPath(item.metadataPath), data);
+            else ensurePut(ep, item.metadataPath, data);
         });
     }
 
     pool.join();
+    if (writer) writer->wait();
 }
 
 Manifest manifest::load(
     const arbiter::Endpoint& ep,
     const unsigned threads,
     const std::string postfix,
-    const bool verbose)
+    const bool verbose,
+    Hedge* hedge)
 {
-    Manifest manifest =
-        json::parse(ensureGet(ep, "manifest" + postfix + ".json"));
+    const auto get = [&ep, hedge](const std::string& path)
+    {
+        return hedge ? ensureGet(ep, path, *hedge) : ensureGet(ep, path);
+    };
+
+    Manifest manifest;
+    ManifestReader(manifest).parse(get("manifest" + postfix + ".json"));
 
+    // The full metadata of each entry is overlaid onto its overview.
     Pool pool(threads);
     for (auto& entry : manifest)
     {
@@ -261,12 +385,20 @@ Manifest manifest::load(
                 std::cout << "Loading " << entry.metadataPath << " from " <<
                     ep.prefixedRoot() << std::endl;
             }
-            const json metadata =
-                json::parse(ensureGet(ep, entry.metadataPath));
-            entry = BuildItem(entwine::merge(json(entry), metadata));
+            pool.add([&get, &entry]()
+            {
+                ManifestReader(entry).parse(get(entry.metadataPath));
+            });
         }
     }
     pool.join();
+
+    if (pool.errors().size())
+    {
+        throw std::runtime_error(
+            "Manifest load failed: " + pool.errors().front());
+    }
+
     return manifest;
 }
 
@@ -318,6 +450,353 @@ Manifest manifest::merge(Manifest dst, const Manifest& src)
     return dst;
 }
 
+namespace
+{
+
+// The header holds a magic number, a format version, and the source count.
+// It is followed by the flags, point counts, and bounds of every source, and
+// then by each string column as offsets into its concatenated contents.
+const std::string binaryMagic("EMNB");
+constexpr uint32_t binaryVersion = 1;
+constexpr uint64_t stringColumns = 4;
+
+constexpr uint8_t insertedFlag = 1;
+constexpr uint8_t statsFlag = 2;
+
+template <typename T>
+void append(std::vector<char>& data, const T& v)
+{
+    const char* pos(reinterpret_cast<const char*>(&v));
+    data.insert(data.end(), pos, pos + sizeof(T));
+}
+
+// Error and warning lists are stored as JSON, and only if they are not empty.
+std::string toColumn(const StringList& list)
+{
+    return list.empty() ? "" : json(list).dump();
+}
+
+StringList fromColumn(const std::string& s)
+{
+    return s.empty() ? StringList() : json::parse(s).get<StringList>();
+}
+
+// A bounds-checked view of a binary manifest.
+class BinaryView
+{
+public:
+    explicit BinaryView(const BinaryFile& file)
+        : m_file(file)
+        , m_data(file.data())
+        , m_size(file.size())
+        , m_count(file.count())
+    {
+        // Guard against overflow from a corrupt count.
+        if (m_count > m_size) invalid();
+
+        m_flags = BinaryFile::headerSize;
+        m_points = m_flags + m_count;
+        m_bounds = m_points + m_count * 8;
+
+        uint64_t pos(m_bounds + m_count * 48);
+        for (uint64_t i(0); i < stringColumns; ++i)
+        {
+            m_strings[i] = pos;
+            const uint64_t bytes(offset(i, m_count));
+            pos += (m_count + 1) * 8 + bytes;
+        }
+        if (pos != m_size) invalid();
+    }
+
+    uint64_t count() const { return m_count; }
+
+    uint8_t flags(uint64_t i) const
+    {
+        return static_cast<uint8_t>(m_data[m_flags + i]);
+    }
+
+    uint64_t points(uint64_t i) const
+    {
+        uint64_t v(0);
+        std::memcpy(&v, m_data + m_points + i * 8, 8);
+        return v;
+    }
+
+    Bounds bounds(uint64_t i) const
+    {
+        double v[6];
+        std::memcpy(v, m_data + m_bounds + i * 48, 48);
+        return Bounds(v[0], v[1], v[2], v[3], v[4], v[5]);
+    }
+
+    std::string string(uint64_t column, uint64_t i) const
+    {
+        const uint64_t begin(offset(column, i));
+        const uint64_t end(offset(column, i + 1));
+        if (begin > end || end > offset(column, m_count)) invalid();
+
+        const char* pos(m_data + m_strings[column] + (m_count + 1) * 8);
+        return std::string(pos + begin, pos + end);
+    }
+
+private:
+    uint64_t offset(uint64_t column, uint64_t i) const
+    {
+        const uint64_t at(m_strings[column] + i * 8);
+        if (at + 8 > m_size) invalid();
+
+        uint64_t v(0);
+        std::memcpy(&v, m_data + at, 8);
+        if (v > m_size) invalid();
+        return v;
+    }
+
+    void invalid() const { m_file.invalid(); }
+
+    const BinaryFile& m_file;
+    const char* m_data;
+    const uint64_t m_size;
+    const uint64_t m_count;
+
+    uint64_t m_flags = 0;
+    uint64_t m_points = 0;
+    uint64_t m_bounds = 0;
+    uint64_t m_strings[stringColumns] = { };
+};
+
+} // unnamed namespace
+
+void manifest::saveBinary(
+    Manifest& manifest,
+    const arbiter::Endpoint& ep,
+    const std::set<uint64_t>& origins,
+    const unsigned threads,
+    const std::string postfix)
+{
+    std::set<uint64_t> shards;
+    for (const uint64_t origin : origins)
+    {
+        shards.insert(origin / detailsShardSize);
+    }
+
+    std::vector<uint64_t> members;
+    for (const uint64_t shard : shards)
+    {
+        const uint64_t begin(shard * detailsShardSize);
+        const uint64_t end(
+            std::min<uint64_t>(begin + detailsShardSize, manifest.size()));
+        for (uint64_t o(begin); o < end; ++o)
+        {
+            if (!manifest[o].detailed) members.push_back(o);
+        }
+    }
+    loadDetails(manifest, ep, members, threads, postfix);
+
+    Pool pool(threads);
+    for (const uint64_t shard : shards)
+    {
+        pool.add([&manifest, &ep, shard, postfix]()
+        {
+            const uint64_t begin(shard * detailsShardSize);
+            const uint64_t end(
+                std::min<uint64_t>(begin + detailsShardSize, manifest.size()));
+
+            json list = json::array();
+            for (uint64_t o(begin); o < end; ++o)
+            {
+                list.push_back(manifest[o].source);
+            }
+            ensurePut(ep, getDetailsFilename(shard, postfix), list.dump());
+        });
+    }
+    pool.join();
+
+    if (pool.errors().size())
+    {
+        throw std::runtime_error(
+            "Manifest details save failed: " + pool.errors().front());
+    }
+
+    const uint64_t count(manifest.size());
+    std::vector<char> data(
+        BinaryFile::makeHeader(binaryMagic, binaryVersion, count));
+
+    for (const BuildItem& item : manifest)
+    {
+        uint8_t flags(0);
+        if (item.inserted) flags |= insertedFlag;
+        if (hasStats(item)) flags |= statsFlag;
+        append(data, flags);
+    }
+    for (const BuildItem& item : manifest)
+    {
+        append(data, item.source.info.points);
+    }
+    for (const BuildItem& item : manifest)
+    {
+        const Bounds& b(item.source.info.bounds);
+        for (int i(0); i < 6; ++i) append(data, b[i]);
+    }
+
+    const auto column = [&](std::function<std::string(const BuildItem&)> f)
+    {
+        std::string bytes;
+        uint64_t offset(0);
+        append(data, offset);
+        for (const BuildItem& item : manifest)
+        {
+            bytes += f(item);
+            offset = bytes.size();
+            append(data, offset);
+        }
+        data.insert(data.end(), bytes.begin(), bytes.end());
+    };
+    column([](const BuildItem& item) { return item.source.path; });
+    column([](const BuildItem& item) { return item.metadataPath; });
+    column([](const BuildItem& item)
+    {
+        return toColumn(item.source.info.errors);
+    });
+    column([](const BuildItem& item)
+    {
+        return toColumn(item.source.info.warnings);
+    });
+
+    ensurePut(ep, getBinaryFilename(postfix), data);
+}
+
+Manifest manifest::loadBinary(
+    const arbiter::Endpoint& ep,
+    const unsigned threads,
+    const std::string postfix,
+    Hedge* hedge)
+{
+    const BinaryFile file(
+        ep,
+        getBinaryFilename(postfix),
+        binaryMagic,
+        binaryVersion,
+        "binary manifest",
+        hedge);
+    const BinaryView view(file);
+    Manifest manifest(view.count());
+
+    const uint64_t block = 65536;
+    Pool pool(threads, 1, false);
+    for (uint64_t begin(0); begin < view.count(); begin += block)
+    {
+        pool.add([&manifest, &view, begin]()
+        {
+            const uint64_t end(std::min(begin + block, view.count()));
+            for (uint64_t i(begin); i < end; ++i)
+            {
+                BuildItem& item(manifest[i]);
+                SourceInfo& info(item.source.info);
+
+                item.inserted = view.flags(i) & insertedFlag;
+                item.stats = view.flags(i) & statsFlag;
+                item.detailed = false;
+                info.points = view.points(i);
+                info.bounds = view.bounds(i);
+                item.source.path = view.string(0, i);
+                item.metadataPath = view.string(1, i);
+                info.errors = fromColumn(view.string(2, i));
+                info.warnings = fromColumn(view.string(3, i));
+            }
+        });
+    }
+    pool.join();
+
+    if (pool.errors().size())
+    {
+        throw std::runtime_error(
+            "Invalid binary manifest: " + pool.errors().front());
+    }
+
+    return manifest;
+}
+
+void manifest::loadDetails(
+    Manifest& manifest,
+    const arbiter::Endpoint& ep,
+    const std::vector<uint64_t>& origins,
+    const unsigned threads,
+    const std::string postfix,
+    Hedge* hedge)
+{
+    std::set<uint64_t> shards;
+    for (const uint64_t origin : origins)
+    {
+        if (!manifest.at(origin).detailed)
+        {
+            shards.insert(origin / detailsShardSize);
+        }
+    }
+    if (shards.empty()) return;
+
+    Pool pool(threads, 1, false);
+    for (const uint64_t shard : shards)
+    {
+        pool.add([&manifest, &ep, shard, postfix, hedge]()
+        {
+            const std::string filename(getDetailsFilename(shard, postfix));
+            Manifest details;
+            ManifestReader(details).parse(
+                hedge ? ensureGet(ep, filename, *hedge)
+                    : ensureGet(ep, filename));
+
+            const uint64_t begin(shard * detailsShardSize);
+            if (begin + details.size() > manifest.size())
+            {
+                throw std::runtime_error("Invalid details: " + filename);
+            }
+
+            // Each shard holds a distinct range of origins, so no locking is
+            // needed.
+            for (uint64_t i(0); i < details.size(); ++i)
+            {
+                BuildItem& item(manifest[begin + i]);
+                if (item.detailed) continue;
+
+                SourceInfo& dst(item.source.info);
+                SourceInfo& src(details[i].source.info);
+                if (details[i].source.path != item.source.path)
+                {
+                    throw std::runtime_error("Mismatched details: " + filename);
+                }
+
+                dst.pipeline = std::move(src.pipeline);
+                dst.srs = std::move(src.srs);
+                dst.schema = std::move(src.schema);
+                dst.metadata = std::move(src.metadata);
+                item.detailed = true;
+            }
+        });
+    }
+    pool.join();
+
+    if (pool.errors().size())
+    {
+        throw std::runtime_error(
+            "Manifest details load failed: " + pool.errors().front());
+    }
+}
+
+void manifest::loadDetails(
+    Manifest& manifest,
+    const arbiter::Endpoint& ep,
+    const unsigned threads,
+    const std::string postfix,
+    Hedge* hedge)
+{
+    std::vector<uint64_t> origins;
+    for (uint64_t origin(0); origin < manifest.size(); ++origin)
+    {
+        if (!manifest[origin].detailed) origins.push_back(origin);
+    }
+    loadDetails(manifest, ep, origins, threads, postfix, hedge);
+}
+
 uint64_t getInsertedPoints(const Manifest& manifest)
 {
     return std::accumulate(
@@ -10,6 +10,11 @@
 
 #pragma once
 
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
 #include <entwine/third/arbiter/arbiter.hpp>
 #include <entwine/types/bounds.hpp>
 #include <entwine/types/defs.hpp>
@@ -20,6 +25,8 @@
 namespace entwine
 {
 
+class Hedge;
+
 struct SourceInfo
 {
     SourceInfo() = default;
@@ -77,6 +84,13 @@ struct BuildItem
     Source source;
     bool inserted = false;
     std::string metadataPath;
+
+    // Binary manifests are loaded without the detailed metadata of each
+    // source - its pipeline, SRS, schema, and PDAL metadata - which is fetched
+    // on demand by manifest::loadDetails.  Until then, whether its schema has
+    // stats is recorded here.
+    bool detailed = true;
+    bool stats = false;
 };
 using Manifest = std::vector<BuildItem>;
 void to_json(json& j, const BuildItem& item);
@@ -92,7 +106,7 @@ SourceInfo merge(SourceInfo a, const SourceInfo& b);
 
 inline bool hasStats(const BuildItem& item)
 {
-    return hasStats(item.source.info.schema);
+    return item.detailed ? hasStats(item.source.info.schema) : item.stats;
 }
 
 inline bool isInserted(const BuildItem& item)
@@ -137,10 +151,57 @@ Manifest load(
     const arbiter::Endpoint& ep,
     unsigned threads,
     std::string postfix = "",
-    bool verbose = true);
+    bool verbose = true,
+    Hedge* hedge = nullptr);
 
 Manifest merge(Manifest manifest, const Manifest& other);
 
+// A compact binary manifest, for internal use by continued builds and merges.
+// The path, metadata path, point count, bounds, errors, warnings, and flags of
+// the sources are stored in columns, while the full metadata of each source is
+// bundled into JSON shards of detailsShardSize sources apiece.
+constexpr uint64_t detailsShardSize = 4096;
+inline std::string getBinaryFilename(std::string postfix = "")
+{
+    return "manifest" + postfix + ".bin";
+}
+inline std::string getDetailsFilename(uint64_t shard, std::string postfix = "")
+{
+    return "manifest" + postfix + "-" + std::to_string(shard) + ".details.json";
+}
+
+// Only the shards holding the given origins are rewritten, and since each is
+// rewritten whole, the details of the other sources in them are loaded first.
+void saveBinary(
+    Manifest& manifest,
+    const arbiter::Endpoint& ep,
+    const std::set<uint64_t>& origins,
+    unsigned threads,
+    std::string postfix = "");
+
+// Loads the columns only - see loadDetails.
+Manifest loadBinary(
+    const arbiter::Endpoint& ep,
+    unsigned threads,
+    std::string postfix = "",
+    Hedge* hedge = nullptr);
+
+// Fetch the details of the given origins, or of every source, from the shards
+// holding them.  Sources which are already detailed are left as they are.
+void loadDetails(
+    Manifest& manifest,
+    const arbiter::Endpoint& ep,
+    const std::vector<uint64_t>& origins,
+    unsigned threads,
+    std::string postfix = "",
+    Hedge* hedge = nullptr);
+void loadDetails(
+    Manifest& manifest,
+    const arbiter::Endpoint& ep,
+    unsigned threads,
+    std::string postfix = "",
+    Hedge* hedge = nullptr);
+
 } // namespace manifest
 
 } // namespace entwine
@@ -94,6 +94,9 @@ public:
     virtual bool supportsView() const override { return true; }
     uint64_t size() const { return m_refs.size(); }
 
+    // Exposed so the serialization order of the points may be rearranged.
+    std::vector<char*>& refs() { return m_refs; }
+
 private:
     std::vector<char*> m_refs;
     uint64_t m_index = 0;
@@ -216,5 +219,38 @@ private:
     Process m_f = []() { };
 };
 
+// For reading from memory owned elsewhere, for example a memory mapped file.
+// The data is never written through this table.
+class BufferPointTable : public pdal::StreamPointTable
+{
+public:
+    BufferPointTable(
+        pdal::PointLayout& layout,
+        const char* data,
+        std::size_t size)
+        : pdal::StreamPointTable(layout, size / layout.pointSize())
+        , m_pointSize(layout.pointSize())
+        , m_data(const_cast<char*>(data))
+    {
+        if (!m_pointSize) throw std::runtime_error("Invalid schema of size 0");
+        if (size % m_pointSize != 0)
+        {
+            throw std::runtime_error("Invalid BufferPointTable data");
+        }
+    }
+
+    virtual char* getPoint(pdal::PointId index) override
+    {
+        return m_data + index * m_pointSize;
+    }
+
+private:
+    BufferPointTable(const BufferPointTable&);
+    BufferPointTable& operator=(const BufferPointTable&);
+
+    const std::size_t m_pointSize;
+    char* const m_data;
+};
+
 } // namespace entwine
 
@@ -0,0 +1,262 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/util/analysis-cache.hpp>
+
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+namespace entwine
+{
+
+namespace
+{
+
+// FNV-1a, which is stable across platforms and runs, unlike std::hash.
+uint64_t hash(const std::string& s)
+{
+    uint64_t h(14695981039346656037ull);
+    for (const unsigned char c : s)
+    {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+std::string toHex(const uint64_t v)
+{
+    std::ostringstream ss;
+    ss << std::hex << v;
+    return ss.str();
+}
+
+uint64_t getKey(
+    const std::string& path,
+    const uint64_t size,
+    const int64_t modified,
+    const std::string& pipelineHash)
+{
+    return hash(
+        path + '\n' +
+        std::to_string(size) + '\n' +
+        std::to_string(modified) + '\n' +
+        pipelineHash);
+}
+
+// Stale records are only rewritten once they outnumber the live ones.
+constexpr uint64_t minCompactionLines = 1024;
+
+} // unnamed namespace
+
+AnalysisCache::AnalysisCache(
+    const std::string dir,
+    const json& pipeline,
+    const bool deep)
+    : m_filename(getFilename(dir))
+    , m_pipelineHash(
+        toHex(hash(pipeline.dump() + (deep ? "deep" : "shallow"))))
+{
+    if (!arbiter::mkdirp(arbiter::getDirname(m_filename)))
+    {
+        throw std::runtime_error("Could not create " + dir);
+    }
+
+    index();
+    if (m_lines > minCompactionLines && m_lines > 2 * m_offsets.size())
+    {
+        compact();
+    }
+
+    m_writer.open(m_filename, std::ios::binary | std::ios::app);
+    if (!m_writer) throw std::runtime_error("Could not open " + m_filename);
+
+    m_reader.open(m_filename, std::ios::binary);
+    if (!m_reader) throw std::runtime_error("Could not open " + m_filename);
+}
+
+std::string AnalysisCache::getFilename(const std::string& dir)
+{
+    return arbiter::join(arbiter::expandTilde(dir), "analysis-cache.jsonl");
+}
+
+optional<AnalysisCache::Version> AnalysisCache::getVersion(
+    const std::string& path,
+    const arbiter::Arbiter& a,
+    const bool allowRemote)
+{
+    Version v;
+    v.path = path;
+
+    if (a.isLocal(path))
+    {
+        const std::string local(
+            arbiter::expandTilde(arbiter::stripProtocol(path)));
+
+        struct stat st;
+        if (::stat(local.c_str(), &st) == -1) return { };
+
+        // Whole seconds would miss a rewrite of the same size within the same
+        // second, so include the nanoseconds where the platform has them.
+#if defined(__APPLE__)
+        const timespec& mtime(st.st_mtimespec);
+#else
+        const timespec& mtime(st.st_mtim);
+#endif
+        v.size = st.st_size;
+        v.modified = int64_t(mtime.tv_sec) * 1000000000 + mtime.tv_nsec;
+        return v;
+    }
+
+    if (!allowRemote) return { };
+
+    const auto size(a.tryGetSize(path));
+    if (!size) return { };
+
+    v.size = *size;
+    return v;
+}
+
+optional<SourceInfo> AnalysisCache::get(const Version& v) const
+{
+    json record;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto it(m_offsets.find(
+            getKey(v.path, v.size, v.modified, m_pipelineHash)));
+        if (it == m_offsets.end()) return { };
+        record = read(it->second);
+    }
+
+    // A hash collision simply looks like a miss.
+    if (!matches(record, v)) return { };
+    return record.at("info").get<SourceInfo>();
+}
+
+void AnalysisCache::put(const Version& v, const SourceInfo& info)
+{
+    // Failures may be transient, so those files are analyzed again next time.
+    if (!info.errors.empty()) return;
+
+    const json j {
+        { "path", v.path },
+        { "size", v.size },
+        { "modified", v.modified },
+        { "pipeline", m_pipelineHash },
+        { "info", info }
+    };
+    const std::string line(j.dump() + '\n');
+    const uint64_t key(getKey(v.path, v.size, v.modified, m_pipelineHash));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_writer << line << std::flush;
+    if (!m_writer) throw std::runtime_error("Could not write " + m_filename);
+
+    m_offsets[key] = m_end;
+    m_end += line.size();
+    ++m_lines;
+}
+
+uint64_t AnalysisCache::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_offsets.size();
+}
+
+json AnalysisCache::read(const uint64_t offset) const
+{
+    m_reader.clear();
+    m_reader.seekg(offset);
+
+    std::string line;
+    if (!std::getline(m_reader, line) || m_reader.eof()) return json();
+
+    try { return json::parse(line); }
+    catch (...) { return json(); }
+}
+
+bool AnalysisCache::matches(const json& record, const Version& v) const
+{
+    return
+        record.is_object() &&
+        record.value("path", "") == v.path &&
+        record.value("size", uint64_t(0)) == v.size &&
+        record.value("modified", int64_t(0)) == v.modified &&
+        record.value("pipeline", "") == m_pipelineHash &&
+        record.count("info");
+}
+
+void AnalysisCache::index()
+{
+    m_offsets.clear();
+    m_lines = 0;
+    m_end = 0;
+
+    std::ifstream stream(m_filename, std::ios::binary);
+    std::string line;
+    while (std::getline(stream, line))
+    {
+        const uint64_t offset(m_end);
+        const bool terminated(!stream.eof());
+        m_end += line.size() + (terminated ? 1 : 0);
+        ++m_lines;
+
+        // A record which was interrupted mid-write is skipped, and terminated
+        // so that our appends begin on a line of their own.
+        if (!terminated)
+        {
+            std::ofstream(m_filename, std::ios::binary | std::ios::app) << '\n';
+            ++m_end;
+            break;
+        }
+
+        try
+        {
+            const json j(json::parse(line));
+            m_offsets[getKey(
+                    j.at("path").get<std::string>(),
+                    j.at("size").get<uint64_t>(),
+                    j.at("modified").get<int64_t>(),
+                    j.at("pipeline").get<std::string>())] = offset;
+        }
+        catch (...) { }
+    }
+}
+
+void AnalysisCache::compact()
+{
+    const std::string tmp(m_filename + ".tmp");
+    {
+        std::ifstream in(m_filename, std::ios::binary);
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+
+        std::string line;
+        for (const auto& p : m_offsets)
+        {
+            in.clear();
+            in.seekg(p.second);
+            if (std::getline(in, line)) out << line << '\n';
+        }
+        if (!out) throw std::runtime_error("Could not write " + tmp);
+    }
+
+    if (std::rename(tmp.c_str(), m_filename.c_str()))
+    {
+        throw std::runtime_error("Could not replace " + m_filename);
+    }
+
+    index();
+}
+
+} // namespace entwine
@@ -0,0 +1,88 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/types/source.hpp>
+#include <entwine/util/json.hpp>
+#include <entwine/util/optional.hpp>
+
+namespace entwine
+{
+
+// A persistent cache of file analyses, so that unchanged inputs need not be
+// analyzed again by later invocations.  Entries are keyed by the path of a
+// file, its version, and a hash of the pipeline and analysis mode which
+// produced them.  Only analyses without errors are cached, since errors may
+// be transient.
+//
+// The cache is a single file of newline-delimited records in the given
+// directory, and new entries are appended as they are analyzed, so an
+// interrupted analysis keeps its progress.  In memory, only a hash of each
+// key and the offset of its record are held - records are read back and
+// verified against the full key when looked up.  Later records take
+// precedence, and the file is compacted when opened if stale records
+// dominate.  It should not be shared by concurrent processes.
+class AnalysisCache
+{
+public:
+    AnalysisCache(std::string dir, const json& pipeline, bool deep);
+
+    // Local files are versioned by their size and modification time, in
+    // nanoseconds since the epoch.
+    struct Version
+    {
+        std::string path;
+        uint64_t size = 0;
+        int64_t modified = 0;
+    };
+
+    // Empty if the file cannot be versioned.  Remote files have no
+    // modification time or ETag available to us, so a remote file rewritten
+    // in place with the same size would look unchanged.  They are therefore
+    // only versioned, by their size alone, if allowRemote is set.
+    static optional<Version> getVersion(
+        const std::string& path,
+        const arbiter::Arbiter& a,
+        bool allowRemote = false);
+
+    static std::string getFilename(const std::string& dir);
+
+    optional<SourceInfo> get(const Version& version) const;
+    void put(const Version& version, const SourceInfo& info);
+    uint64_t size() const;
+
+private:
+    // Read the record at this offset, or return null if it is incomplete.
+    json read(uint64_t offset) const;
+    bool matches(const json& record, const Version& version) const;
+    void index();
+    void compact();
+
+    const std::string m_filename;
+    const std::string m_pipelineHash;
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<uint64_t, uint64_t> m_offsets;
+    uint64_t m_lines = 0;
+    uint64_t m_end = 0;
+
+    mutable std::ifstream m_reader;
+    std::ofstream m_writer;
+};
+
+} // namespace entwine
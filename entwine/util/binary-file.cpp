@@ -0,0 +1,86 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/util/binary-file.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <entwine/util/io.hpp>
+#include <entwine/util/mmap.hpp>
+#include <entwine/util/unique.hpp>
+
+namespace entwine
+{
+
+constexpr uint64_t BinaryFile::headerSize;
+
+BinaryFile::BinaryFile(
+    const arbiter::Endpoint& ep,
+    const std::string filename,
+    const std::string magic,
+    const uint32_t version,
+    const std::string description,
+    Hedge* hedge)
+    : m_filename(filename)
+    , m_description(description)
+{
+    if (ep.isLocal())
+    {
+        m_mapped = makeUnique<MappedFile>(ep.fullPath(filename));
+        m_data = m_mapped->data();
+        m_size = m_mapped->size();
+    }
+    else
+    {
+        m_buffer = hedge
+            ? ensureGetBinary(ep, filename, *hedge)
+            : ensureGetBinary(ep, filename);
+        m_data = m_buffer.data();
+        m_size = m_buffer.size();
+    }
+
+    if (m_size < headerSize || std::string(m_data, 4) != magic) invalid();
+
+    std::memcpy(&m_version, m_data + 4, sizeof(m_version));
+    std::memcpy(&m_count, m_data + 8, sizeof(m_count));
+    if (!m_version || m_version > version) invalid();
+}
+
+BinaryFile::~BinaryFile() { }
+
+std::vector<char> BinaryFile::makeHeader(
+    const std::string& magic,
+    const uint32_t version,
+    const uint64_t count)
+{
+    std::vector<char> header(headerSize);
+    std::copy(magic.begin(), magic.begin() + 4, header.begin());
+    std::memcpy(header.data() + 4, &version, sizeof(version));
+    std::memcpy(header.data() + 8, &count, sizeof(count));
+    return header;
+}
+
+void BinaryFile::checkRecords(
+    const uint64_t recordSize,
+    const uint64_t skip) const
+{
+    // Guard against overflow from a corrupt count.
+    if (m_count > m_size / recordSize) invalid();
+    if (m_size != headerSize + skip + m_count * recordSize) invalid();
+}
+
+void BinaryFile::invalid() const
+{
+    throw std::runtime_error("Invalid " + m_description + ": " + m_filename);
+}
+
+} // namespace entwine
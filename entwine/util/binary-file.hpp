@@ -0,0 +1,80 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+
+namespace entwine
+{
+
+class Hedge;
+class MappedFile;
+
+// One of our binary metadata files - the binary hierarchy, manifest, or time
+// index.  Each begins with a 16-byte header holding a 4-character magic
+// number, a format version, and a record count.
+//
+// Local files are mapped so that their records may be decoded in place, and
+// remote files are fetched in full.  The header is validated on construction,
+// accepting any format version up to the given one, and any failed validation
+// throws with a message naming the file.
+class BinaryFile
+{
+public:
+    static constexpr uint64_t headerSize = 16;
+
+    BinaryFile(
+        const arbiter::Endpoint& ep,
+        std::string filename,
+        std::string magic,
+        uint32_t version,
+        std::string description,
+        Hedge* hedge = nullptr);
+    ~BinaryFile();
+
+    static std::vector<char> makeHeader(
+        const std::string& magic,
+        uint32_t version,
+        uint64_t count);
+
+    // The full contents, including the header.
+    const char* data() const { return m_data; }
+    uint64_t size() const { return m_size; }
+    uint32_t version() const { return m_version; }
+    uint64_t count() const { return m_count; }
+
+    // For files of fixed-size records, throws unless the size matches the
+    // record count.  The records begin this many bytes after the header.
+    void checkRecords(uint64_t recordSize, uint64_t skip = 0) const;
+
+    void invalid() const;
+
+private:
+    BinaryFile(const BinaryFile&);
+    BinaryFile& operator=(const BinaryFile&);
+
+    const std::string m_filename;
+    const std::string m_description;
+
+    std::unique_ptr<MappedFile> m_mapped;
+    std::vector<char> m_buffer;
+    const char* m_data = nullptr;
+    uint64_t m_size = 0;
+    uint32_t m_version = 0;
+    uint64_t m_count = 0;
+};
+
+} // namespace entwine
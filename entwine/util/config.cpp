@@ -10,6 +10,7 @@
 
 #include <entwine/util/config.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <memory>
@@ -18,7 +19,9 @@
 #include <entwine/third/arbiter/arbiter.hpp>
 #include <entwine/types/exceptions.hpp>
 #include <entwine/util/io.hpp>
+#include <entwine/util/memory-driver.hpp>
 #include <entwine/util/pipeline.hpp>
+#include <entwine/util/shaped-driver.hpp>
 
 namespace entwine
 {
@@ -30,7 +33,7 @@ namespace
 
 BuildParameters getBuildParameters(const json& j)
 {
-    return BuildParameters(
+    BuildParameters p(
         getMinNodeSize(j),
         getMaxNodeSize(j),
         getCacheSize(j),
@@ -38,7 +41,21 @@ BuildParameters getBuildParameters(const json& j)
         getProgressInterval(j),
         getHierarchyStep(j),
         getVerbose(j),
-        j.value("laz_14", false));
+        j.value("laz_14", false),
+        getOrder(j));
+    p.uploadThreads = getUploadThreads(j);
+    p.uploadBufferSize = getUploadBufferSize(j);
+    p.ioConcurrency = getIoConcurrency(j);
+    p.ioRate = getIoRate(j);
+    p.hedge = getHedge(j);
+    p.prefetch = getPrefetch(j);
+    p.prefetchBufferSize = getPrefetchBufferSize(j);
+    p.bundleStep = getBundleStep(j);
+    p.binaryHierarchy = getBinaryHierarchy(j);
+    p.binaryManifest = getBinaryManifest(j);
+    p.nodeStats = getNodeStats(j);
+    p.timeIndex = getTimeIndex(j);
+    return p;
 }
 
 } // unnamed namespace
@@ -72,8 +89,18 @@ Metadata getMetadata(const json& j)
 
 std::unique_ptr<arbiter::Arbiter> getArbiter(const json& j)
 {
-    return std::unique_ptr<arbiter::Arbiter>(
-        new arbiter::Arbiter(j.value("arbiter", json()).dump()));
+    const json config = j.value("arbiter", json());
+    std::unique_ptr<arbiter::Arbiter> a(new arbiter::Arbiter(config.dump()));
+
+    const json shape = config.is_object()
+        ? config.value("shaped", json::object())
+        : json::object();
+
+    a->addDriver("mem", MemoryDriver::shared());
+    a->addDriver(
+        "shaped",
+        std::make_shared<ShapedDriver>(shape.get<ShapedDriver::Shape>()));
+    return a;
 }
 StringList getInput(const json& j)
 {
@@ -88,6 +115,15 @@ std::string getTmp(const json& j)
 {
     return j.value("tmp", arbiter::getTempPath());
 }
+std::string getAnalysisCache(const json& j)
+{
+    return j.value("analysisCache", "");
+}
+bool getAnalysisCacheRemote(const json& j)
+{
+    return j.value("analysisCacheRemote", false);
+}
+std::string getCopc(const json& j) { return j.value("copc", ""); }
 
 io::Type getDataType(const json& j)
 {
@@ -277,6 +313,64 @@ uint64_t getHierarchyStep(const json& j)
 {
     return j.value("hierarchyStep", 0);
 }
+uint64_t getBundleStep(const json& j)
+{
+    return j.value("bundleStep", 0);
+}
+uint64_t getHierarchyCacheSize(const json& j)
+{
+    return j.value("hierarchyCacheSize", 0);
+}
+bool getBinaryHierarchy(const json& j)
+{
+    return j.value("binaryHierarchy", false);
+}
+bool getBinaryManifest(const json& j)
+{
+    return j.value("binaryManifest", false);
+}
+bool getNodeStats(const json& j)
+{
+    return j.value("nodeStats", false);
+}
+bool getTimeIndex(const json& j)
+{
+    return j.value("timeIndex", false);
+}
+uint64_t getUploadThreads(const json& j)
+{
+    return std::max<uint64_t>(
+        j.value("uploadThreads", heuristics::uploadThreads),
+        1);
+}
+uint64_t getUploadBufferSize(const json& j)
+{
+    return j.value("uploadBufferSize", heuristics::uploadBufferSize);
+}
+uint64_t getIoConcurrency(const json& j)
+{
+    return j.value("ioConcurrency", 0);
+}
+double getIoRate(const json& j)
+{
+    return j.value("ioRate", 0.0);
+}
+double getHedge(const json& j)
+{
+    return j.value("hedge", 0.0);
+}
+uint64_t getPrefetch(const json& j)
+{
+    return j.value("prefetch", heuristics::prefetch);
+}
+uint64_t getPrefetchBufferSize(const json& j)
+{
+    return j.value("prefetchBufferSize", heuristics::prefetchBufferSize);
+}
+optional<io::Order> getOrder(const json& j)
+{
+    return j.value("order", optional<io::Order>());
+}
 
 } // namespace config
 } // namespace entwine
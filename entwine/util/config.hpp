@@ -45,6 +45,9 @@ std::unique_ptr<arbiter::Arbiter> getArbiter(const json& j);
 StringList getInput(const json& j);
 std::string getOutput(const json& j);
 std::string getTmp(const json& j);
+std::string getAnalysisCache(const json& j);
+bool getAnalysisCacheRemote(const json& j);
+std::string getCopc(const json& j);
 
 io::Type getDataType(const json& j);
 
@@ -77,6 +80,20 @@ uint64_t getSleepCount(const json& j);
 uint64_t getProgressInterval(const json& j);
 uint64_t getLimit(const json& j);
 uint64_t getHierarchyStep(const json& j);
+uint64_t getBundleStep(const json& j);
+uint64_t getHierarchyCacheSize(const json& j);
+bool getBinaryHierarchy(const json& j);
+bool getBinaryManifest(const json& j);
+bool getNodeStats(const json& j);
+bool getTimeIndex(const json& j);
+uint64_t getUploadThreads(const json& j);
+uint64_t getUploadBufferSize(const json& j);
+uint64_t getIoConcurrency(const json& j);
+double getIoRate(const json& j);
+double getHedge(const json& j);
+uint64_t getPrefetch(const json& j);
+uint64_t getPrefetchBufferSize(const json& j);
+optional<io::Order> getOrder(const json& j);
 
 } // namespace config
 } // namespace entwine
@@ -0,0 +1,239 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/util/hedge.hpp>
+
+#include <algorithm>
+#include <exception>
+
+#include <entwine/types/exceptions.hpp>
+#include <entwine/util/unique.hpp>
+
+namespace entwine
+{
+
+struct Hedge::Race
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    uint64_t launched = 0;
+    uint64_t failed = 0;
+    bool won = false;
+
+    std::vector<char> result;
+    std::exception_ptr error;
+
+    // Requires mutex.
+    bool settled() const { return won || failed == launched; }
+};
+
+Hedge::Hedge(
+    const double budget,
+    const double percentile,
+    const uint64_t window,
+    const uint64_t minSamples)
+    // Retries, if any, are left to our callers.
+    : Hedge(
+        makeUnique<Scheduler>(ownThreads, 1),
+        nullptr,
+        budget,
+        percentile,
+        window,
+        minSamples)
+{ }
+
+Hedge::Hedge(
+    Scheduler& scheduler,
+    const double budget,
+    const double percentile,
+    const uint64_t window,
+    const uint64_t minSamples)
+    : Hedge(nullptr, &scheduler, budget, percentile, window, minSamples)
+{ }
+
+Hedge::Hedge(
+    std::unique_ptr<Scheduler> own,
+    Scheduler* scheduler,
+    const double budget,
+    const double percentile,
+    const uint64_t window,
+    const uint64_t minSamples)
+    : m_budget(budget)
+    , m_percentile(std::min(std::max(percentile, 0.0), 1.0))
+    , m_window(std::max<uint64_t>(window, 1))
+    , m_minSamples(std::min(std::max<uint64_t>(minSamples, 1), m_window))
+    , m_own(std::move(own))
+    , m_scheduler(scheduler ? *scheduler : *m_own)
+{ }
+
+Hedge::~Hedge()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this]() { return !m_running; });
+}
+
+std::vector<char> Hedge::get(const Read read, const std::string endpoint)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_requests;
+    }
+
+    if (m_budget <= 0) return read();
+
+    const auto threshold(delay());
+    auto race(std::make_shared<Race>());
+
+    launch(race, read, endpoint);
+
+    std::unique_lock<std::mutex> lock(race->mutex);
+
+    if (threshold)
+    {
+        const bool settled(race->cv.wait_for(
+            lock,
+            *threshold,
+            [&race]() { return race->settled(); }));
+
+        if (!settled)
+        {
+            bool allowed(false);
+            {
+                std::lock_guard<std::mutex> hedgeLock(m_mutex);
+                if (m_hedged + 1 <= m_budget * m_requests)
+                {
+                    ++m_hedged;
+                    allowed = true;
+                }
+            }
+
+            if (allowed)
+            {
+                lock.unlock();
+                launch(race, read, endpoint);
+                lock.lock();
+            }
+        }
+    }
+
+    race->cv.wait(lock, [&race]() { return race->settled(); });
+
+    if (race->won) return std::move(race->result);
+    std::rethrow_exception(race->error);
+}
+
+std::vector<char> Hedge::getBinary(
+    const arbiter::Endpoint& ep,
+    const std::string path)
+{
+    return get([&ep, path]() { return ep.getBinary(path); }, ep.prefixedRoot());
+}
+
+std::string Hedge::get(const arbiter::Endpoint& ep, const std::string path)
+{
+    const auto data(getBinary(ep, path));
+    return std::string(data.begin(), data.end());
+}
+
+uint64_t Hedge::requests() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_requests;
+}
+
+uint64_t Hedge::hedged() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hedged;
+}
+
+void Hedge::launch(
+    const SharedRace race,
+    const Read read,
+    const std::string& endpoint)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_running;
+    }
+    {
+        std::lock_guard<std::mutex> lock(race->mutex);
+        ++race->launched;
+    }
+
+    const auto attempt = [this, race, read]()
+    {
+        using Clock = std::chrono::steady_clock;
+        const auto start(Clock::now());
+
+        std::vector<char> data(read());
+        record(std::chrono::duration<double>(Clock::now() - start).count());
+
+        std::lock_guard<std::mutex> lock(race->mutex);
+        if (!race->won)
+        {
+            race->won = true;
+            race->result = std::move(data);
+        }
+    };
+
+    // Called once the attempt, including any retries by the scheduler, has
+    // either succeeded or failed for good.
+    const auto done = [this, race](const std::string& error)
+    {
+        if (error.size())
+        {
+            std::lock_guard<std::mutex> lock(race->mutex);
+            ++race->failed;
+            if (!race->error)
+            {
+                race->error = std::make_exception_ptr(FatalError(error));
+            }
+        }
+
+        race->cv.notify_all();
+
+        // Our destructor may proceed as soon as this count reaches zero, so
+        // this must be the last access of any of our members.
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_running;
+        m_cv.notify_all();
+    };
+
+    m_scheduler.add(endpoint, Scheduler::Priority::High, attempt, done);
+}
+
+optional<std::chrono::duration<double>> Hedge::delay() const
+{
+    std::vector<double> samples;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_samples.size() < m_minSamples) return { };
+        samples = m_samples;
+    }
+
+    const std::size_t n(
+        std::min<std::size_t>(
+            samples.size() * m_percentile,
+            samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + n, samples.end());
+    return std::chrono::duration<double>(samples[n]);
+}
+
+void Hedge::record(const double seconds)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_samples.size() < m_window) m_samples.push_back(seconds);
+    else m_samples[m_next] = seconds;
+    m_next = (m_next + 1) % m_window;
+}
+
+} // namespace entwine
@@ -0,0 +1,116 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/util/optional.hpp>
+#include <entwine/util/scheduler.hpp>
+
+namespace entwine
+{
+
+// Hedged reads, to cut down on tail latency.  If a read has not completed
+// within the given percentile of recent read latencies, a duplicate request is
+// issued and whichever response arrives first is used.
+//
+// At most a budget fraction of reads may be hedged, which caps the extra load
+// on the endpoint.  A budget of zero disables hedging entirely, and reads are
+// then performed by the calling thread.
+//
+// Otherwise both attempts are run as operations of a scheduler, under the
+// name of the endpoint being read, so that duplicates count against its
+// limits.  Without a scheduler of its own choosing, a hedge runs them on a
+// scheduler it owns, whose workers are reused from read to read.
+//
+// All member functions are thread-safe, but must not be called from within an
+// operation of the scheduler.  Hedged requests cannot be cancelled, so the
+// losing request runs to completion in the background - destruction waits for
+// any such requests, so anything captured by a read must outlive this object.
+class Hedge
+{
+public:
+    using Read = std::function<std::vector<char>()>;
+
+    explicit Hedge(
+        double budget,
+        double percentile = 0.95,
+        uint64_t window = 256,
+        uint64_t minSamples = 32);
+    Hedge(
+        Scheduler& scheduler,
+        double budget,
+        double percentile = 0.95,
+        uint64_t window = 256,
+        uint64_t minSamples = 32);
+    ~Hedge();
+
+    // Perform a read, throwing if every attempt fails.
+    std::vector<char> get(Read read, std::string endpoint = "");
+    std::vector<char> getBinary(const arbiter::Endpoint& ep, std::string path);
+    std::string get(const arbiter::Endpoint& ep, std::string path);
+
+    uint64_t requests() const;
+    uint64_t hedged() const;
+
+private:
+    Hedge(const Hedge&);
+    Hedge& operator=(const Hedge&);
+
+    struct Race;
+    using SharedRace = std::shared_ptr<Race>;
+
+    // The most workers of an owned scheduler.  They are only started as
+    // concurrent reads require them.
+    static constexpr uint64_t ownThreads = 64;
+
+    Hedge(
+        std::unique_ptr<Scheduler> own,
+        Scheduler* scheduler,
+        double budget,
+        double percentile,
+        uint64_t window,
+        uint64_t minSamples);
+
+    void launch(SharedRace race, Read read, const std::string& endpoint);
+    optional<std::chrono::duration<double>> delay() const;
+    void record(double seconds);
+
+    const double m_budget;
+    const double m_percentile;
+    const uint64_t m_window;
+    const uint64_t m_minSamples;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+
+    std::vector<double> m_samples;
+    uint64_t m_next = 0;
+
+    uint64_t m_requests = 0;
+    uint64_t m_hedged = 0;
+    uint64_t m_running = 0;
+
+    // Declared last, so an owned scheduler is joined before anything its
+    // operations may use is destroyed.
+    std::unique_ptr<Scheduler> m_own;
+    Scheduler& m_scheduler;
+};
+
+} // namespace entwine
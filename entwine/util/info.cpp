@@ -11,6 +11,7 @@
 #include "info.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <iostream>
 #include <numeric>
@@ -22,6 +23,7 @@
 
 #include <entwine/third/arbiter/arbiter.hpp>
 #include <entwine/types/scale-offset.hpp>
+#include <entwine/util/analysis-cache.hpp>
 #include <entwine/util/fs.hpp>
 #include <entwine/util/io.hpp>
 #include <entwine/util/pdal-mutex.hpp>
@@ -343,12 +345,21 @@ SourceList analyze(
     const std::string tmp,
     const arbiter::Arbiter& a,
     const unsigned int threads,
-    const bool verbose)
+    const bool verbose,
+    const std::string cacheDir,
+    const bool cacheRemote)
 {
     const StringList filenames = resolve(inputs);
     SourceList sources(filenames.begin(), filenames.end());
 
+    std::unique_ptr<AnalysisCache> cache;
+    if (cacheDir.size())
+    {
+        cache = makeUnique<AnalysisCache>(cacheDir, pipelineTemplate, deep);
+    }
+
     uint64_t i(0);
+    std::atomic<uint64_t> reused(0);
 
     Pool pool(threads);
     for (Source& source : sources)
@@ -372,16 +383,42 @@ SourceList analyze(
         {
             pool.add([&]()
             {
+                optional<AnalysisCache::Version> version;
+                if (cache)
+                {
+                    version = AnalysisCache::getVersion(
+                        source.path,
+                        a,
+                        cacheRemote);
+                    if (version)
+                    {
+                        if (const auto info = cache->get(*version))
+                        {
+                            source.info = *info;
+                            ++reused;
+                            return;
+                        }
+                    }
+                }
+
                 const auto handle(localize(source.path, deep, tmp, a));
                 source.info = analyzeOne(
                     handle.localPath(),
                     deep,
                     pipelineTemplate);
+
+                if (version) cache->put(*version, source.info);
             });
         }
     }
     pool.join();
 
+    if (cache && verbose)
+    {
+        std::cout << "Reused " << reused.load() << " cached analyses" <<
+            std::endl;
+    }
+
     return sources;
 }
 
@@ -35,6 +35,8 @@ SourceList analyze(
     std::string tmp = arbiter::getTempPath(),
     const arbiter::Arbiter& a = { },
     unsigned threads = 8,
-    bool verbose = true);
+    bool verbose = true,
+    std::string cacheDir = "",
+    bool cacheRemote = false);
 
 } // namespace entwine
@@ -17,6 +17,8 @@
 #include <mutex>
 #include <thread>
 
+#include <entwine/util/hedge.hpp>
+
 namespace entwine
 {
 
@@ -58,7 +60,9 @@ bool loop(F f, const int tries, std::string message = "")
     return false;
 }
 
-arbiter::http::Headers getRangeHeader(int start, int end = 0)
+} // unnamed namespace
+
+arbiter::http::Headers getRangeHeader(const uint64_t start, const uint64_t end)
 {
     arbiter::http::Headers h;
     h["Range"] = "bytes=" + std::to_string(start) + "-" +
@@ -66,8 +70,6 @@ arbiter::http::Headers getRangeHeader(int start, int end = 0)
     return h;
 }
 
-} // unnamed namespace
-
 bool putWithRetry(
     const arbiter::Endpoint& ep,
     const std::string& path,
@@ -108,6 +110,19 @@ void ensurePut(
     ensurePut(ep, path, std::vector<char>(s.begin(), s.end()), tries);
 }
 
+void ensureCopyFile(
+    const arbiter::Arbiter& a,
+    const std::string& file,
+    const std::string& dst,
+    const int tries)
+{
+    const auto f = [&a, &file, &dst]() { a.copyFile(file, dst); };
+    if (!loop(f, tries, "Failed to copy " + file + " to " + dst))
+    {
+        throw FatalError("Failed to copy to " + dst);
+    }
+}
+
 optional<std::vector<char>> getBinaryWithRetry(
     const arbiter::Endpoint& ep,
     const std::string& path,
@@ -177,6 +192,35 @@ std::string ensureGet(
     else throw FatalError("Failed to get " + path);
 }
 
+std::vector<char> ensureGetBinary(
+    const arbiter::Endpoint& ep,
+    const std::string& path,
+    Hedge& hedge,
+    const int tries)
+{
+    std::vector<char> data;
+    const auto f = [&ep, &path, &hedge, &data]()
+    {
+        data = hedge.getBinary(ep, path);
+    };
+    const std::string message =
+        "Failed to get " +
+        arbiter::join(ep.prefixedRoot(), path);
+
+    if (loop(f, tries, message)) return data;
+    else throw FatalError("Failed to get " + path);
+}
+
+std::string ensureGet(
+    const arbiter::Endpoint& ep,
+    const std::string& path,
+    Hedge& hedge,
+    const int tries)
+{
+    const auto v(ensureGetBinary(ep, path, hedge, tries));
+    return std::string(v.begin(), v.end());
+}
+
 arbiter::LocalHandle ensureGetLocalHandle(
     const arbiter::Arbiter& a,
     const std::string& path,
@@ -186,6 +230,8 @@ arbiter::LocalHandle ensureGetLocalHandle(
     {
         try { return a.getLocalHandle(path); }
         catch(...) { }
+
+        if (tried + 1 < tries) sleep(tried + 1, "Failed to get " + path);
     }
 
     throw std::runtime_error("Failed to get " + path);
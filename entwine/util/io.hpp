@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -21,6 +22,8 @@
 namespace entwine
 {
 
+class Hedge;
+
 static constexpr int defaultTries = 8;
 
 bool putWithRetry(
@@ -45,6 +48,14 @@ void ensurePut(
     const std::string& s,
     int tries = defaultTries);
 
+// Copy a single file, where either side may be remote, without reading it into
+// memory first when both are local.
+void ensureCopyFile(
+    const arbiter::Arbiter& a,
+    const std::string& file,
+    const std::string& dst,
+    int tries = defaultTries);
+
 optional<std::vector<char>> getBinaryWithRetry(
     const arbiter::Endpoint& ep,
     const std::string& path,
@@ -71,11 +82,27 @@ std::string ensureGet(
     const std::string& path,
     int tries = defaultTries);
 
+// As above, but slow requests may be hedged by a duplicate - see Hedge.
+std::vector<char> ensureGetBinary(
+    const arbiter::Endpoint& ep,
+    const std::string& path,
+    Hedge& hedge,
+    int tries = defaultTries);
+std::string ensureGet(
+    const arbiter::Endpoint& ep,
+    const std::string& path,
+    Hedge& hedge,
+    int tries = defaultTries);
+
 arbiter::LocalHandle ensureGetLocalHandle(
     const arbiter::Arbiter& a,
     const std::string& path,
     int tries = defaultTries);
 
+// Headers requesting the range [start, end) of a file, or from start until the
+// end of the file if end is zero.
+arbiter::http::Headers getRangeHeader(uint64_t start, uint64_t end = 0);
+
 arbiter::LocalHandle getPointlessLasFile(
     const std::string& path,
     const std::string& tmp,
@@ -0,0 +1,352 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/util/local-writer.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+
+#ifdef ENTWINE_HAVE_URING
+#include <fcntl.h>
+#include <liburing.h>
+#include <unistd.h>
+#endif
+
+#include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/types/exceptions.hpp>
+
+namespace entwine
+{
+
+class LocalWriter::Impl
+{
+public:
+    explicit Impl(const std::size_t depth)
+        : m_depth(std::max<std::size_t>(depth, 1))
+        , m_batch(std::max<std::size_t>(m_depth / 4, 1))
+    {
+#ifdef ENTWINE_HAVE_URING
+        // The kernel may not support io_uring, or it may be disallowed, in
+        // which case we fall back to synchronous writes.
+        m_async = io_uring_queue_init(m_depth, &m_ring, 0) == 0;
+#endif
+    }
+
+    ~Impl()
+    {
+#ifdef ENTWINE_HAVE_URING
+        if (!m_async) return;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        try { drain(lock); }
+        catch (...) { }
+        io_uring_queue_exit(&m_ring);
+#endif
+    }
+
+    void put(std::string path, std::vector<char> data)
+    {
+        path = arbiter::expandTilde(path);
+
+#ifdef ENTWINE_HAVE_URING
+        if (m_async) return putAsync(path, std::move(data));
+#endif
+
+        std::ofstream stream(path, std::ofstream::binary | std::ofstream::out |
+                std::ofstream::trunc);
+        if (stream.good()) stream.write(data.data(), data.size());
+
+        if (!stream.good())
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            fail(path, "Failed to write " + path);
+        }
+    }
+
+    void wait(std::string path)
+    {
+        path = arbiter::expandTilde(path);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+#ifdef ENTWINE_HAVE_URING
+        if (m_async)
+        {
+            await(lock, [this, &path]() { return !m_pending.count(path); });
+        }
+#endif
+
+        const auto it(m_failed.find(path));
+        if (it != m_failed.end())
+        {
+            const std::string message(it->second);
+            m_failed.erase(it);
+            throw FatalError(message);
+        }
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+#ifdef ENTWINE_HAVE_URING
+        if (m_async) drain(lock);
+#endif
+
+        std::vector<std::string> errors;
+        std::swap(errors, m_errors);
+        m_failed.clear();
+
+        throwFailures(errors);
+    }
+
+    bool async() const { return m_async; }
+
+private:
+    // Requires m_mutex.
+    void fail(const std::string& path, const std::string& message)
+    {
+        m_failed[path] = message;
+        m_errors.push_back(message);
+    }
+
+#ifdef ENTWINE_HAVE_URING
+    struct Op
+    {
+        Op(std::string path, std::vector<char> data, int fd)
+            : path(path)
+            , data(std::move(data))
+            , fd(fd)
+        { }
+
+        std::string path;
+        std::vector<char> data;
+        int fd = -1;
+        std::size_t done = 0;
+    };
+
+    void putAsync(const std::string& path, std::vector<char> data)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        // Truncating a file with a write still in flight would interleave the
+        // two, so an overwrite of the same path must wait for the first.  The
+        // path is then claimed, so that later overwrites wait for us in turn,
+        // and opened without holding the lock.
+        await(lock, [this, &path]() { return !m_pending.count(path); });
+        ++m_pending[path];
+
+        lock.unlock();
+        const int flags(O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC);
+        const int fd(::open(path.c_str(), flags, 0644));
+        const bool empty(fd != -1 && data.empty());
+        if (empty) ::close(fd);
+        lock.lock();
+
+        if (fd == -1 || empty)
+        {
+            release(path);
+            if (fd == -1) fail(path, "Could not open " + path);
+            return;
+        }
+
+        try { await(lock, [this]() { return m_inFlight < m_depth; }); }
+        catch (...)
+        {
+            ::close(fd);
+            release(path);
+            throw;
+        }
+
+        ++m_inFlight;
+        submit(new Op(path, std::move(data), fd));
+        m_cv.notify_all();
+
+        // Opportunistically complete anything that has already finished so
+        // file descriptors and buffers are released promptly.  Only one
+        // thread may consume completions at a time, so leave them to the
+        // reaper if there is one.
+        if (m_reaping) return;
+        io_uring_cqe* cqe(nullptr);
+        while (io_uring_peek_cqe(&m_ring, &cqe) == 0 && cqe) complete(cqe);
+    }
+
+    // All of the following require m_mutex.
+
+    // Wait until done() holds.  A single waiter at a time reaps completions,
+    // blocking on the ring without holding the lock, while any others wait to
+    // be notified of its progress.
+    template <typename Done>
+    void await(std::unique_lock<std::mutex>& lock, Done done)
+    {
+        while (!done())
+        {
+            flush();
+            if (m_reaping || !m_inFlight)
+            {
+                m_cv.wait(lock);
+                continue;
+            }
+
+            m_reaping = true;
+            lock.unlock();
+
+            io_uring_cqe* cqe(nullptr);
+            int err(0);
+            do { err = io_uring_wait_cqe(&m_ring, &cqe); }
+            while (err == -EINTR);
+
+            lock.lock();
+            m_reaping = false;
+            m_cv.notify_all();
+
+            if (err < 0)
+            {
+                throw FatalError(
+                    std::string("io_uring wait failed: ") +
+                    std::strerror(-err));
+            }
+
+            complete(cqe);
+            while (io_uring_peek_cqe(&m_ring, &cqe) == 0 && cqe)
+            {
+                complete(cqe);
+            }
+        }
+    }
+
+    void submit(Op* op)
+    {
+        io_uring_sqe* sqe(io_uring_get_sqe(&m_ring));
+        if (!sqe)
+        {
+            flush();
+            sqe = io_uring_get_sqe(&m_ring);
+        }
+
+        // We never have more writes in flight than our ring depth, so once
+        // any queued entries are submitted there must be room.
+        if (!sqe) throw FatalError("Failed to acquire io_uring entry");
+
+        io_uring_prep_write(
+            sqe,
+            op->fd,
+            op->data.data() + op->done,
+            op->data.size() - op->done,
+            op->done);
+        io_uring_sqe_set_data(sqe, op);
+
+        if (++m_unsubmitted >= m_batch) flush();
+    }
+
+    void flush()
+    {
+        if (!m_unsubmitted) return;
+
+        int submitted(0);
+        do { submitted = io_uring_submit(&m_ring); }
+        while (submitted == -EINTR);
+
+        if (submitted < 0)
+        {
+            throw FatalError(
+                std::string("io_uring submission failed: ") +
+                std::strerror(-submitted));
+        }
+        m_unsubmitted = 0;
+    }
+
+    void complete(io_uring_cqe* cqe)
+    {
+        Op* op(static_cast<Op*>(io_uring_cqe_get_data(cqe)));
+        const int res(cqe->res);
+        io_uring_cqe_seen(&m_ring, cqe);
+
+        if (res <= 0)
+        {
+            const std::string reason(res < 0 ? std::strerror(-res) : "EOF");
+            fail(op->path, "Failed to write " + op->path + ": " + reason);
+        }
+        else
+        {
+            // Short writes are resubmitted from where they left off.
+            op->done += res;
+            if (op->done < op->data.size()) return submit(op);
+        }
+
+        if (::close(op->fd) == -1 && res > 0)
+        {
+            fail(op->path, "Failed to close " + op->path);
+        }
+
+        release(op->path);
+        --m_inFlight;
+
+        delete op;
+    }
+
+    // Release a claim on a path, waking anyone waiting on it.
+    void release(const std::string& path)
+    {
+        auto it(m_pending.find(path));
+        if (!--it->second) m_pending.erase(it);
+        m_cv.notify_all();
+    }
+
+    void drain(std::unique_lock<std::mutex>& lock)
+    {
+        await(lock, [this]() { return !m_inFlight; });
+    }
+
+    io_uring m_ring;
+    std::size_t m_inFlight = 0;
+    std::size_t m_unsubmitted = 0;
+    bool m_reaping = false;
+    std::condition_variable m_cv;
+
+    // Paths which are claimed, by count of writes being opened or in flight.
+    std::map<std::string, std::size_t> m_pending;
+#endif
+
+    const std::size_t m_depth;
+    const std::size_t m_batch;
+    bool m_async = false;
+
+    std::mutex m_mutex;
+    std::map<std::string, std::string> m_failed;
+    std::vector<std::string> m_errors;
+};
+
+LocalWriter::LocalWriter(const std::size_t depth)
+    : m_impl(new Impl(depth))
+{ }
+
+LocalWriter::~LocalWriter() { }
+
+void LocalWriter::put(std::string path, std::vector<char> data)
+{
+    m_impl->put(path, std::move(data));
+}
+
+void LocalWriter::put(std::string path, const std::string& s)
+{
+    m_impl->put(path, std::vector<char>(s.begin(), s.end()));
+}
+
+void LocalWriter::wait(const std::string& path) { m_impl->wait(path); }
+void LocalWriter::wait() { m_impl->wait(); }
+bool LocalWriter::async() const { return m_impl->async(); }
+
+} // namespace entwine
@@ -0,0 +1,57 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace entwine
+{
+
+// Writes whole files to the local filesystem asynchronously.  When built with
+// io_uring support, writes from any number of threads are submitted to a
+// shared ring in batches and reaped as they complete.  Otherwise, or if the
+// ring cannot be created at runtime, each put is performed synchronously.
+//
+// All member functions are thread-safe.
+class LocalWriter
+{
+public:
+    explicit LocalWriter(std::size_t depth = 64);
+    ~LocalWriter();
+
+    // Create or truncate the file at this path and queue a write of the data,
+    // which is retained until the write completes.  Blocks while the maximum
+    // number of writes are in flight.
+    void put(std::string path, std::vector<char> data);
+    void put(std::string path, const std::string& s);
+
+    // Wait for any pending writes of this path, throwing if any have failed.
+    void wait(const std::string& path);
+
+    // Wait for all pending writes, throwing if any have failed since the last
+    // call to wait.
+    void wait();
+
+    // True if writes are performed asynchronously via io_uring.
+    bool async() const;
+
+private:
+    LocalWriter(const LocalWriter&);
+    LocalWriter& operator=(const LocalWriter&);
+
+    class Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+
+} // namespace entwine
@@ -0,0 +1,207 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/util/memory-driver.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+namespace entwine
+{
+
+MemoryDriver::MemoryDriver() : arbiter::Driver("mem") { }
+
+std::shared_ptr<MemoryDriver> MemoryDriver::shared()
+{
+    static const std::shared_ptr<MemoryDriver> driver(
+        std::make_shared<MemoryDriver>());
+    return driver;
+}
+
+MemoryDriver::Shard& MemoryDriver::shard(const std::string& path) const
+{
+    return m_shards[std::hash<std::string>()(path) % m_shards.size()];
+}
+
+MemoryDriver::Object MemoryDriver::find(const std::string& path) const
+{
+    Shard& s(shard(path));
+    std::lock_guard<std::mutex> lock(s.mutex);
+    const auto it(s.objects.find(path));
+    if (it == s.objects.end()) return Object();
+    return it->second;
+}
+
+std::vector<char> MemoryDriver::put(
+    const std::string path,
+    const std::vector<char>& data) const
+{
+    // Copy outside of the lock, and share the copy with readers so that an
+    // overwrite never modifies data which is being read.
+    auto object(std::make_shared<const std::vector<char>>(data));
+
+    ++m_puts;
+    m_bytesWritten += data.size();
+
+    Shard& s(shard(path));
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.objects[path] = std::move(object);
+    return std::vector<char>();
+}
+
+bool MemoryDriver::get(const std::string path, std::vector<char>& data) const
+{
+    ++m_gets;
+
+    const Object object(find(path));
+    if (!object) return false;
+
+    m_bytesRead += object->size();
+    data = *object;
+    return true;
+}
+
+std::unique_ptr<std::size_t> MemoryDriver::tryGetSize(
+    const std::string path) const
+{
+    ++m_sizes;
+
+    const Object object(find(path));
+    if (!object) return std::unique_ptr<std::size_t>();
+    return std::unique_ptr<std::size_t>(new std::size_t(object->size()));
+}
+
+std::vector<char> MemoryDriver::getRange(
+    const std::string path,
+    const uint64_t begin,
+    const uint64_t end) const
+{
+    ++m_ranges;
+
+    const Object object(find(path));
+    if (!object) throw std::runtime_error("Not found: mem://" + path);
+    if (begin > end || end > object->size())
+    {
+        throw std::runtime_error("Invalid range for mem://" + path);
+    }
+
+    m_bytesRead += end - begin;
+    return std::vector<char>(object->begin() + begin, object->begin() + end);
+}
+
+void MemoryDriver::copy(const std::string src, const std::string dst) const
+{
+    const Object object(find(src));
+    if (!object) throw std::runtime_error("Not found: mem://" + src);
+
+    ++m_gets;
+    ++m_puts;
+    m_bytesRead += object->size();
+    m_bytesWritten += object->size();
+
+    Shard& s(shard(dst));
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.objects[dst] = object;
+}
+
+bool MemoryDriver::remove(const std::string path) const
+{
+    Shard& s(shard(path));
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.objects.erase(path);
+}
+
+void MemoryDriver::clear() const
+{
+    for (Shard& s : m_shards)
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.objects.clear();
+    }
+}
+
+uint64_t MemoryDriver::count() const
+{
+    uint64_t n(0);
+    for (Shard& s : m_shards)
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        n += s.objects.size();
+    }
+    return n;
+}
+
+uint64_t MemoryDriver::bytes() const
+{
+    uint64_t n(0);
+    for (Shard& s : m_shards)
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        for (const auto& p : s.objects) n += p.second->size();
+    }
+    return n;
+}
+
+MemoryDriver::Stats MemoryDriver::stats() const
+{
+    Stats s;
+    s.gets = m_gets;
+    s.puts = m_puts;
+    s.ranges = m_ranges;
+    s.sizes = m_sizes;
+    s.lists = m_lists;
+    s.bytesRead = m_bytesRead;
+    s.bytesWritten = m_bytesWritten;
+    return s;
+}
+
+void MemoryDriver::resetStats() const
+{
+    m_gets = 0;
+    m_puts = 0;
+    m_ranges = 0;
+    m_sizes = 0;
+    m_lists = 0;
+    m_bytesRead = 0;
+    m_bytesWritten = 0;
+}
+
+std::vector<std::string> MemoryDriver::glob(
+    std::string path,
+    const bool verbose) const
+{
+    ++m_lists;
+
+    path.pop_back();
+    const bool recursive(path.size() && path.back() == '*');
+    if (recursive) path.pop_back();
+
+    std::vector<std::string> results;
+    for (Shard& s : m_shards)
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        for (const auto& p : s.objects)
+        {
+            const std::string& name(p.first);
+            if (name.compare(0, path.size(), path) != 0) continue;
+            if (!recursive && name.find('/', path.size()) != std::string::npos)
+            {
+                continue;
+            }
+            results.push_back("mem://" + name);
+        }
+    }
+
+    std::sort(results.begin(), results.end());
+    return results;
+}
+
+} // namespace entwine
@@ -0,0 +1,107 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+
+namespace entwine
+{
+
+// An arbiter driver for mem:// paths, which stores objects in memory.  This
+// isolates the CPU cost of building from any storage behavior, which makes it
+// useful for tests and benchmarking.  It acts as a remote driver, so builds
+// targeting it exercise the same code paths as those targeting object storage.
+//
+// All member functions are thread-safe.
+class MemoryDriver : public arbiter::Driver
+{
+public:
+    struct Stats
+    {
+        uint64_t gets = 0;
+        uint64_t puts = 0;
+        uint64_t ranges = 0;
+        uint64_t sizes = 0;
+        uint64_t lists = 0;
+        uint64_t bytesRead = 0;
+        uint64_t bytesWritten = 0;
+    };
+
+    MemoryDriver();
+
+    // The process-wide store registered with every arbiter created by our
+    // configuration, so they all see the same objects.
+    static std::shared_ptr<MemoryDriver> shared();
+
+    std::vector<char> put(
+        std::string path,
+        const std::vector<char>& data) const override;
+    std::unique_ptr<std::size_t> tryGetSize(std::string path) const override;
+    void copy(std::string src, std::string dst) const override;
+
+    // Get the bytes in the range [begin, end) of an object, throwing if it
+    // does not exist or the range exceeds its size.
+    std::vector<char> getRange(
+        std::string path,
+        uint64_t begin,
+        uint64_t end) const;
+
+    bool remove(std::string path) const;
+    void clear() const;
+
+    // Number of objects stored, and their total size in bytes.
+    uint64_t count() const;
+    uint64_t bytes() const;
+
+    Stats stats() const;
+    void resetStats() const;
+
+protected:
+    bool get(std::string path, std::vector<char>& data) const override;
+
+    // Paths ending in "/*" match the objects directly within that directory,
+    // and those ending in "/**" match everything beneath it.
+    std::vector<std::string> glob(std::string path, bool verbose) const
+        override;
+
+private:
+    using Object = std::shared_ptr<const std::vector<char>>;
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::map<std::string, Object> objects;
+    };
+
+    Shard& shard(const std::string& path) const;
+    Object find(const std::string& path) const;
+
+    mutable std::array<Shard, 64> m_shards;
+
+    mutable std::atomic_uint64_t m_gets { 0 };
+    mutable std::atomic_uint64_t m_puts { 0 };
+    mutable std::atomic_uint64_t m_ranges { 0 };
+    mutable std::atomic_uint64_t m_sizes { 0 };
+    mutable std::atomic_uint64_t m_lists { 0 };
+    mutable std::atomic_uint64_t m_bytesRead { 0 };
+    mutable std::atomic_uint64_t m_bytesWritten { 0 };
+};
+
+} // namespace entwine
@@ -0,0 +1,96 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/util/mmap.hpp>
+
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+#include <entwine/third/arbiter/arbiter.hpp>
+
+namespace entwine
+{
+
+#ifndef _WIN32
+
+MappedFile::MappedFile(std::string path)
+{
+    path = arbiter::expandTilde(path);
+
+    const int fd(::open(path.c_str(), O_RDONLY));
+    if (fd == -1) throw std::runtime_error("Could not open " + path);
+
+    struct stat st;
+    if (::fstat(fd, &st) == -1)
+    {
+        ::close(fd);
+        throw std::runtime_error("Could not stat " + path);
+    }
+
+    m_size = st.st_size;
+
+    // Mapping a zero-length file is an error, and there is nothing to read.
+    if (!m_size)
+    {
+        ::close(fd);
+        return;
+    }
+
+    void* p(::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0));
+
+    // The mapping holds its own reference to the file.
+    ::close(fd);
+
+    if (p == MAP_FAILED) throw std::runtime_error("Could not map " + path);
+
+    ::madvise(p, m_size, MADV_SEQUENTIAL);
+
+    m_data = static_cast<const char*>(p);
+    m_mapped = true;
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_mapped) ::munmap(const_cast<char*>(m_data), m_size);
+}
+
+#else
+
+MappedFile::MappedFile(std::string path)
+{
+    path = arbiter::expandTilde(path);
+
+    std::ifstream stream(path, std::ios::in | std::ios::binary);
+    if (!stream.good()) throw std::runtime_error("Could not open " + path);
+
+    stream.seekg(0, std::ios::end);
+    m_buffer.resize(static_cast<std::size_t>(stream.tellg()));
+    stream.seekg(0, std::ios::beg);
+    stream.read(m_buffer.data(), m_buffer.size());
+
+    if (!stream.good()) throw std::runtime_error("Could not read " + path);
+
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+}
+
+MappedFile::~MappedFile() { }
+
+#endif
+
+} // namespace entwine
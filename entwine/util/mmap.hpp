@@ -0,0 +1,43 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace entwine
+{
+
+// A read-only view of the full contents of a local file.  Where supported the
+// file is memory mapped and hinted for sequential access, otherwise its
+// contents are read into an owned buffer.
+class MappedFile
+{
+public:
+    explicit MappedFile(std::string path);
+    ~MappedFile();
+
+    const char* data() const { return m_data; }
+    uint64_t size() const { return m_size; }
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const char* m_data = nullptr;
+    uint64_t m_size = 0;
+
+    bool m_mapped = false;
+    std::vector<char> m_buffer;
+};
+
+} // namespace entwine
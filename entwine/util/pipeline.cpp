@@ -11,6 +11,10 @@
 #include <entwine/util/pipeline.hpp>
 
 #include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <limits>
+#include <sstream>
 
 #include <pdal/io/LasReader.hpp>
 #include <pdal/io/LasHeader.hpp>
@@ -52,6 +56,54 @@ json omitStage(json pipeline, const std::string type)
     return pipeline;
 }
 
+std::string getReaderType(const json& pipeline, std::string path)
+{
+    if (pipeline.is_array() && pipeline.size() && pipeline.at(0).is_object())
+    {
+        const std::string type(pipeline.at(0).value("type", ""));
+        if (type.size()) return type;
+    }
+
+    std::transform(
+        path.begin(),
+        path.end(),
+        path.begin(),
+        [](unsigned char c) { return std::tolower(c); });
+
+    const auto endsWith = [&path](const std::string s)
+    {
+        return path.size() >= s.size() &&
+            path.compare(path.size() - s.size(), s.size(), s) == 0;
+    };
+
+    if (endsWith(".copc.laz")) return "readers.copc";
+    if (endsWith("ept.json")) return "readers.ept";
+    if (endsWith(".las") || endsWith(".laz")) return "readers.las";
+    return "";
+}
+
+bool pushDownBounds(json& pipeline, const std::string path, const Bounds& b)
+{
+    json result(pipeline.is_null() ? json::array({ json::object() }) : pipeline);
+    if (!result.is_array() || result.size() != 1) return false;
+
+    json& reader(result.at(0));
+    if (!reader.is_object() || reader.count("bounds")) return false;
+
+    const std::string type(getReaderType(result, path));
+    if (type != "readers.copc" && type != "readers.ept") return false;
+
+    std::ostringstream ss;
+    ss << std::setprecision(std::numeric_limits<double>::max_digits10) <<
+        "([" << b.min().x << ", " << b.max().x << "], " <<
+        "[" << b.min().y << ", " << b.max().y << "])";
+
+    reader["type"] = type;
+    reader["bounds"] = ss.str();
+    pipeline = result;
+    return true;
+}
+
 pdal::Stage* findStage(pdal::Stage& last, const std::string type)
 {
     pdal::Stage* current(&last);
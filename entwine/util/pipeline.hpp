@@ -16,6 +16,7 @@
 #include <pdal/Reader.hpp>
 #include <pdal/Stage.hpp>
 
+#include <entwine/types/bounds.hpp>
 #include <entwine/types/scale-offset.hpp>
 #include <entwine/util/json.hpp>
 #include <entwine/util/optional.hpp>
@@ -29,6 +30,15 @@ json::const_iterator findStage(const json& pipeline, std::string type);
 json& findOrAppendStage(json& pipeline, std::string type);
 json omitStage(json pipeline, std::string type);
 
+// The reader type for a pipeline, as specified or as inferred from the path.
+std::string getReaderType(const json& pipeline, std::string path);
+
+// If this pipeline consists of a lone reader which supports spatially filtered
+// reads, such as COPC or EPT, then restrict it to the XY extents of the given
+// bounds and return true.  Points outside of these bounds may still be read,
+// but those within them are never skipped.
+bool pushDownBounds(json& pipeline, std::string path, const Bounds& bounds);
+
 pdal::Stage* findStage(pdal::Stage& last, std::string type);
 pdal::Stage& getStage(pdal::PipelineManager& pm);
 pdal::Reader& getReader(pdal::Stage& last);
@@ -0,0 +1,248 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/util/ranged-stream.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <entwine/util/io.hpp>
+#include <entwine/util/memory-driver.hpp>
+
+namespace entwine
+{
+
+namespace
+{
+
+RangedBuffer::Fetch getFetch(const arbiter::Arbiter& a, const std::string path)
+{
+    // In-memory objects support ranged reads directly, rather than via HTTP.
+    if (auto mem = std::dynamic_pointer_cast<MemoryDriver>(a.getDriver(path)))
+    {
+        const std::string stripped(arbiter::stripProtocol(path));
+        return [mem, stripped](uint64_t begin, uint64_t end)
+        {
+            return mem->getRange(stripped, begin, end);
+        };
+    }
+
+    return [&a, path](uint64_t begin, uint64_t end)
+    {
+        return a.getBinary(path, getRangeHeader(begin, end));
+    };
+}
+
+} // unnamed namespace
+
+RangedBuffer::RangedBuffer(
+    Fetch fetch,
+    const uint64_t size,
+    const uint64_t blockSize,
+    const uint64_t readAhead)
+    : m_fetch(fetch)
+    , m_size(size)
+    , m_blockSize(std::max<uint64_t>(blockSize, 1))
+    , m_readAhead(readAhead)
+    , m_numBlocks((m_size + m_blockSize - 1) / m_blockSize)
+{
+    const uint64_t threads(
+        std::min<uint64_t>(m_readAhead + 1, m_numBlocks));
+    for (uint64_t i(0); i < threads; ++i)
+    {
+        m_threads.emplace_back([this]() { work(); });
+    }
+}
+
+RangedBuffer::~RangedBuffer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_done = true;
+    }
+    m_cv.notify_all();
+    for (auto& t : m_threads) t.join();
+}
+
+void RangedBuffer::work()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true)
+    {
+        // Find the first block within our window which has not been claimed.
+        uint64_t index(0);
+        m_cv.wait(lock, [this, &index]()
+        {
+            if (m_done) return true;
+
+            const uint64_t end(
+                std::min(m_current + m_readAhead + 1, m_numBlocks));
+            for (index = m_current; index < end; ++index)
+            {
+                if (!m_blocks.count(index)) return true;
+            }
+            return false;
+        });
+
+        if (m_done) return;
+
+        SharedBlock block(std::make_shared<Block>());
+        m_blocks[index] = block;
+
+        lock.unlock();
+
+        std::vector<char> data;
+        std::string error;
+        try
+        {
+            const uint64_t begin(index * m_blockSize);
+            const uint64_t end(std::min(begin + m_blockSize, m_size));
+            data = m_fetch(begin, end);
+
+            if (data.size() != end - begin)
+            {
+                error = "Invalid range response: expected " +
+                    std::to_string(end - begin) + " bytes, got " +
+                    std::to_string(data.size());
+            }
+        }
+        catch (std::exception& e) { error = e.what(); }
+        catch (...) { error = "Unknown error"; }
+
+        lock.lock();
+
+        // If our reader has moved on, this block may have been dropped from
+        // the window already, in which case this result is simply discarded.
+        block->data = std::move(data);
+        block->error = error;
+        block->ready = true;
+
+        m_cv.notify_all();
+    }
+}
+
+uint64_t RangedBuffer::position() const
+{
+    return m_base + (gptr() - eback());
+}
+
+RangedBuffer::int_type RangedBuffer::underflow()
+{
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+    const uint64_t pos(position());
+    if (pos >= m_size) return traits_type::eof();
+
+    const uint64_t index(pos / m_blockSize);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // Slide our window forward, or jump it to a new location after a seek,
+    // dropping any blocks which we no longer need.
+    m_current = index;
+    const uint64_t last(m_current + m_readAhead);
+    for (auto it(m_blocks.begin()); it != m_blocks.end(); )
+    {
+        if (it->first < m_current || it->first > last) it = m_blocks.erase(it);
+        else ++it;
+    }
+
+    m_cv.notify_all();
+    m_cv.wait(lock, [this, index]()
+    {
+        const auto it(m_blocks.find(index));
+        return it != m_blocks.end() && it->second->ready;
+    });
+
+    SharedBlock block(m_blocks.at(index));
+    lock.unlock();
+
+    if (block->error.size())
+    {
+        throw std::runtime_error(
+            "Failed to read block " + std::to_string(index) + ": " +
+            block->error);
+    }
+
+    m_block = block;
+    m_base = index * m_blockSize;
+
+    char* data(m_block->data.data());
+    setg(data, data + (pos - m_base), data + m_block->data.size());
+
+    return traits_type::to_int_type(*gptr());
+}
+
+RangedBuffer::pos_type RangedBuffer::seekoff(
+    const off_type off,
+    const std::ios_base::seekdir dir,
+    const std::ios_base::openmode which)
+{
+    const pos_type invalid(off_type(-1));
+    if (!(which & std::ios_base::in)) return invalid;
+
+    int64_t target(off);
+    if (dir == std::ios_base::cur) target += position();
+    else if (dir == std::ios_base::end) target += m_size;
+
+    if (target < 0 || uint64_t(target) > m_size) return invalid;
+
+    const uint64_t begin(m_base);
+    const uint64_t end(m_base + (egptr() - eback()));
+
+    if (eback() && uint64_t(target) >= begin && uint64_t(target) < end)
+    {
+        setg(eback(), eback() + (target - begin), egptr());
+    }
+    else
+    {
+        setg(nullptr, nullptr, nullptr);
+        m_block.reset();
+        m_base = target;
+    }
+
+    return pos_type(target);
+}
+
+RangedBuffer::pos_type RangedBuffer::seekpos(
+    const pos_type pos,
+    const std::ios_base::openmode which)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+RangedStream::RangedStream(
+    RangedBuffer::Fetch fetch,
+    const uint64_t size,
+    const uint64_t blockSize,
+    const uint64_t readAhead)
+    : std::istream(nullptr)
+    , m_buffer(new RangedBuffer(fetch, size, blockSize, readAhead))
+{
+    rdbuf(m_buffer.get());
+}
+
+RangedStream::RangedStream(
+    const arbiter::Arbiter& a,
+    const std::string path,
+    const uint64_t blockSize,
+    const uint64_t readAhead)
+    : RangedStream(getFetch(a, path), a.getSize(path), blockSize, readAhead)
+{ }
+
+bool RangedStream::supports(const arbiter::Arbiter& a, const std::string path)
+{
+    return
+        a.isHttpDerived(path) ||
+        std::dynamic_pointer_cast<MemoryDriver>(a.getDriver(path));
+}
+
+} // namespace entwine
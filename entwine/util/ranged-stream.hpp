@@ -0,0 +1,127 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+
+namespace entwine
+{
+
+// A seekable stream buffer over a remote file, which is read via range
+// requests of blockSize bytes.  Up to readAhead blocks beyond the current
+// position are fetched in parallel, so at most readAhead + 1 blocks are held
+// in memory at once.
+//
+// The fetch function must return the bytes in the range [begin, end).  If a
+// fetch fails, reading the affected block fails the stream in the usual way,
+// by setting its badbit or throwing if exceptions are enabled for it.
+class RangedBuffer : public std::streambuf
+{
+public:
+    using Fetch =
+        std::function<std::vector<char>(uint64_t begin, uint64_t end)>;
+
+    RangedBuffer(
+        Fetch fetch,
+        uint64_t size,
+        uint64_t blockSize,
+        uint64_t readAhead);
+    ~RangedBuffer();
+
+    uint64_t size() const { return m_size; }
+
+protected:
+    int_type underflow() override;
+    pos_type seekoff(
+        off_type off,
+        std::ios_base::seekdir dir,
+        std::ios_base::openmode which) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
+private:
+    RangedBuffer(const RangedBuffer&);
+    RangedBuffer& operator=(const RangedBuffer&);
+
+    struct Block
+    {
+        bool ready = false;
+        std::vector<char> data;
+        std::string error;
+    };
+    using SharedBlock = std::shared_ptr<Block>;
+
+    void work();
+    uint64_t position() const;
+
+    const Fetch m_fetch;
+    const uint64_t m_size;
+    const uint64_t m_blockSize;
+    const uint64_t m_readAhead;
+    const uint64_t m_numBlocks;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::map<uint64_t, SharedBlock> m_blocks;
+    uint64_t m_current = 0;
+    bool m_done = false;
+
+    // The block backing our get area, and its offset within the file.  With
+    // no get area, m_base is simply our current position.
+    SharedBlock m_block;
+    uint64_t m_base = 0;
+
+    std::vector<std::thread> m_threads;
+};
+
+// An input stream over a file fetched via ranged reads.
+class RangedStream : public std::istream
+{
+public:
+    static constexpr uint64_t defaultBlockSize = 1024 * 1024 * 8;
+    static constexpr uint64_t defaultReadAhead = 8;
+
+    RangedStream(
+        RangedBuffer::Fetch fetch,
+        uint64_t size,
+        uint64_t blockSize = defaultBlockSize,
+        uint64_t readAhead = defaultReadAhead);
+
+    // Read from a path via the HTTP range requests of its driver, or directly
+    // for mem:// paths.
+    RangedStream(
+        const arbiter::Arbiter& a,
+        std::string path,
+        uint64_t blockSize = defaultBlockSize,
+        uint64_t readAhead = defaultReadAhead);
+
+    // Whether a path supports the ranged reads which the constructor above
+    // requires.
+    static bool supports(const arbiter::Arbiter& a, std::string path);
+
+    uint64_t size() const { return m_buffer->size(); }
+
+private:
+    std::unique_ptr<RangedBuffer> m_buffer;
+};
+
+} // namespace entwine
@@ -0,0 +1,85 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/util/sax.hpp>
+
+namespace entwine
+{
+
+void SaxHandler::parse(const std::string& data)
+{
+    if (!json::sax_parse(data, this))
+    {
+        throw std::runtime_error("Invalid JSON");
+    }
+}
+
+bool SaxHandler::key(std::string& k)
+{
+    if (m_stack.size()) m_key = std::move(k);
+    else onKey(k);
+    return true;
+}
+
+bool SaxHandler::start(json v)
+{
+    if (m_stack.size())
+    {
+        m_stack.push_back(&add(std::move(v)));
+        return true;
+    }
+
+    m_capture = false;
+    onStart(v.is_object());
+    if (m_capture)
+    {
+        m_root = std::move(v);
+        m_stack.push_back(&m_root);
+    }
+    return true;
+}
+
+bool SaxHandler::scalar(json v)
+{
+    if (m_stack.size()) add(std::move(v));
+    else onValue(std::move(v));
+    return true;
+}
+
+bool SaxHandler::end()
+{
+    if (m_stack.empty())
+    {
+        onEnd();
+        return true;
+    }
+
+    m_stack.pop_back();
+    if (m_stack.empty()) onValue(std::move(m_root));
+    return true;
+}
+
+json& SaxHandler::add(json v)
+{
+    // Only the most recently added child of a container may still be open,
+    // so these references remain valid while it is on the stack.
+    json& parent(*m_stack.back());
+    if (parent.is_array())
+    {
+        parent.push_back(std::move(v));
+        return parent.back();
+    }
+
+    json& child(parent[m_key]);
+    child = std::move(v);
+    return child;
+}
+
+} // namespace entwine
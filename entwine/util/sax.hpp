@@ -0,0 +1,87 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <entwine/util/json.hpp>
+
+namespace entwine
+{
+
+// A base for streaming JSON parsers, driven by the nlohmann SAX interface so
+// that no DOM is built for the document as a whole.  Derived handlers receive
+// structural events and scalar values via the protected hooks.  From within
+// onStart, a handler may call capture() to have that container assembled
+// into a small json value instead, which is delivered to onValue once it is
+// complete.
+class SaxHandler
+{
+public:
+    virtual ~SaxHandler() { }
+
+    // Parse a complete JSON document, throwing on malformed input.
+    void parse(const std::string& data);
+
+    // The nlohmann SAX interface.
+    bool null() { return scalar(json()); }
+    bool boolean(bool v) { return scalar(v); }
+    bool number_integer(json::number_integer_t v) { return scalar(v); }
+    bool number_unsigned(json::number_unsigned_t v) { return scalar(v); }
+    bool number_float(json::number_float_t v, const std::string&)
+    {
+        return scalar(v);
+    }
+    bool string(std::string& v) { return scalar(std::move(v)); }
+
+    template <typename Binary>
+    bool binary(Binary&)
+    {
+        throw std::runtime_error("Unexpected binary JSON value");
+    }
+
+    bool start_object(std::size_t) { return start(json::object()); }
+    bool key(std::string& k);
+    bool end_object() { return end(); }
+    bool start_array(std::size_t) { return start(json::array()); }
+    bool end_array() { return end(); }
+
+    template <typename Error>
+    bool parse_error(std::size_t, const std::string&, const Error& e)
+    {
+        throw std::runtime_error(std::string("Invalid JSON: ") + e.what());
+    }
+
+protected:
+    virtual void onStart(bool object) = 0;
+    virtual void onKey(std::string& key) = 0;
+    virtual void onValue(json value) = 0;
+    virtual void onEnd() = 0;
+
+    // Capture the container which is currently being started.
+    void capture() { m_capture = true; }
+
+private:
+    bool start(json v);
+    bool scalar(json v);
+    bool end();
+    json& add(json v);
+
+    bool m_capture = false;
+    json m_root;
+    std::vector<json*> m_stack;
+    std::string m_key;
+};
+
+} // namespace entwine
@@ -0,0 +1,298 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/util/scheduler.hpp>
+
+#include <algorithm>
+#include <future>
+
+#include <entwine/types/exceptions.hpp>
+
+namespace entwine
+{
+
+namespace
+{
+
+std::size_t index(const Scheduler::Priority p)
+{
+    return p == Scheduler::Priority::High ? 0 : 1;
+}
+
+} // unnamed namespace
+
+Scheduler::Scheduler(
+    const uint64_t threads,
+    const int tries,
+    const std::chrono::milliseconds backoff,
+    const std::chrono::milliseconds maxBackoff)
+    : m_threads(std::max<uint64_t>(threads, 1))
+    , m_lowLimit(std::max<uint64_t>(m_threads * 3 / 4, 1))
+    , m_tries(std::max(tries, 1))
+    , m_backoff(backoff)
+    , m_maxBackoff(maxBackoff)
+    , m_random(std::random_device()())
+{ }
+
+Scheduler::~Scheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_done = true;
+    }
+    m_cv.notify_all();
+    for (auto& t : m_workers) t.join();
+}
+
+void Scheduler::limit(const std::string& name, const Limits limits)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Endpoint& e(endpoint(name));
+    e.limits = limits;
+    e.tokens = std::max(limits.rate, 1.0);
+    e.refilled = Clock::now();
+}
+
+void Scheduler::add(
+    const std::string& name,
+    const Priority priority,
+    Op op,
+    Done done)
+{
+    auto task(std::make_shared<Task>());
+    task->endpoint = name;
+    task->priority = priority;
+    task->op = std::move(op);
+    task->done = std::move(done);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        endpoint(name).queues[index(priority)].push_back(task);
+        ++m_outstanding;
+
+        // Only start another worker if the existing ones are all spoken for.
+        if (m_workers.size() < m_threads && m_workers.size() < m_outstanding)
+        {
+            m_workers.emplace_back([this]() { work(); });
+        }
+    }
+    m_cv.notify_one();
+}
+
+void Scheduler::run(const std::string& name, const Priority priority, Op op)
+{
+    std::promise<std::string> promise;
+    std::future<std::string> future(promise.get_future());
+
+    add(name, priority, std::move(op), [&promise](const std::string& error)
+    {
+        promise.set_value(error);
+    });
+
+    const std::string error(future.get());
+    if (error.size()) throw FatalError(error);
+}
+
+std::map<std::string, Scheduler::Stats> Scheduler::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::map<std::string, Stats> result;
+    for (const auto& p : m_endpoints)
+    {
+        const Endpoint& e(p.second);
+        Stats s(e.stats);
+        s.queued = e.queues[0].size() + e.queues[1].size();
+        result[p.first] = s;
+    }
+    return result;
+}
+
+uint64_t Scheduler::workers() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_workers.size();
+}
+
+Scheduler::Endpoint& Scheduler::endpoint(const std::string& name)
+{
+    auto it(m_endpoints.find(name));
+    if (it != m_endpoints.end()) return it->second;
+    return m_endpoints.emplace(name, Endpoint()).first->second;
+}
+
+void Scheduler::work()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true)
+    {
+        auto now(Clock::now());
+
+        // Return any operations whose backoff has elapsed to their queues.
+        while (m_timers.size() && m_timers.begin()->first <= now)
+        {
+            TaskPtr task(m_timers.begin()->second);
+            m_timers.erase(m_timers.begin());
+
+            Endpoint& e(endpoint(task->endpoint));
+            --e.stats.waiting;
+            e.queues[index(task->priority)].push_front(task);
+        }
+
+        Clock::time_point wake(Clock::time_point::max());
+        if (m_timers.size()) wake = m_timers.begin()->first;
+
+        TaskPtr task(next(now, wake));
+
+        if (!task)
+        {
+            if (m_done && !m_outstanding) return;
+
+            if (wake == Clock::time_point::max()) m_cv.wait(lock);
+            else m_cv.wait_until(lock, wake);
+            continue;
+        }
+
+        ++m_busy;
+        ++endpoint(task->endpoint).stats.active;
+
+        lock.unlock();
+
+        const auto start(Clock::now());
+        std::string error;
+        try { task->op(); }
+        catch (std::exception& e) { error = e.what(); }
+        catch (...) { error = "Unknown error"; }
+        now = Clock::now();
+
+        lock.lock();
+
+        --m_busy;
+
+        Endpoint& e(endpoint(task->endpoint));
+        Stats& stats(e.stats);
+        --stats.active;
+
+        const double ms(
+            std::chrono::duration<double, std::milli>(now - start).count());
+        stats.latency = stats.latency ? stats.latency * 0.9 + ms * 0.1 : ms;
+
+        if (error.size() && ++task->tried < m_tries)
+        {
+            ++stats.retries;
+            ++stats.waiting;
+            m_timers.emplace(now + backoff(task->tried), task);
+            m_cv.notify_all();
+            continue;
+        }
+
+        if (error.size())
+        {
+            ++stats.failed;
+            error = "Failed after " + std::to_string(task->tried) +
+                " tries: " + error;
+        }
+        else ++stats.completed;
+
+        lock.unlock();
+        m_cv.notify_all();
+
+        if (task->done)
+        {
+            try { task->done(error); }
+            catch (...) { }
+        }
+
+        lock.lock();
+        --m_outstanding;
+        if (m_done && !m_outstanding) m_cv.notify_all();
+    }
+}
+
+Scheduler::TaskPtr Scheduler::next(
+    const Clock::time_point now,
+    Clock::time_point& wake)
+{
+    if (m_endpoints.empty()) return TaskPtr();
+
+    for (const Priority priority : { Priority::High, Priority::Low })
+    {
+        if (priority == Priority::Low && m_busy >= m_lowLimit) break;
+
+        // Visit each endpoint once, starting after the one which was most
+        // recently serviced, so no endpoint is starved by a busier one.
+        auto it(m_endpoints.upper_bound(m_cursor));
+        for (std::size_t i(0); i < m_endpoints.size(); ++i, ++it)
+        {
+            if (it == m_endpoints.end()) it = m_endpoints.begin();
+
+            Endpoint& e(it->second);
+            auto& queue(e.queues[index(priority)]);
+            if (queue.empty() || !admit(e, now, wake)) continue;
+
+            TaskPtr task(queue.front());
+            queue.pop_front();
+            m_cursor = it->first;
+            return task;
+        }
+    }
+
+    return TaskPtr();
+}
+
+bool Scheduler::admit(
+    Endpoint& e,
+    const Clock::time_point now,
+    Clock::time_point& wake)
+{
+    const Limits& limits(e.limits);
+    if (limits.concurrency && e.stats.active >= limits.concurrency)
+    {
+        // We'll be notified when an operation completes.
+        return false;
+    }
+
+    if (limits.rate <= 0) return true;
+
+    using seconds = std::chrono::duration<double>;
+    const double elapsed(seconds(now - e.refilled).count());
+    e.tokens = std::min(
+        e.tokens + elapsed * limits.rate,
+        std::max(limits.rate, 1.0));
+    e.refilled = now;
+
+    if (e.tokens >= 1)
+    {
+        e.tokens -= 1;
+        return true;
+    }
+
+    const seconds until((1 - e.tokens) / limits.rate);
+    wake = std::min(
+        wake,
+        now + std::chrono::duration_cast<Clock::duration>(until));
+    return false;
+}
+
+Scheduler::Clock::duration Scheduler::backoff(const int tried)
+{
+    // Exponential backoff from our base delay, with half of each delay
+    // randomized so that simultaneous failures do not retry in lockstep.
+    const int shift(std::min(tried - 1, 20));
+    const auto full(std::min<std::chrono::milliseconds>(
+        m_backoff * (int64_t(1) << shift),
+        m_maxBackoff));
+
+    std::uniform_int_distribution<int64_t> dist(0, full.count() / 2);
+    return std::chrono::milliseconds(full.count() - dist(m_random));
+}
+
+} // namespace entwine
@@ -0,0 +1,159 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace entwine
+{
+
+// Runs I/O operations against one or more endpoints on a shared set of worker
+// threads.  Each endpoint may be limited in its number of concurrent
+// operations and in its rate of operations, via a token bucket.
+//
+// Failed operations are retried with exponential backoff and jitter.  While
+// an operation is backing off it is parked on a timer rather than occupying a
+// worker, so other work proceeds in the meantime.
+//
+// High priority operations, like reads on the critical path, are always
+// dispatched ahead of low priority ones.  Low priority work may occupy at most
+// three quarters of the workers so reads never queue behind a full set of
+// background writes.
+//
+// Workers are started as operations are queued, up to the thread count, so a
+// scheduler which is never used holds no threads.
+//
+// All member functions are thread-safe.
+class Scheduler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using Op = std::function<void()>;
+
+    // Called once an operation has completed, with an empty error on success.
+    using Done = std::function<void(const std::string& error)>;
+
+    enum class Priority { High, Low };
+
+    struct Limits
+    {
+        // Maximum operations in progress at once, or zero for no limit beyond
+        // our thread count.
+        uint64_t concurrency = 0;
+
+        // Maximum operations started per second, or zero for no limit.  Up to
+        // one second's worth of operations may be started in a burst.
+        double rate = 0;
+    };
+
+    struct Stats
+    {
+        // Operations awaiting a worker.
+        uint64_t queued = 0;
+        // Operations in progress.
+        uint64_t active = 0;
+        // Failed operations awaiting a retry.
+        uint64_t waiting = 0;
+
+        uint64_t completed = 0;
+        uint64_t failed = 0;
+        uint64_t retries = 0;
+
+        // Moving average of the duration of each attempt, in milliseconds.
+        double latency = 0;
+    };
+
+    Scheduler(
+        uint64_t threads,
+        int tries = 8,
+        std::chrono::milliseconds backoff = std::chrono::milliseconds(250),
+        std::chrono::milliseconds maxBackoff = std::chrono::seconds(30));
+
+    // Completes all outstanding operations, including their retries.
+    ~Scheduler();
+
+    void limit(const std::string& endpoint, Limits limits);
+
+    // Queue an operation, which is considered failed if it throws.
+    void add(const std::string& endpoint, Priority priority, Op op, Done done);
+
+    // Run an operation and wait for it, throwing if all of its attempts fail.
+    // This must not be called from within an operation.
+    void run(const std::string& endpoint, Priority priority, Op op);
+
+    std::map<std::string, Stats> stats() const;
+
+    // The number of worker threads started so far.
+    uint64_t workers() const;
+
+private:
+    Scheduler(const Scheduler&);
+    Scheduler& operator=(const Scheduler&);
+
+    struct Task
+    {
+        std::string endpoint;
+        Priority priority;
+        Op op;
+        Done done;
+        int tried = 0;
+    };
+    using TaskPtr = std::shared_ptr<Task>;
+
+    struct Endpoint
+    {
+        Limits limits;
+        std::deque<TaskPtr> queues[2];
+        double tokens = 0;
+        Clock::time_point refilled = Clock::now();
+        Stats stats;
+    };
+
+    void work();
+
+    // All of the following require m_mutex.
+    Endpoint& endpoint(const std::string& name);
+    TaskPtr next(Clock::time_point now, Clock::time_point& wake);
+    bool admit(Endpoint& e, Clock::time_point now, Clock::time_point& wake);
+    Clock::duration backoff(int tried);
+
+    const uint64_t m_threads;
+    const uint64_t m_lowLimit;
+    const int m_tries;
+    const std::chrono::milliseconds m_backoff;
+    const std::chrono::milliseconds m_maxBackoff;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+
+    std::map<std::string, Endpoint> m_endpoints;
+    std::multimap<Clock::time_point, TaskPtr> m_timers;
+    std::string m_cursor;
+    uint64_t m_busy = 0;
+    uint64_t m_outstanding = 0;
+    bool m_done = false;
+    std::mt19937 m_random;
+
+    std::vector<std::thread> m_workers;
+};
+
+} // namespace entwine
@@ -0,0 +1,142 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/util/shaped-driver.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+namespace entwine
+{
+
+namespace
+{
+
+void sleep(const double ms)
+{
+    if (ms <= 0) return;
+    std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(ms));
+}
+
+} // unnamed namespace
+
+ShapedDriver::ShapedDriver() : ShapedDriver(Shape()) { }
+
+ShapedDriver::ShapedDriver(const Shape shape)
+    : arbiter::drivers::Fs("shaped")
+    , m_shape(shape)
+    , m_random(shape.seed ? shape.seed : std::random_device()())
+{ }
+
+std::vector<char> ShapedDriver::put(
+    const std::string path,
+    const std::vector<char>& data) const
+{
+    if (!request()) throw arbiter::ArbiterError("503: shaped://" + path);
+    transfer(data.size());
+
+    arbiter::mkdirp(arbiter::getDirname(path));
+    return Fs::put(path, data);
+}
+
+bool ShapedDriver::get(const std::string path, std::vector<char>& data) const
+{
+    if (!request()) return false;
+    if (!Fs::get(path, data)) return false;
+    transfer(data.size());
+    return true;
+}
+
+std::unique_ptr<std::size_t> ShapedDriver::tryGetSize(
+    const std::string path) const
+{
+    if (!request()) return std::unique_ptr<std::size_t>();
+    return Fs::tryGetSize(path);
+}
+
+void ShapedDriver::copy(const std::string src, const std::string dst) const
+{
+    if (!request()) throw arbiter::ArbiterError("503: shaped://" + dst);
+
+    arbiter::mkdirp(arbiter::getDirname(dst));
+    Fs::copy(src, dst);
+}
+
+std::vector<std::string> ShapedDriver::glob(
+    const std::string path,
+    const bool verbose) const
+{
+    if (!request()) throw arbiter::ArbiterError("503: shaped://" + path);
+
+    std::vector<std::string> results(Fs::glob(path, verbose));
+    for (auto& s : results) s = "shaped://" + s;
+    return results;
+}
+
+ShapedDriver::Stats ShapedDriver::stats() const
+{
+    Stats s;
+    s.requests = m_requests;
+    s.failures = m_failures;
+    s.tails = m_tails;
+    return s;
+}
+
+bool ShapedDriver::request() const
+{
+    ++m_requests;
+
+    double ms(m_shape.latency);
+    bool tail(false);
+    bool fail(false);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::uniform_real_distribution<double> uniform(0, 1);
+
+        if (m_shape.jitter > 0)
+        {
+            std::normal_distribution<double> normal(0, m_shape.jitter);
+            ms *= std::exp(normal(m_random));
+        }
+        tail = uniform(m_random) < m_shape.tail;
+        fail = uniform(m_random) < m_shape.errors;
+    }
+
+    if (tail)
+    {
+        ++m_tails;
+        ms += m_shape.tailLatency;
+    }
+
+    sleep(ms);
+
+    if (fail) ++m_failures;
+    return !fail;
+}
+
+void ShapedDriver::transfer(const uint64_t bytes) const
+{
+    if (m_shape.bandwidth > 0) sleep(bytes / m_shape.bandwidth * 1000.0);
+}
+
+void from_json(const json& j, ShapedDriver::Shape& shape)
+{
+    shape.latency = j.value("latency", shape.latency);
+    shape.jitter = j.value("jitter", shape.jitter);
+    shape.tail = j.value("tail", shape.tail);
+    shape.tailLatency = j.value("tailLatency", shape.tailLatency);
+    shape.errors = j.value("errors", shape.errors);
+    shape.bandwidth = j.value("bandwidth", shape.bandwidth);
+    shape.seed = j.value("seed", shape.seed);
+}
+
+} // namespace entwine
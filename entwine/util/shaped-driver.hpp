@@ -0,0 +1,107 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/util/json.hpp>
+
+namespace entwine
+{
+
+// An arbiter driver for shaped:// paths, which are local filesystem paths
+// accessed as though they were remote.  Every request is delayed and may fail
+// according to the configured shape, which lets us reproduce the behavior of
+// object storage locally without any network.
+//
+// Like object storage, and unlike the filesystem driver, directories are
+// implicit: writes create any missing parent directories.
+//
+// All member functions are thread-safe.
+class ShapedDriver : public arbiter::drivers::Fs
+{
+public:
+    struct Shape
+    {
+        // Median latency per request, in milliseconds.
+        double latency = 0;
+
+        // The spread of per-request latencies, as the standard deviation of
+        // their logarithm.  Zero gives a constant latency.
+        double jitter = 0;
+
+        // The fraction of requests which are slow-tail outliers, and the extra
+        // latency, in milliseconds, that these requests incur.
+        double tail = 0;
+        double tailLatency = 0;
+
+        // The fraction of requests which fail, as a 503 response would.
+        double errors = 0;
+
+        // Per-request transfer rate in bytes per second, or zero for no limit.
+        double bandwidth = 0;
+
+        // Random seed, or zero for a nondeterministic one.
+        uint64_t seed = 0;
+    };
+
+    struct Stats
+    {
+        uint64_t requests = 0;
+        uint64_t failures = 0;
+        uint64_t tails = 0;
+    };
+
+    ShapedDriver();
+    explicit ShapedDriver(Shape shape);
+
+    std::vector<char> put(
+        std::string path,
+        const std::vector<char>& data) const override;
+    std::unique_ptr<std::size_t> tryGetSize(std::string path) const override;
+    void copy(std::string src, std::string dst) const override;
+    bool isRemote() const override { return true; }
+
+    const Shape& shape() const { return m_shape; }
+    Stats stats() const;
+
+protected:
+    bool get(std::string path, std::vector<char>& data) const override;
+    std::vector<std::string> glob(std::string path, bool verbose) const
+        override;
+
+private:
+    // Delay for the latency of a single request and return true, or return
+    // false if this request should fail.
+    bool request() const;
+
+    // Delay for the transfer time of this many bytes.
+    void transfer(uint64_t bytes) const;
+
+    const Shape m_shape;
+
+    mutable std::mutex m_mutex;
+    mutable std::mt19937_64 m_random;
+
+    mutable std::atomic_uint64_t m_requests { 0 };
+    mutable std::atomic_uint64_t m_failures { 0 };
+    mutable std::atomic_uint64_t m_tails { 0 };
+};
+
+void from_json(const json& j, ShapedDriver::Shape& shape);
+
+} // namespace entwine
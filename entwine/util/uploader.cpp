@@ -0,0 +1,126 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/util/uploader.hpp>
+
+#include <memory>
+
+#include <entwine/types/exceptions.hpp>
+
+namespace entwine
+{
+
+Uploader::Uploader(
+    const arbiter::Endpoint& ep,
+    Scheduler& scheduler,
+    const uint64_t maxBytes)
+    : m_ep(ep)
+    , m_scheduler(scheduler)
+    , m_maxBytes(maxBytes)
+{ }
+
+Uploader::~Uploader()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this]() { return m_pending.empty(); });
+}
+
+void Uploader::put(std::string path, std::vector<char> data)
+{
+    const uint64_t size(data.size());
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        // A single put larger than our budget is admitted once nothing else is
+        // in flight, rather than blocking forever.
+        m_cv.wait(lock, [this, &path, size]()
+        {
+            return
+                !m_pending.count(path) &&
+                (!m_bytes || m_bytes + size <= m_maxBytes);
+        });
+
+        m_bytes += size;
+        ++m_pending[path];
+    }
+
+    // Scheduled operations must be copyable, so share the buffer rather than
+    // copy it.
+    const auto shared(std::make_shared<std::vector<char>>(std::move(data)));
+
+    m_scheduler.add(
+        m_ep.prefixedRoot(),
+        Scheduler::Priority::Low,
+        [this, path, shared]() { m_ep.put(path, *shared); },
+        [this, path, size](const std::string& error)
+        {
+            done(
+                path,
+                size,
+                error.size() ? "Failed to put " + path + ": " + error : "");
+        });
+}
+
+void Uploader::done(
+    const std::string& path,
+    const uint64_t size,
+    const std::string& error)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bytes -= size;
+
+        auto it(m_pending.find(path));
+        if (!--it->second) m_pending.erase(it);
+
+        if (error.size())
+        {
+            m_failed[path] = error;
+            m_errors.push_back(error);
+        }
+    }
+
+    m_cv.notify_all();
+}
+
+void Uploader::wait(const std::string& path)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this, &path]() { return !m_pending.count(path); });
+
+    const auto it(m_failed.find(path));
+    if (it != m_failed.end())
+    {
+        const std::string message(it->second);
+        m_failed.erase(it);
+        throw FatalError(message);
+    }
+}
+
+void Uploader::wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this]() { return m_pending.empty(); });
+
+    std::vector<std::string> errors;
+    std::swap(errors, m_errors);
+    m_failed.clear();
+
+    throwFailures(errors);
+}
+
+uint64_t Uploader::bytes() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_bytes;
+}
+
+} // namespace entwine
@@ -0,0 +1,73 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/util/scheduler.hpp>
+
+namespace entwine
+{
+
+// A write-behind stage for an endpoint.  Puts are handed off to the scheduler
+// as low priority operations so the caller does not wait on the network.  At
+// most maxBytes of data may be awaiting upload - beyond that, put blocks until
+// enough uploads complete, which applies backpressure to the producer.
+//
+// All member functions are thread-safe.
+class Uploader
+{
+public:
+    Uploader(
+        const arbiter::Endpoint& ep,
+        Scheduler& scheduler,
+        uint64_t maxBytes);
+    ~Uploader();
+
+    // Queue an upload of this data, retrying on failure.  A pending upload to
+    // the same path is completed before this one is queued.
+    void put(std::string path, std::vector<char> data);
+
+    // Wait for any pending upload of this path, throwing if it has failed.
+    void wait(const std::string& path);
+
+    // Wait for all pending uploads, throwing if any have failed since the last
+    // call to wait.
+    void wait();
+
+    // Number of bytes currently awaiting upload.
+    uint64_t bytes() const;
+
+private:
+    Uploader(const Uploader&);
+    Uploader& operator=(const Uploader&);
+
+    void done(const std::string& path, uint64_t size, const std::string& error);
+
+    const arbiter::Endpoint& m_ep;
+    Scheduler& m_scheduler;
+    const uint64_t m_maxBytes;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    uint64_t m_bytes = 0;
+    std::map<std::string, uint64_t> m_pending;
+    std::map<std::string, std::string> m_failed;
+    std::vector<std::string> m_errors;
+};
+
+} // namespace entwine
@@ -0,0 +1,231 @@
+#include "gtest/gtest.h"
+
+#include <fstream>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/util/analysis-cache.hpp>
+#include <entwine/util/memory-driver.hpp>
+
+using namespace entwine;
+
+namespace
+{
+    const std::string dir(
+        arbiter::join(arbiter::getTempPath(), "entwine-analysis-cache-test/"));
+    const json pipeline(json::parse(R"([{ "type": "readers.las" }])"));
+
+    SourceInfo makeInfo(uint64_t points)
+    {
+        SourceInfo info;
+        info.points = points;
+        info.bounds = Bounds(0, 0, 0, 1, 2, 3);
+        info.pipeline = pipeline;
+        info.schema = { Dimension("X", Type::Double) };
+        return info;
+    }
+
+    void reset()
+    {
+        arbiter::mkdirp(dir);
+        std::ofstream(AnalysisCache::getFilename(dir), std::ios::trunc);
+    }
+}
+
+TEST(analysisCache, persists)
+{
+    reset();
+    const AnalysisCache::Version v { "a.laz", 100, 42 };
+
+    {
+        AnalysisCache cache(dir, pipeline, false);
+        EXPECT_FALSE(cache.get(v));
+        cache.put(v, makeInfo(10));
+        ASSERT_TRUE(cache.get(v));
+    }
+
+    AnalysisCache cache(dir, pipeline, false);
+    EXPECT_EQ(cache.size(), 1u);
+    const auto info(cache.get(v));
+    ASSERT_TRUE(info);
+    EXPECT_EQ(info->points, 10u);
+    EXPECT_EQ(info->bounds, makeInfo(10).bounds);
+    EXPECT_EQ(info->schema, makeInfo(10).schema);
+}
+
+TEST(analysisCache, keyedByVersion)
+{
+    reset();
+    const AnalysisCache::Version v { "a.laz", 100, 42 };
+
+    {
+        AnalysisCache cache(dir, pipeline, false);
+        cache.put(v, makeInfo(10));
+    }
+
+    AnalysisCache cache(dir, pipeline, false);
+    EXPECT_FALSE(cache.get(AnalysisCache::Version { "b.laz", 100, 42 }));
+    EXPECT_FALSE(cache.get(AnalysisCache::Version { "a.laz", 101, 42 }));
+    EXPECT_FALSE(cache.get(AnalysisCache::Version { "a.laz", 100, 43 }));
+
+    // The pipeline and analysis mode are part of the key as well.
+    EXPECT_FALSE(AnalysisCache(dir, pipeline, true).get(v));
+    EXPECT_FALSE(AnalysisCache(dir, json::array({ json::object() }), false)
+        .get(v));
+
+    // Later records take precedence.
+    cache.put(v, makeInfo(20));
+    EXPECT_EQ(AnalysisCache(dir, pipeline, false).get(v)->points, 20u);
+}
+
+TEST(analysisCache, skipsErrors)
+{
+    reset();
+    const AnalysisCache::Version v { "a.laz", 100, 42 };
+
+    SourceInfo info(makeInfo(10));
+    info.errors.push_back("Failed");
+
+    AnalysisCache(dir, pipeline, false).put(v, info);
+    EXPECT_FALSE(AnalysisCache(dir, pipeline, false).get(v));
+}
+
+TEST(analysisCache, truncated)
+{
+    reset();
+    const AnalysisCache::Version v { "a.laz", 100, 42 };
+    AnalysisCache(dir, pipeline, false).put(v, makeInfo(10));
+
+    {
+        std::ofstream stream(
+            AnalysisCache::getFilename(dir),
+            std::ios::binary | std::ios::app);
+        stream << R"({ "path": "b.laz", "size": 1)";
+    }
+
+    const AnalysisCache::Version w { "c.laz", 200, 42 };
+    {
+        AnalysisCache cache(dir, pipeline, false);
+        EXPECT_EQ(cache.size(), 1u);
+        EXPECT_TRUE(cache.get(v));
+        cache.put(w, makeInfo(20));
+    }
+
+    AnalysisCache cache(dir, pipeline, false);
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_TRUE(cache.get(v));
+    EXPECT_TRUE(cache.get(w));
+}
+
+TEST(analysisCache, localVersion)
+{
+    reset();
+    const std::string path(arbiter::join(dir, "file.txt"));
+    std::ofstream(path, std::ios::trunc) << "abc";
+
+    arbiter::Arbiter a;
+    const auto v(AnalysisCache::getVersion(path, a));
+    ASSERT_TRUE(v);
+    EXPECT_EQ(v->path, path);
+    EXPECT_EQ(v->size, 3u);
+
+    std::ofstream(path, std::ios::app) << "def";
+    EXPECT_EQ(AnalysisCache::getVersion(path, a)->size, 6u);
+
+    EXPECT_FALSE(AnalysisCache::getVersion(path + ".missing", a));
+}
+
+TEST(analysisCache, subsecondVersion)
+{
+    reset();
+    const std::string path(arbiter::join(dir, "file.txt"));
+
+    // Set the modification time explicitly, so that the two writes land
+    // within the same second, differing only in their nanoseconds.
+    const auto write = [&path](const std::string& data, long nsec)
+    {
+        std::ofstream(path, std::ios::trunc) << data;
+        const timespec t { 1600000000, nsec };
+        const timespec times[2] = { t, t };
+        ASSERT_EQ(::utimensat(AT_FDCWD, path.c_str(), times, 0), 0);
+    };
+
+    arbiter::Arbiter a;
+    write("abc", 100000000);
+    const auto v(AnalysisCache::getVersion(path, a));
+    ASSERT_TRUE(v);
+
+    AnalysisCache cache(dir, pipeline, false);
+    cache.put(*v, makeInfo(42));
+    ASSERT_TRUE(cache.get(*v));
+
+    // A rewrite of the same size within the same second is a new version.
+    write("xyz", 600000000);
+    const auto w(AnalysisCache::getVersion(path, a));
+    ASSERT_TRUE(w);
+    EXPECT_EQ(w->size, v->size);
+    EXPECT_NE(w->modified, v->modified);
+    EXPECT_FALSE(cache.get(*w));
+}
+
+TEST(analysisCache, remoteOptIn)
+{
+    auto mem(MemoryDriver::shared());
+    mem->clear();
+    arbiter::Arbiter a;
+    a.addDriver("mem", mem);
+
+    const std::string path("mem://analysis/a.las");
+    a.put(path, std::string("abc"));
+
+    // Without a real version, remote files are not cached unless requested.
+    EXPECT_FALSE(AnalysisCache::getVersion(path, a));
+
+    const auto v(AnalysisCache::getVersion(path, a, true));
+    ASSERT_TRUE(v);
+    EXPECT_EQ(v->size, 3u);
+    EXPECT_EQ(v->modified, 0);
+
+    mem->clear();
+}
+
+TEST(analysisCache, compaction)
+{
+    reset();
+    const AnalysisCache::Version v { "a.laz", 100, 42 };
+    const AnalysisCache::Version w { "b.laz", 100, 42 };
+
+    {
+        AnalysisCache cache(dir, pipeline, false);
+        cache.put(w, makeInfo(5));
+        for (uint64_t i(0); i < 2000; ++i) cache.put(v, makeInfo(i));
+    }
+
+    uint64_t before(0);
+    {
+        std::ifstream stream(AnalysisCache::getFilename(dir));
+        std::string line;
+        while (std::getline(stream, line)) ++before;
+    }
+    EXPECT_EQ(before, 2001u);
+
+    AnalysisCache cache(dir, pipeline, false);
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_EQ(cache.get(v)->points, 1999u);
+    EXPECT_EQ(cache.get(w)->points, 5u);
+
+    uint64_t after(0);
+    {
+        std::ifstream stream(AnalysisCache::getFilename(dir));
+        std::string line;
+        while (std::getline(stream, line)) ++after;
+    }
+    EXPECT_EQ(after, 2u);
+
+    // Appends after compaction are found at their new offsets.
+    cache.put(v, makeInfo(7));
+    EXPECT_EQ(AnalysisCache(dir, pipeline, false).get(v)->points, 7u);
+}
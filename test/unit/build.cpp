@@ -3,11 +3,15 @@
 
 #include <pdal/PipelineManager.hpp>
 
+#include <set>
+
 #include <entwine/builder/builder.hpp>
+#include <entwine/builder/hierarchy.hpp>
 #include <entwine/io/laszip.hpp>
 #include <entwine/types/vector-point-table.hpp>
 #include <entwine/util/config.hpp>
 #include <entwine/util/json.hpp>
+#include <entwine/util/memory-driver.hpp>
 
 using namespace entwine;
 
@@ -182,6 +186,31 @@ TEST(build, binary)
     checkData(*view);
 }
 
+TEST(build, memory)
+{
+    auto mem(MemoryDriver::shared());
+    mem->clear();
+    mem->resetStats();
+
+    run({
+        { "input", test::dataPath() + "ellipsoid.laz" },
+        { "output", "mem://ellipsoid/" },
+        { "dataType", "binary" }
+    });
+
+    const auto store(config::getArbiter(json()));
+    const json ept = json::parse(store->get("mem://ellipsoid/ept.json"));
+    EXPECT_EQ(Bounds(ept.at("bounds")), bounds);
+    EXPECT_EQ(ept.at("points").get<int>(), 100000);
+    EXPECT_EQ(ept.at("dataType").get<std::string>(), "binary");
+
+    EXPECT_TRUE(store->tryGetSize("mem://ellipsoid/ept-data/0-0-0-0.bin"));
+    EXPECT_GT(mem->stats().puts, 1u);
+    EXPECT_GT(mem->stats().bytesWritten, 0u);
+
+    mem->clear();
+}
+
 #ifndef NO_ZSTD
 TEST(build, zstandard)
 {
@@ -269,6 +298,60 @@ TEST(build, continued)
     checkData(*view);
 }
 
+TEST(build, continuedBinaryHierarchy)
+{
+    const std::string input = test::dataPath() + "ellipsoid-multi";
+    const std::string dir(outDir + "ept-hierarchy/");
+    const arbiter::Endpoint ep(a.getEndpoint(dir));
+    run({ { "input", input }, { "limit", 4 }, { "binaryHierarchy", true } });
+
+    // Continuations read only the binary hierarchy, so the JSON files may be
+    // marked to show which of them are rewritten.
+    const auto mark = [&]()
+    {
+        for (const auto& path : a.resolve(dir + "*-*-*-*.json"))
+        {
+            a.put(path, std::string("marked"));
+        }
+    };
+    const auto marked = [&](const Dxyz& root)
+    {
+        return ep.get(root.toString() + ".json") == "marked";
+    };
+
+    const Hierarchy before(hierarchy::loadBinary(ep, 4));
+    mark();
+    run({ { "input", input }, { "force", false } });
+    const Hierarchy after(hierarchy::loadBinary(ep, 4));
+
+    std::vector<Dxyz> keys;
+    for (const auto& node : after.nodes())
+    {
+        int64_t count(0);
+        if (!before.find(node.first, count) || count != node.second)
+        {
+            keys.push_back(node.first);
+        }
+    }
+    const std::vector<Dxyz> roots(hierarchy::getFileRoots(keys, 2));
+    ASSERT_FALSE(roots.empty());
+
+    std::set<Dxyz> rewritten(roots.begin(), roots.end());
+    for (const auto& chunk : hierarchy::getChunks(after, 2))
+    {
+        EXPECT_EQ(marked(chunk.first), !rewritten.count(chunk.first)) <<
+            chunk.first.toString();
+    }
+
+    // With nothing left to insert, nothing is rewritten.
+    mark();
+    run({ { "input", input }, { "force", false } });
+    for (const auto& chunk : hierarchy::getChunks(after, 2))
+    {
+        EXPECT_TRUE(marked(chunk.first)) << chunk.first.toString();
+    }
+}
+
 TEST(build, subset)
 {
     const std::string input = test::dataPath() + "ellipsoid-multi";
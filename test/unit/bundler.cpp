@@ -0,0 +1,139 @@
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <entwine/io/bundler.hpp>
+#include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/util/memory-driver.hpp>
+
+using namespace entwine;
+
+namespace
+{
+    const std::string tmp(
+        arbiter::join(arbiter::getTempPath(), "entwine-bundler-test"));
+
+    std::shared_ptr<arbiter::Arbiter> makeArbiter()
+    {
+        auto a(std::make_shared<arbiter::Arbiter>());
+        a->addDriver("mem", MemoryDriver::shared());
+        return a;
+    }
+
+    std::vector<char> makeData(const std::string& name)
+    {
+        return std::vector<char>(name.begin(), name.end());
+    }
+
+    void roundTrip(const std::string output)
+    {
+        const Endpoints endpoints(makeArbiter(), output, tmp);
+        const std::vector<std::string> names {
+            "2-0-1-0.bin", "3-1-2-0.bin", "3-0-3-1.bin", "2-1-1-1.bin"
+        };
+
+        {
+            Bundler bundler(endpoints, 2);
+            for (const auto& name : names) bundler.put(name, makeData(name));
+
+            // Staged nodes are readable before they are bundled.
+            EXPECT_EQ(bundler.get("3-1-2-0.bin"), makeData("3-1-2-0.bin"));
+
+            bundler.bundle(4);
+            for (const auto& name : names)
+            {
+                EXPECT_EQ(bundler.get(name), makeData(name));
+                EXPECT_FALSE(endpoints.data.tryGetSize(name));
+            }
+        }
+
+        EXPECT_TRUE(endpoints.data.tryGetSize("2-0-1-0.shard"));
+        EXPECT_TRUE(endpoints.data.tryGetSize("2-1-1-1.shard"));
+        EXPECT_TRUE(endpoints.hierarchy.tryGetSize("2-0-1-0.shard.json"));
+
+        // Rewrite a single node, and make sure its shard-mates survive.
+        {
+            Bundler bundler(endpoints, 2);
+            bundler.put("3-1-2-0.bin", makeData("updated"));
+            bundler.bundle(4);
+        }
+
+        Bundler bundler(endpoints, 2);
+        EXPECT_EQ(bundler.get("3-1-2-0.bin"), makeData("updated"));
+        EXPECT_EQ(bundler.get("2-0-1-0.bin"), makeData("2-0-1-0.bin"));
+        EXPECT_EQ(bundler.get("3-0-3-1.bin"), makeData("3-0-3-1.bin"));
+        EXPECT_ANY_THROW(bundler.get("3-7-7-7.bin"));
+    }
+}
+
+TEST(bundler, getShard)
+{
+    EXPECT_EQ(Bundler::getShard("3-1-2-0.laz", 2), "2-0-1-0");
+    EXPECT_EQ(Bundler::getShard("5-9-4-3.bin", 2), "4-4-2-1");
+    EXPECT_EQ(Bundler::getShard("2-1-1-1.bin", 2), "2-1-1-1");
+    EXPECT_EQ(Bundler::getShard("1-1-1-1.bin", 2), "");
+    EXPECT_EQ(Bundler::getShard("3-1-2-0.laz", 0), "");
+
+    // Subset-postfixed files and other metadata are never bundled.
+    EXPECT_EQ(Bundler::getShard("3-1-2-0-4.laz", 2), "");
+    EXPECT_EQ(Bundler::getShard("ept.json", 2), "");
+}
+
+TEST(bundler, splits)
+{
+    const Endpoints endpoints(makeArbiter(), "mem://bundler-splits/", tmp);
+    EXPECT_ANY_THROW(Bundler(endpoints, 1, 2));
+    EXPECT_NO_THROW(Bundler(endpoints, 2, 2));
+}
+
+TEST(bundler, local)
+{
+    const std::string dir(
+        arbiter::join(arbiter::getTempPath(), "entwine-bundler-output"));
+    roundTrip(dir);
+}
+
+TEST(bundler, memory)
+{
+    MemoryDriver::shared()->clear();
+    roundTrip("mem://bundler/");
+    MemoryDriver::shared()->clear();
+}
+
+TEST(bundler, ranges)
+{
+    MemoryDriver::shared()->clear();
+    const Endpoints endpoints(makeArbiter(), "mem://bundler-ranges/", tmp);
+    const std::vector<std::string> names {
+        "2-0-1-0.bin", "3-0-3-1.bin", "3-1-2-0.bin"
+    };
+
+    {
+        Bundler bundler(endpoints, 2);
+        for (const auto& name : names) bundler.put(name, makeData(name));
+        bundler.bundle(4);
+    }
+
+    // The retained nodes are contiguous in the prior shard, so rewriting the
+    // last one reads them back with a single ranged read, rather than fetching
+    // the whole shard.  The only whole object fetched is the offset table.
+    MemoryDriver::shared()->resetStats();
+    {
+        Bundler bundler(endpoints, 2);
+        bundler.put("3-1-2-0.bin", makeData("updated"));
+        bundler.bundle(4);
+    }
+
+    const MemoryDriver::Stats stats(MemoryDriver::shared()->stats());
+    EXPECT_EQ(stats.ranges, 1u);
+    EXPECT_EQ(stats.gets, 1u);
+
+    Bundler bundler(endpoints, 2);
+    EXPECT_EQ(bundler.get("2-0-1-0.bin"), makeData("2-0-1-0.bin"));
+    EXPECT_EQ(bundler.get("3-0-3-1.bin"), makeData("3-0-3-1.bin"));
+    EXPECT_EQ(bundler.get("3-1-2-0.bin"), makeData("updated"));
+
+    MemoryDriver::shared()->clear();
+}
@@ -0,0 +1,118 @@
+#include "gtest/gtest.h"
+#include "config.hpp"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <entwine/builder/builder.hpp>
+#include <entwine/builder/native-reader.hpp>
+#include <entwine/types/dimension.hpp>
+#include <entwine/types/vector-point-table.hpp>
+#include <entwine/util/info.hpp>
+#include <entwine/util/json.hpp>
+
+using namespace entwine;
+
+namespace
+{
+
+const std::string outDir(test::dataPath() + "out/copc/");
+const std::string copcPath(test::dataPath() + "out/ellipsoid.copc.laz");
+const uint64_t points = 100000;
+
+template <typename T>
+T peek(const std::vector<char>& data, const std::size_t pos)
+{
+    T v;
+    std::memcpy(&v, data.data() + pos, sizeof(T));
+    return v;
+}
+
+} // unnamed namespace
+
+#ifdef ENTWINE_HAVE_LASZIP
+TEST(copc, build)
+{
+    const json j = {
+        { "input", test::dataPath() + "ellipsoid.laz" },
+        { "output", outDir },
+        { "copc", copcPath },
+        { "allowOriginId", false },
+        { "force", true },
+        { "span", 32 },
+        { "progressInterval", 0 },
+        { "verbose", false }
+    };
+
+    Builder builder = builder::create(j);
+    builder::run(builder, j);
+
+    arbiter::Arbiter a;
+    const std::vector<char> data(a.getBinary(copcPath));
+    ASSERT_GT(data.size(), 375u);
+
+    // The COPC info VLR must immediately follow the header.
+    EXPECT_EQ(std::string(data.data(), 4), "LASF");
+    EXPECT_EQ(peek<uint8_t>(data, 104) & 0x80, 0x80);
+    EXPECT_EQ(std::string(data.data() + 375 + 2), "copc");
+    EXPECT_EQ(peek<uint16_t>(data, 375 + 18), 1);
+    EXPECT_EQ(peek<uint64_t>(data, 247), points);
+
+    // The hierarchy should account for every point, in valid chunks.
+    const uint64_t evlr(peek<uint64_t>(data, 235));
+    EXPECT_EQ(std::string(data.data() + evlr + 2), "copc");
+    EXPECT_EQ(peek<uint16_t>(data, evlr + 18), 1000);
+
+    const uint64_t size(peek<uint64_t>(data, evlr + 20));
+    ASSERT_EQ(size % 32, 0u);
+    ASSERT_EQ(evlr + 60 + size, data.size());
+
+    uint64_t total(0);
+    for (uint64_t pos(evlr + 60); pos < evlr + 60 + size; pos += 32)
+    {
+        const uint64_t offset(peek<uint64_t>(data, pos + 16));
+        const int32_t bytes(peek<int32_t>(data, pos + 24));
+        EXPECT_GT(bytes, 0);
+        EXPECT_LE(offset + bytes, evlr);
+        total += peek<int32_t>(data, pos + 28);
+    }
+    EXPECT_EQ(total, points);
+
+    // And the whole file should be readable as plain LAZ.
+    const SourceInfo info(
+        analyzeOne(copcPath, false, json::array({ json::object() })));
+    EXPECT_EQ(info.points, points);
+
+    auto reader(NativeReader::create(info, copcPath, copcPath));
+    ASSERT_TRUE(reader);
+
+    auto layout(toLayout(makeAbsolute(info.schema), false));
+    VectorPointTable table(layout);
+    uint64_t read(0);
+    table.setProcess([&]() { read += table.numPoints(); });
+    reader->read(table);
+    EXPECT_EQ(read, points);
+}
+#endif
+
+TEST(copc, subset)
+{
+    const json j = {
+        { "input", test::dataPath() + "ellipsoid.laz" },
+        { "output", outDir },
+        { "copc", copcPath + ".subset" },
+        { "subset", { { "id", 1 }, { "of", 4 } } },
+        { "force", true },
+        { "span", 32 },
+        { "progressInterval", 0 },
+        { "verbose", false }
+    };
+
+    // Subset builds defer COPC output to the merge.
+    Builder builder = builder::create(j);
+    builder::run(builder, j);
+
+    arbiter::Arbiter a;
+    EXPECT_FALSE(a.tryGetSize(copcPath + ".subset"));
+}
@@ -0,0 +1,144 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <entwine/util/hedge.hpp>
+#include <entwine/util/scheduler.hpp>
+
+using namespace entwine;
+
+namespace
+{
+
+using ms = std::chrono::milliseconds;
+using Clock = std::chrono::steady_clock;
+
+// A stand-in endpoint where every nth request stalls.
+class Stalling
+{
+public:
+    Stalling(int every, ms stall) : m_every(every), m_stall(stall) { }
+
+    std::vector<char> operator()()
+    {
+        if (++m_count % m_every == 0) std::this_thread::sleep_for(m_stall);
+        else std::this_thread::sleep_for(ms(1));
+        return std::vector<char>(4, 'x');
+    }
+
+    int count() const { return m_count; }
+
+private:
+    const int m_every;
+    const ms m_stall;
+    std::atomic_int m_count { 0 };
+};
+
+} // unnamed namespace
+
+TEST(hedge, disabled)
+{
+    Hedge hedge(0);
+    Stalling stalling(1000, ms(0));
+    for (int i(0); i < 100; ++i)
+    {
+        EXPECT_EQ(hedge.get([&]() { return stalling(); }).size(), 4u);
+    }
+    EXPECT_EQ(hedge.requests(), 100u);
+    EXPECT_EQ(hedge.hedged(), 0u);
+    EXPECT_EQ(stalling.count(), 100);
+}
+
+TEST(hedge, tail)
+{
+    Hedge hedge(0.5, 0.9, 64, 16);
+    Stalling stalling(20, ms(500));
+
+    // Warm up our latency estimate.
+    for (int i(0); i < 19; ++i) hedge.get([&]() { return stalling(); });
+    EXPECT_EQ(hedge.hedged(), 0u);
+
+    // This request will stall, so it should be hedged by a fast one.
+    const auto start(Clock::now());
+    EXPECT_EQ(hedge.get([&]() { return stalling(); }).size(), 4u);
+    EXPECT_LT(Clock::now() - start, ms(250));
+    EXPECT_EQ(hedge.hedged(), 1u);
+}
+
+TEST(hedge, budget)
+{
+    // Every request is slower than our threshold, but only 10% of them may
+    // be hedged.
+    Hedge hedge(0.1, 0.05, 1000, 4);
+    for (int i(0); i < 4; ++i)
+    {
+        hedge.get([]() { return std::vector<char>(1); });
+    }
+
+    for (int i(0); i < 40; ++i)
+    {
+        hedge.get([]()
+        {
+            std::this_thread::sleep_for(ms(5));
+            return std::vector<char>(1);
+        });
+    }
+
+    EXPECT_EQ(hedge.requests(), 44u);
+    EXPECT_LE(hedge.hedged(), 4u);
+    EXPECT_GE(hedge.hedged(), 1u);
+}
+
+TEST(hedge, failure)
+{
+    Hedge hedge(1, 0.5, 4, 1);
+    hedge.get([]() { return std::vector<char>(1); });
+
+    EXPECT_THROW(
+        hedge.get([]() -> std::vector<char>
+        {
+            std::this_thread::sleep_for(ms(20));
+            throw std::runtime_error("Failed");
+        }),
+        std::runtime_error);
+
+    // If one attempt fails, the other may still succeed.
+    std::atomic_int calls(0);
+    const auto result(hedge.get([&calls]()
+    {
+        if (++calls == 1)
+        {
+            std::this_thread::sleep_for(ms(50));
+            throw std::runtime_error("Failed");
+        }
+        return std::vector<char>(3);
+    }));
+    EXPECT_EQ(result.size(), 3u);
+}
+
+TEST(hedge, scheduled)
+{
+    // Both attempts are operations of the given scheduler, under the name of
+    // the endpoint, so that duplicates count against its limits.
+    Scheduler scheduler(4);
+    uint64_t hedged(0);
+    {
+        Hedge hedge(scheduler, 0.5, 0.9, 64, 16);
+        Stalling stalling(20, ms(200));
+        for (int i(0); i < 20; ++i)
+        {
+            EXPECT_EQ(hedge.get([&]() { return stalling(); }, "ep").size(), 4u);
+        }
+        hedged = hedge.hedged();
+        EXPECT_GE(hedged, 1u);
+    }
+
+    // Destruction waits for the stalled attempt, which has now completed.
+    const Scheduler::Stats stats(scheduler.stats().at("ep"));
+    EXPECT_EQ(stats.completed, 20u + hedged);
+}
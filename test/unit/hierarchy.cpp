@@ -0,0 +1,457 @@
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <entwine/builder/hierarchy.hpp>
+#include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/util/json.hpp>
+
+using namespace entwine;
+
+namespace
+{
+    const std::string tmp(
+        arbiter::join(arbiter::getTempPath(), "entwine-hierarchy-test/"));
+
+    // Spill after a single node per shard, so that nearly everything is
+    // served from run files.
+    const Hierarchy::Spill spill { tmp, 64 };
+
+    uint64_t countRuns()
+    {
+        arbiter::Arbiter a;
+        return a.resolve(tmp + "*").size();
+    }
+}
+
+TEST(hierarchy, setGet)
+{
+    Hierarchy h;
+    EXPECT_EQ(h.size(), 1u);
+    EXPECT_TRUE(h.contains(Dxyz()));
+    EXPECT_EQ(h.get(Dxyz()), 0);
+
+    h.set(Dxyz(), 42);
+    h.set(Dxyz(1, 1, 0, 1), 7);
+    EXPECT_EQ(h.get(Dxyz()), 42);
+    EXPECT_EQ(h.get(Dxyz(1, 1, 0, 1)), 7);
+    EXPECT_EQ(h.get(Dxyz(1, 0, 1, 1)), 0);
+    EXPECT_FALSE(h.contains(Dxyz(1, 0, 1, 1)));
+    EXPECT_EQ(h.size(), 2u);
+
+    h.set(Dxyz(1, 1, 0, 1), 8);
+    EXPECT_EQ(h.get(Dxyz(1, 1, 0, 1)), 8);
+    EXPECT_EQ(h.size(), 2u);
+}
+
+TEST(hierarchy, deep)
+{
+    Hierarchy h;
+    const uint64_t max(Hierarchy::maxDepth);
+    const uint64_t edge((1ull << max) - 1);
+
+    const Dxyz key(max, edge, 12345, edge - 1);
+    h.set(key, 3);
+    EXPECT_EQ(h.get(key), 3);
+    EXPECT_EQ(h.nodes().back().first, key);
+
+    EXPECT_FALSE(h.contains(Dxyz(max + 1, 0, 0, 0)));
+    EXPECT_ANY_THROW(h.set(Dxyz(max + 1, 0, 0, 0), 1));
+}
+
+TEST(hierarchy, concurrent)
+{
+    Hierarchy h;
+    const uint64_t depth(6);
+    const uint64_t span(1ull << depth);
+
+    // Each thread writes its own slab while reading all of the others.
+    std::vector<std::thread> threads;
+    for (uint64_t t(0); t < 8; ++t)
+    {
+        threads.emplace_back([&h, t, span, depth]()
+        {
+            for (uint64_t x(t); x < span; x += 8)
+            {
+                for (uint64_t y(0); y < span; ++y)
+                {
+                    for (uint64_t z(0); z < span; ++z)
+                    {
+                        h.set(Dxyz(depth, x, y, z), x + y + z + 1);
+                        h.get(Dxyz(depth, (x + 1) % span, y, z));
+                    }
+                }
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    ASSERT_EQ(h.size(), span * span * span + 1);
+    for (uint64_t x(0); x < span; ++x)
+    {
+        for (uint64_t y(0); y < span; ++y)
+        {
+            for (uint64_t z(0); z < span; ++z)
+            {
+                ASSERT_EQ(
+                    h.get(Dxyz(depth, x, y, z)),
+                    static_cast<int64_t>(x + y + z + 1));
+            }
+        }
+    }
+}
+
+TEST(hierarchy, ordered)
+{
+    Hierarchy h;
+    h.set(Dxyz(2, 3, 1, 0), 1);
+    h.set(Dxyz(1, 1, 1, 1), 2);
+    h.set(Dxyz(2, 0, 0, 1), 3);
+    h.set(Dxyz(1, 0, 0, 0), 4);
+
+    const auto nodes(h.nodes());
+    ASSERT_EQ(nodes.size(), 5u);
+    for (std::size_t i(1); i < nodes.size(); ++i)
+    {
+        EXPECT_TRUE(nodes[i - 1].first < nodes[i].first);
+    }
+
+    const Hierarchy copy(h);
+    EXPECT_EQ(copy.nodes(), nodes);
+
+    const json j(h);
+    EXPECT_EQ(j.size(), 5u);
+    EXPECT_EQ(j.at("2-0-0-1").get<int64_t>(), 3);
+    EXPECT_EQ(j.get<Hierarchy>().nodes(), nodes);
+}
+
+TEST(hierarchy, chunks)
+{
+    Hierarchy h;
+    h.set(Dxyz(), 10);
+    h.set(Dxyz(1, 0, 0, 0), 5);
+    h.set(Dxyz(2, 0, 0, 0), 2);
+    h.set(Dxyz(2, 1, 1, 1), 1);
+
+    const auto chunks(hierarchy::getChunks(h, 2));
+    ASSERT_EQ(chunks.size(), 3u);
+    EXPECT_EQ(chunks.at(Dxyz()).at(Dxyz(2, 0, 0, 0)), -1);
+    EXPECT_EQ(chunks.at(Dxyz()).at(Dxyz(1, 0, 0, 0)), 5);
+    EXPECT_EQ(chunks.at(Dxyz(2, 1, 1, 1)).at(Dxyz(2, 1, 1, 1)), 1);
+}
+
+TEST(hierarchy, determineStep)
+{
+    Hierarchy h;
+    EXPECT_EQ(hierarchy::determineStep(h), 0u);
+
+    // A full tree of depth 5 only fits within the per-file limit when it is
+    // split at depth 4, in which case the root file links 4096 others.
+    for (uint64_t d(1); d <= 5; ++d)
+    {
+        const uint64_t span(1ull << d);
+        for (uint64_t x(0); x < span; ++x)
+        {
+            for (uint64_t y(0); y < span; ++y)
+            {
+                for (uint64_t z(0); z < span; ++z) h.set(Dxyz(d, x, y, z), 1);
+            }
+        }
+    }
+
+    const unsigned step(hierarchy::determineStep(h));
+    EXPECT_EQ(step, 4u);
+
+    const auto chunks(hierarchy::getChunks(h, step));
+    EXPECT_EQ(chunks.size(), 4097u);
+    EXPECT_EQ(chunks.at(Dxyz()).size(), 585u + 4096u);
+    EXPECT_EQ(chunks.at(Dxyz(4, 3, 2, 1)).size(), 9u);
+}
+
+TEST(hierarchy, spill)
+{
+    const uint64_t depth(4);
+    const uint64_t span(1ull << depth);
+
+    {
+        Hierarchy h(spill);
+        for (uint64_t x(0); x < span; ++x)
+        {
+            for (uint64_t y(0); y < span; ++y)
+            {
+                for (uint64_t z(0); z < span; ++z)
+                {
+                    h.set(Dxyz(depth, x, y, z), x + y + z + 1);
+                }
+            }
+        }
+
+        // Overwrite some spilled nodes.
+        for (uint64_t x(0); x < span; ++x) h.set(Dxyz(depth, x, 0, 0), -5);
+
+        EXPECT_GT(countRuns(), 0u);
+        ASSERT_EQ(h.size(), span * span * span + 1);
+
+        uint64_t visited(0);
+        Dxyz last;
+        h.forEach([&](const Dxyz& key, int64_t val)
+        {
+            if (visited++) { EXPECT_TRUE(last < key); }
+            last = key;
+
+            const int64_t expected(key.x + key.y + key.z + 1);
+            if (!key.d) EXPECT_EQ(val, 0);
+            else if (!key.y && !key.z) EXPECT_EQ(val, -5);
+            else EXPECT_EQ(val, expected);
+        });
+        EXPECT_EQ(visited, h.size());
+
+        EXPECT_EQ(h.get(Dxyz(depth, 3, 0, 0)), -5);
+        EXPECT_EQ(h.get(Dxyz(depth, 3, 2, 1)), 7);
+        EXPECT_FALSE(h.contains(Dxyz(depth + 1, 0, 0, 0)));
+
+        // Copies share run files, and outlive the original.
+        Hierarchy copy(h);
+        h.clear();
+        EXPECT_EQ(copy.get(Dxyz(depth, 3, 2, 1)), 7);
+        EXPECT_EQ(copy.size(), span * span * span + 1);
+        EXPECT_EQ(copy.nodes().size(), copy.size());
+    }
+
+    // Run files are removed once no hierarchy refers to them.
+    EXPECT_EQ(countRuns(), 0u);
+}
+
+TEST(hierarchy, spillConcurrent)
+{
+    Hierarchy h(spill);
+    const uint64_t depth(5);
+    const uint64_t span(1ull << depth);
+
+    std::vector<std::thread> threads;
+    for (uint64_t t(0); t < 8; ++t)
+    {
+        threads.emplace_back([&h, t, span, depth]()
+        {
+            for (uint64_t x(t); x < span; x += 8)
+            {
+                for (uint64_t y(0); y < span; ++y)
+                {
+                    for (uint64_t z(0); z < span; ++z)
+                    {
+                        h.set(Dxyz(depth, x, y, z), x + y + z + 1);
+                        EXPECT_EQ(
+                            h.get(Dxyz(depth, x, y, z)),
+                            static_cast<int64_t>(x + y + z + 1));
+                    }
+                }
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    ASSERT_EQ(h.size(), span * span * span + 1);
+    for (uint64_t x(0); x < span; ++x)
+    {
+        for (uint64_t y(0); y < span; ++y)
+        {
+            for (uint64_t z(0); z < span; ++z)
+            {
+                ASSERT_EQ(
+                    h.get(Dxyz(depth, x, y, z)),
+                    static_cast<int64_t>(x + y + z + 1));
+            }
+        }
+    }
+}
+
+TEST(hierarchy, saveLoad)
+{
+    const std::string out(
+        arbiter::join(arbiter::getTempPath(), "entwine-hierarchy-out/"));
+    arbiter::mkdirp(out);
+    arbiter::Arbiter a;
+    const arbiter::Endpoint ep(a.getEndpoint(out));
+
+    Hierarchy h(spill);
+    h.set(Dxyz(), 10);
+    for (uint64_t d(1); d < 6; ++d)
+    {
+        const uint64_t span(1ull << d);
+        for (uint64_t x(0); x < span; ++x) h.set(Dxyz(d, x, x, 0), d);
+    }
+
+    hierarchy::save(h, ep, 2, 4);
+    EXPECT_TRUE(ep.tryGetSize("0-0-0-0.json"));
+    EXPECT_TRUE(ep.tryGetSize("2-3-3-0.json"));
+    EXPECT_TRUE(ep.tryGetSize("4-15-15-0.json"));
+
+    const Hierarchy loaded(hierarchy::load(ep, 4, "", nullptr, spill));
+    EXPECT_EQ(loaded.nodes(), h.nodes());
+
+    // Malformed keys and values fail the whole load.
+    ep.put("0-0-0-0-1.json", R"({ "0-0-0-0": 1, "1-0-0": 2 })");
+    EXPECT_ANY_THROW(hierarchy::load(ep, 4, "-1"));
+    ep.put("0-0-0-0-2.json", R"({ "0-0-0-0": 1, "1-0-0-0": -1 })");
+    EXPECT_ANY_THROW(hierarchy::load(ep, 4, "-2"));
+    ep.put("0-0-0-0-3.json", R"({ "0-0-0-0": "1" })");
+    EXPECT_ANY_THROW(hierarchy::load(ep, 4, "-3"));
+}
+
+TEST(hierarchy, incremental)
+{
+    const std::string out(
+        arbiter::join(arbiter::getTempPath(), "entwine-hierarchy-partial/"));
+    arbiter::mkdirp(out);
+    arbiter::Arbiter a;
+    const arbiter::Endpoint ep(a.getEndpoint(out));
+
+    Hierarchy h;
+    for (uint64_t d(1); d < 5; ++d) h.set(Dxyz(d, 0, 0, 0), d);
+    hierarchy::save(h, ep, 2, 4);
+
+    unsigned step(0);
+    Hierarchy loaded(
+        hierarchy::load(ep, 4, "", nullptr, Hierarchy::Spill(), &step));
+    EXPECT_EQ(step, 2u);
+
+    // Only nodes set with new values after tracking begins are recorded.
+    loaded.set(Dxyz(3, 0, 0, 0), 5);
+    EXPECT_TRUE(loaded.changed().empty());
+    loaded.track();
+    loaded.set(Dxyz(3, 0, 0, 0), 3);
+    loaded.set(Dxyz(3, 0, 0, 0), 30);
+    loaded.set(Dxyz(2, 1, 1, 1), 7);
+    loaded.set(Dxyz(2, 1, 1, 1), 7);
+
+    const std::vector<Dxyz> changed(loaded.changed());
+    ASSERT_EQ(changed.size(), 2u);
+    EXPECT_EQ(changed[0], Dxyz(2, 1, 1, 1));
+    EXPECT_EQ(changed[1], Dxyz(3, 0, 0, 0));
+
+    // A new file root is also linked from the file above it.
+    const std::vector<Dxyz> roots(hierarchy::getFileRoots(changed, 2));
+    ASSERT_EQ(roots.size(), 3u);
+    EXPECT_EQ(roots[0], Dxyz());
+    EXPECT_EQ(roots[1], Dxyz(2, 0, 0, 0));
+    EXPECT_EQ(roots[2], Dxyz(2, 1, 1, 1));
+    EXPECT_EQ(
+        hierarchy::getFileRoots(changed, 0),
+        std::vector<Dxyz>({ Dxyz() }));
+
+    // The untouched file is not rewritten.
+    ep.put("4-0-0-0.json", R"({ "4-0-0-0": 4 })");
+    hierarchy::save(loaded, ep, 2, roots, 4);
+    EXPECT_EQ(ep.get("4-0-0-0.json"), R"({ "4-0-0-0": 4 })");
+
+    const Hierarchy reloaded(hierarchy::load(ep, 4));
+    EXPECT_EQ(reloaded.nodes(), loaded.nodes());
+
+    loaded.track();
+    EXPECT_TRUE(loaded.changed().empty());
+}
+
+TEST(hierarchy, binary)
+{
+    const std::string out(
+        arbiter::join(arbiter::getTempPath(), "entwine-hierarchy-binary/"));
+    arbiter::mkdirp(out);
+    arbiter::Arbiter a;
+    const arbiter::Endpoint ep(a.getEndpoint(out));
+
+    Hierarchy h;
+    for (uint64_t d(1); d < 8; ++d)
+    {
+        const uint64_t span(1ull << d);
+        for (uint64_t x(0); x < span; ++x) h.set(Dxyz(d, x, 0, x / 2), x + 1);
+    }
+
+    hierarchy::saveBinary(h, ep, 3, "-2");
+    ASSERT_EQ(
+        ep.getSize(hierarchy::getBinaryFilename("-2")),
+        16 + 8 + h.size() * 24);
+
+    optional<unsigned> step;
+    const Hierarchy loaded(
+        hierarchy::loadBinary(ep, 4, "-2", nullptr, Hierarchy::Spill(), &step));
+    EXPECT_EQ(loaded.nodes(), h.nodes());
+    ASSERT_TRUE(step);
+    EXPECT_EQ(*step, 3u);
+
+    // Version 1 files, without a step, are still read.
+    std::string v1(ep.get(hierarchy::getBinaryFilename("-2")));
+    v1.erase(16, 8);
+    v1[4] = 1;
+    ep.put(hierarchy::getBinaryFilename("-4"), v1);
+    EXPECT_EQ(
+        hierarchy::loadBinary(ep, 4, "-4", nullptr, Hierarchy::Spill(), &step)
+            .nodes(),
+        h.nodes());
+    EXPECT_FALSE(step);
+
+    const Hierarchy spilled(hierarchy::loadBinary(ep, 4, "-2", nullptr, spill));
+    EXPECT_EQ(spilled.nodes(), h.nodes());
+
+    ep.put(hierarchy::getBinaryFilename("-3"), "EHIB");
+    EXPECT_ANY_THROW(hierarchy::loadBinary(ep, 4, "-3"));
+}
+
+TEST(hierarchy, stats)
+{
+    const std::string out(
+        arbiter::join(arbiter::getTempPath(), "entwine-hierarchy-stats/"));
+    arbiter::mkdirp(out);
+    arbiter::Arbiter a;
+    const arbiter::Endpoint ep(a.getEndpoint(out));
+
+    Hierarchy h;
+    NodeStatsMap stats;
+    for (uint64_t d(0); d < 5; ++d)
+    {
+        const Dxyz key(d, 0, 0, 0);
+        h.set(key, d + 1);
+
+        NodeStats s;
+        s.bounds.grow(Point(-1.5 * d, 0, 2));
+        s.bounds.grow(Point(3, 4.25, 5 + d));
+        s.gpsTime.grow(1000.5 + d);
+        s.gpsTime.grow(2000);
+        if (d) s.intensity.grow(d);
+        s.addClassification(2);
+        s.addClassification(200 + d);
+        stats.set(key, s);
+    }
+
+    hierarchy::saveStats(h, stats, ep, 2, 4);
+    EXPECT_TRUE(ep.tryGetSize(hierarchy::getStatsFilename(Dxyz())));
+    EXPECT_TRUE(ep.tryGetSize(hierarchy::getStatsFilename(Dxyz(2, 0, 0, 0))));
+    EXPECT_TRUE(ep.tryGetSize(hierarchy::getStatsFilename(Dxyz(4, 0, 0, 0))));
+
+    NodeStatsMap loaded;
+    hierarchy::loadStats(loaded, ep, 4);
+    ASSERT_EQ(loaded.size(), 5u);
+    EXPECT_TRUE(loaded.changed().empty());
+
+    for (uint64_t d(0); d < 5; ++d)
+    {
+        NodeStats expected, actual;
+        ASSERT_TRUE(stats.find(Dxyz(d, 0, 0, 0), expected));
+        ASSERT_TRUE(loaded.find(Dxyz(d, 0, 0, 0), actual));
+        EXPECT_EQ(actual.bounds, expected.bounds);
+        EXPECT_EQ(actual.gpsTime.min, expected.gpsTime.min);
+        EXPECT_EQ(actual.gpsTime.max, expected.gpsTime.max);
+        EXPECT_EQ(actual.intensity.empty(), !d);
+        EXPECT_EQ(actual.classification, expected.classification);
+        EXPECT_TRUE(actual.hasClassification(2));
+        EXPECT_TRUE(actual.hasClassification(200 + d));
+        EXPECT_FALSE(actual.hasClassification(3));
+    }
+
+    ep.put(hierarchy::getStatsFilename(Dxyz(), "-1"),
+        R"({ "0-0-0-0": { "bounds": [0, 0, 0, 1, 1, 1],
+            "Classification": "12g" } })");
+    NodeStatsMap bad;
+    EXPECT_ANY_THROW(hierarchy::loadStats(bad, ep, 4, "-1"));
+}
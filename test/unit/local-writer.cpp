@@ -0,0 +1,124 @@
+#include "gtest/gtest.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/types/exceptions.hpp>
+#include <entwine/util/local-writer.hpp>
+
+using namespace entwine;
+
+namespace
+{
+    const std::string dir(
+        arbiter::join(arbiter::getTempPath(), "entwine-local-writer-test"));
+
+    std::string pathFor(int i)
+    {
+        return arbiter::join(dir, std::to_string(i) + ".bin");
+    }
+}
+
+TEST(localWriter, writes)
+{
+    arbiter::mkdirp(dir);
+
+    const int threads(4);
+    const int perThread(100);
+
+    {
+        LocalWriter writer(8);
+
+        std::vector<std::thread> workers;
+        for (int t(0); t < threads; ++t)
+        {
+            workers.emplace_back([&writer, t]()
+            {
+                for (int i(t * perThread); i < (t + 1) * perThread; ++i)
+                {
+                    writer.put(pathFor(i), std::string(i, 'a' + i % 26));
+                }
+            });
+        }
+        for (auto& w : workers) w.join();
+
+        writer.wait(pathFor(42));
+        EXPECT_EQ(arbiter::Arbiter().get(pathFor(42)), std::string(42, 'q'));
+
+        writer.wait();
+    }
+
+    arbiter::Arbiter a;
+    for (int i(0); i < threads * perThread; ++i)
+    {
+        ASSERT_EQ(a.get(pathFor(i)), std::string(i, 'a' + i % 26));
+        arbiter::remove(pathFor(i));
+    }
+}
+
+TEST(localWriter, overwrite)
+{
+    arbiter::mkdirp(dir);
+
+    LocalWriter writer;
+    writer.put(pathFor(0), std::string(1000, 'a'));
+    writer.put(pathFor(0), std::string(10, 'b'));
+    writer.wait();
+
+    EXPECT_EQ(arbiter::Arbiter().get(pathFor(0)), std::string(10, 'b'));
+    arbiter::remove(pathFor(0));
+}
+
+TEST(localWriter, concurrentOverwrite)
+{
+    arbiter::mkdirp(dir);
+
+    // Overwrites of one path from several threads must each wait for the
+    // previous write, while writes of other paths proceed.
+    const int threads(4);
+    {
+        LocalWriter writer(2);
+
+        std::vector<std::thread> workers;
+        for (int t(0); t < threads; ++t)
+        {
+            workers.emplace_back([&writer, t]()
+            {
+                for (int i(0); i < 50; ++i)
+                {
+                    writer.put(pathFor(0), std::string(4096, 'a' + t));
+                    writer.put(pathFor(t + 1), std::string(i + 1, 'a' + t));
+                }
+            });
+        }
+        for (auto& w : workers) w.join();
+        writer.wait();
+    }
+
+    arbiter::Arbiter a;
+    const std::string last(a.get(pathFor(0)));
+    ASSERT_EQ(last.size(), 4096u);
+    EXPECT_EQ(last, std::string(4096, last.front()));
+    arbiter::remove(pathFor(0));
+
+    for (int t(0); t < threads; ++t)
+    {
+        EXPECT_EQ(a.get(pathFor(t + 1)), std::string(50, 'a' + t));
+        arbiter::remove(pathFor(t + 1));
+    }
+}
+
+TEST(localWriter, failure)
+{
+    const std::string bad(arbiter::join(dir, "missing", "dir", "0.bin"));
+
+    LocalWriter writer;
+    writer.put(bad, std::string("data"));
+    EXPECT_THROW(writer.wait(bad), FatalError);
+    EXPECT_THROW(writer.wait(), FatalError);
+
+    // Errors are reported once.
+    EXPECT_NO_THROW(writer.wait());
+}
@@ -0,0 +1,173 @@
+#include "gtest/gtest.h"
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/types/source.hpp>
+
+using namespace entwine;
+
+namespace
+{
+    const std::string out(
+        arbiter::join(arbiter::getTempPath(), "entwine-manifest-test/"));
+
+    // Enough sources to span several details shards.
+    Manifest makeManifest()
+    {
+        Manifest manifest;
+        const uint64_t size(manifest::detailsShardSize * 2 + 10);
+        for (uint64_t i(0); i < size; ++i)
+        {
+            Source source("s3://bucket/dir/" + std::to_string(i) + ".laz");
+            SourceInfo& info(source.info);
+            info.points = i % 7 ? i * 10 : 0;
+            info.bounds = Bounds(i, 0, 0, i + 1.5, 2, 3);
+            if (i % 100 == 3) info.errors = { "Error " + std::to_string(i) };
+            if (i % 50 == 1) info.warnings = { "Warning", "Another" };
+            info.pipeline = json::parse(R"([{ "type": "readers.las" }])");
+            info.metadata = { { "index", i } };
+
+            DimensionStats stats;
+            stats.minimum = i;
+            stats.maximum = i * 2;
+            stats.count = info.points;
+            info.schema = {
+                Dimension("X", Type::Double, stats),
+                Dimension("Y", Type::Double)
+            };
+            if (i % 3) info.schema.back().stats = stats;
+
+            manifest.emplace_back(source, i % 2, std::to_string(i) + ".json");
+        }
+        return manifest;
+    }
+
+    std::set<uint64_t> all(const Manifest& manifest)
+    {
+        std::set<uint64_t> origins;
+        for (uint64_t i(0); i < manifest.size(); ++i) origins.insert(i);
+        return origins;
+    }
+
+    void checkColumns(const Manifest& a, const Manifest& b)
+    {
+        ASSERT_EQ(a.size(), b.size());
+        for (uint64_t i(0); i < a.size(); ++i)
+        {
+            EXPECT_EQ(a[i].source.path, b[i].source.path);
+            EXPECT_EQ(a[i].metadataPath, b[i].metadataPath);
+            EXPECT_EQ(a[i].inserted, b[i].inserted);
+            EXPECT_EQ(hasStats(a[i]), hasStats(b[i]));
+            EXPECT_EQ(a[i].source.info.points, b[i].source.info.points);
+            EXPECT_EQ(a[i].source.info.bounds, b[i].source.info.bounds);
+            EXPECT_EQ(a[i].source.info.errors, b[i].source.info.errors);
+            EXPECT_EQ(a[i].source.info.warnings, b[i].source.info.warnings);
+        }
+    }
+
+    void checkDetails(const BuildItem& a, const BuildItem& b)
+    {
+        EXPECT_TRUE(b.detailed);
+        EXPECT_EQ(json(a.source), json(b.source));
+    }
+}
+
+TEST(manifest, binary)
+{
+    arbiter::mkdirp(out);
+    arbiter::Arbiter a;
+    const arbiter::Endpoint ep(a.getEndpoint(out));
+
+    Manifest manifest(makeManifest());
+    manifest::saveBinary(manifest, ep, all(manifest), 4, "-1");
+    EXPECT_TRUE(ep.tryGetSize(manifest::getDetailsFilename(0, "-1")));
+    EXPECT_TRUE(ep.tryGetSize(manifest::getDetailsFilename(2, "-1")));
+    EXPECT_FALSE(ep.tryGetSize(manifest::getDetailsFilename(3, "-1")));
+
+    // Only the columns are loaded at first.
+    Manifest loaded(manifest::loadBinary(ep, 4, "-1"));
+    checkColumns(manifest, loaded);
+    for (const auto& item : loaded)
+    {
+        EXPECT_FALSE(item.detailed);
+        EXPECT_TRUE(item.source.info.schema.empty());
+        EXPECT_TRUE(item.source.info.pipeline.is_null());
+    }
+
+    // Details are fetched for the requested origins, a shard at a time.
+    const uint64_t last(manifest.size() - 1);
+    manifest::loadDetails(loaded, ep, { 5, last }, 4, "-1");
+    for (uint64_t i(0); i < loaded.size(); ++i)
+    {
+        const bool shard0(i < manifest::detailsShardSize);
+        const bool shard2(i >= manifest::detailsShardSize * 2);
+        EXPECT_EQ(loaded[i].detailed, shard0 || shard2);
+        if (loaded[i].detailed) checkDetails(manifest[i], loaded[i]);
+    }
+
+    manifest::loadDetails(loaded, ep, 4, "-1");
+    for (uint64_t i(0); i < loaded.size(); ++i)
+    {
+        checkDetails(manifest[i], loaded[i]);
+    }
+}
+
+TEST(manifest, binaryPartial)
+{
+    arbiter::mkdirp(out);
+    arbiter::Arbiter a;
+    const arbiter::Endpoint ep(a.getEndpoint(out));
+
+    Manifest manifest(makeManifest());
+    manifest::saveBinary(manifest, ep, all(manifest), 4, "-2");
+
+    // Rewriting a shard first fills in the details of the rest of its sources,
+    // while other shards are left alone.
+    Manifest loaded(manifest::loadBinary(ep, 4, "-2"));
+    const uint64_t origin(manifest::detailsShardSize + 3);
+    loaded[origin].inserted = true;
+    loaded[origin].source.info.warnings.push_back("Changed");
+
+    const std::string untouched(ep.get(manifest::getDetailsFilename(0, "-2")));
+    ep.put(manifest::getDetailsFilename(0, "-2"), "[]");
+    manifest::saveBinary(loaded, ep, { origin }, 4, "-2");
+    EXPECT_EQ(ep.get(manifest::getDetailsFilename(0, "-2")), "[]");
+    ep.put(manifest::getDetailsFilename(0, "-2"), untouched);
+
+    manifest[origin].inserted = true;
+    manifest[origin].source.info.warnings.push_back("Changed");
+
+    Manifest reloaded(manifest::loadBinary(ep, 4, "-2"));
+    checkColumns(manifest, reloaded);
+    manifest::loadDetails(reloaded, ep, 4, "-2");
+    for (uint64_t i(0); i < reloaded.size(); ++i)
+    {
+        checkDetails(manifest[i], reloaded[i]);
+    }
+
+    ep.put(manifest::getBinaryFilename("-3"), "EMNB");
+    EXPECT_ANY_THROW(manifest::loadBinary(ep, 4, "-3"));
+
+    std::string truncated(ep.get(manifest::getBinaryFilename("-2")));
+    truncated.pop_back();
+    ep.put(manifest::getBinaryFilename("-4"), truncated);
+    EXPECT_ANY_THROW(manifest::loadBinary(ep, 4, "-4"));
+}
+
+TEST(manifest, overviewWithoutMetadataPaths)
+{
+    Manifest manifest(makeManifest());
+    manifest.erase(manifest.begin() + 2, manifest.end());
+    manifest[1].metadataPath.clear();
+
+    const json overview(toOverview(manifest));
+    EXPECT_EQ(overview.at(0).at("metadataPath").get<std::string>(), "0.json");
+    EXPECT_FALSE(overview.at(1).count("metadataPath"));
+    EXPECT_EQ(
+        overview.at(1).at("path").get<std::string>(),
+        "s3://bucket/dir/1.laz");
+    EXPECT_EQ(overview.at(1).at("points").get<uint64_t>(), 10u);
+}
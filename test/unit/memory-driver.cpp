@@ -0,0 +1,131 @@
+#include "gtest/gtest.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/util/memory-driver.hpp>
+#include <entwine/util/ranged-stream.hpp>
+
+using namespace entwine;
+
+namespace
+{
+
+std::unique_ptr<arbiter::Arbiter> makeArbiter()
+{
+    std::unique_ptr<arbiter::Arbiter> a(new arbiter::Arbiter());
+    a->addDriver("mem", MemoryDriver::shared());
+    return a;
+}
+
+} // unnamed namespace
+
+TEST(memory, basics)
+{
+    auto mem(MemoryDriver::shared());
+    mem->clear();
+    mem->resetStats();
+
+    auto a(makeArbiter());
+    EXPECT_TRUE(a->isRemote("mem://a/b.json"));
+
+    a->put("mem://a/b.json", std::string("hello"));
+    EXPECT_EQ(a->get("mem://a/b.json"), "hello");
+    EXPECT_FALSE(a->tryGet("mem://a/missing.json"));
+    EXPECT_EQ(*a->tryGetSize("mem://a/b.json"), 5u);
+
+    // Other arbiters see the same objects.
+    EXPECT_EQ(makeArbiter()->get("mem://a/b.json"), "hello");
+
+    // Endpoints work as they would for any other remote driver.
+    const arbiter::Endpoint ep(a->getEndpoint("mem://a"));
+    ep.put("c/d.bin", std::vector<char>(10, 'x'));
+    EXPECT_EQ(ep.getBinary("c/d.bin"), std::vector<char>(10, 'x'));
+
+    const auto range(mem->getRange("a/c/d.bin", 2, 5));
+    EXPECT_EQ(range, std::vector<char>(3, 'x'));
+    EXPECT_ANY_THROW(mem->getRange("a/c/d.bin", 2, 11));
+
+    EXPECT_EQ(mem->count(), 2u);
+    EXPECT_EQ(mem->bytes(), 15u);
+
+    const auto stats(mem->stats());
+    EXPECT_EQ(stats.puts, 2u);
+    EXPECT_EQ(stats.ranges, 2u);
+    EXPECT_EQ(stats.bytesWritten, 15u);
+    EXPECT_EQ(stats.bytesRead, 5u + 5u + 10u + 3u);
+
+    EXPECT_TRUE(mem->remove("a/b.json"));
+    EXPECT_FALSE(a->tryGet("mem://a/b.json"));
+    mem->clear();
+    EXPECT_EQ(mem->count(), 0u);
+}
+
+TEST(memory, glob)
+{
+    auto mem(MemoryDriver::shared());
+    mem->clear();
+
+    auto a(makeArbiter());
+    a->put("mem://g/1.laz", std::string("1"));
+    a->put("mem://g/2.laz", std::string("2"));
+    a->put("mem://g/sub/3.laz", std::string("3"));
+    a->put("mem://other/4.laz", std::string("4"));
+
+    const std::vector<std::string> flat { "mem://g/1.laz", "mem://g/2.laz" };
+    EXPECT_EQ(a->resolve("mem://g/*"), flat);
+
+    const std::vector<std::string> deep {
+        "mem://g/1.laz", "mem://g/2.laz", "mem://g/sub/3.laz"
+    };
+    EXPECT_EQ(a->resolve("mem://g/**"), deep);
+
+    mem->clear();
+}
+
+TEST(memory, concurrent)
+{
+    auto mem(MemoryDriver::shared());
+    mem->clear();
+    auto a(makeArbiter());
+
+    std::vector<std::thread> threads;
+    for (int t(0); t < 8; ++t)
+    {
+        threads.emplace_back([&a, t]()
+        {
+            for (int i(0); i < 200; ++i)
+            {
+                const std::string path(
+                    "mem://c/" + std::to_string(t) + "-" + std::to_string(i));
+                a->put(path, std::to_string(i));
+                ASSERT_EQ(a->get(path), std::to_string(i));
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    EXPECT_EQ(mem->count(), 1600u);
+    mem->clear();
+}
+
+TEST(memory, ranged)
+{
+    auto mem(MemoryDriver::shared());
+    mem->clear();
+    auto a(makeArbiter());
+
+    std::vector<char> data(10000);
+    for (std::size_t i(0); i < data.size(); ++i) data[i] = char(i);
+    a->put("mem://r/file.laz", data);
+
+    RangedStream stream(*a, "mem://r/file.laz", 1000, 2);
+    std::vector<char> result(data.size());
+    ASSERT_TRUE(stream.read(result.data(), result.size()));
+    EXPECT_EQ(result, data);
+    EXPECT_GE(mem->stats().ranges, 10u);
+
+    mem->clear();
+}
@@ -0,0 +1,37 @@
+#include "gtest/gtest.h"
+
+#include <string>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/util/mmap.hpp>
+
+using namespace entwine;
+
+TEST(mmap, contents)
+{
+    const std::string path(
+        arbiter::join(arbiter::getTempPath(), "entwine-mmap-test.bin"));
+    const std::string data("0123456789abcdef");
+
+    arbiter::Arbiter a;
+    a.put(path, data);
+
+    {
+        const MappedFile file(path);
+        ASSERT_EQ(file.size(), data.size());
+        EXPECT_EQ(std::string(file.data(), file.size()), data);
+    }
+
+    a.put(path, std::string());
+    {
+        const MappedFile file(path);
+        EXPECT_EQ(file.size(), 0u);
+    }
+
+    arbiter::remove(path);
+}
+
+TEST(mmap, missing)
+{
+    EXPECT_ANY_THROW(MappedFile("/this/path/does/not/exist.bin"));
+}
@@ -0,0 +1,160 @@
+#include "gtest/gtest.h"
+#include "config.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <pdal/PipelineManager.hpp>
+
+#include <entwine/builder/native-reader.hpp>
+#include <entwine/types/dimension.hpp>
+#include <entwine/types/vector-point-table.hpp>
+#include <entwine/util/info.hpp>
+#include <entwine/util/memory-driver.hpp>
+#include <entwine/util/pipeline.hpp>
+#include <entwine/util/ranged-stream.hpp>
+#include <entwine/util/unique.hpp>
+
+using namespace entwine;
+
+namespace
+{
+
+const std::string path(test::dataPath() + "ellipsoid.laz");
+
+bool has(const StringList& list, const std::string name)
+{
+    return std::find(list.begin(), list.end(), name) != list.end();
+}
+
+void collect(VectorPointTable& table, std::vector<char>& result)
+{
+    const uint64_t pointSize(table.layout()->pointSize());
+    table.setProcess([&table, &result, pointSize]()
+    {
+        result.insert(
+            result.end(),
+            table.data().begin(),
+            table.data().begin() + table.numPoints() * pointSize);
+    });
+}
+
+} // unnamed namespace
+
+TEST(native, dimensions)
+{
+    EXPECT_TRUE(getNativeDimensions(4).empty());
+    EXPECT_TRUE(getNativeDimensions(9).empty());
+
+    const auto zero(getNativeDimensions(0));
+    EXPECT_TRUE(has(zero, "Classification"));
+    EXPECT_FALSE(has(zero, "GpsTime"));
+    EXPECT_FALSE(has(zero, "Red"));
+
+    const auto three(getNativeDimensions(3));
+    EXPECT_TRUE(has(three, "GpsTime"));
+    EXPECT_TRUE(has(three, "Red"));
+    EXPECT_FALSE(has(three, "ScanChannel"));
+
+    const auto eight(getNativeDimensions(8));
+    EXPECT_TRUE(has(eight, "ScanChannel"));
+    EXPECT_TRUE(has(eight, "Infrared"));
+}
+
+TEST(native, nonTrivial)
+{
+    SourceInfo info(analyzeOne(path, false, json::array({ json::object() })));
+    info.pipeline.push_back({
+        { "type", "filters.reprojection" },
+        { "out_srs", "EPSG:4326" }
+    });
+    EXPECT_FALSE(NativeReader::create(info, path, path));
+
+    info.pipeline = json::array({
+        { { "filename", path }, { "spatialreference", "EPSG:3857" } }
+    });
+    EXPECT_FALSE(NativeReader::create(info, path, path));
+}
+
+#ifdef ENTWINE_HAVE_LASZIP
+TEST(native, matchesPdal)
+{
+    const SourceInfo info(
+        analyzeOne(path, false, json::array({ json::object() })));
+    auto reader(NativeReader::create(info, path, path));
+    ASSERT_TRUE(reader);
+
+    auto layout(toLayout(makeAbsolute(info.schema), false));
+
+    std::vector<char> native;
+    VectorPointTable nativeTable(layout);
+    collect(nativeTable, native);
+    reader->read(nativeTable, info.bounds);
+
+    std::vector<char> expected;
+    VectorPointTable pdalTable(layout);
+    collect(pdalTable, expected);
+
+    pdal::PipelineManager pm;
+    std::istringstream iss(info.pipeline.dump());
+    pm.readPipeline(iss);
+    pdal::Stage& last = getStage(pm);
+    last.prepare(pdalTable);
+    last.execute(pdalTable);
+
+    ASSERT_EQ(native.size(), info.points * layout.pointSize());
+    EXPECT_EQ(native, expected);
+
+    const auto& stats(reader->stats());
+    const DimensionStats& x(stats.at("X"));
+    EXPECT_EQ(x.count, info.points);
+    EXPECT_GE(x.minimum, info.bounds.min().x);
+    EXPECT_LE(x.maximum, info.bounds.max().x);
+
+    uint64_t classified(0);
+    for (const auto& v : stats.at("Classification").values)
+    {
+        classified += v.second;
+    }
+    EXPECT_EQ(classified, info.points);
+}
+
+TEST(native, streamed)
+{
+    const SourceInfo info(
+        analyzeOne(path, false, json::array({ json::object() })));
+    auto layout(toLayout(makeAbsolute(info.schema), false));
+
+    std::vector<char> expected;
+    VectorPointTable localTable(layout);
+    collect(localTable, expected);
+    NativeReader::create(info, path, path)->read(localTable);
+
+    auto mem(MemoryDriver::shared());
+    mem->clear();
+    arbiter::Arbiter a;
+    a.addDriver("mem", mem);
+
+    const std::string remote("mem://native/ellipsoid.laz");
+    a.put(remote, a.getBinary(path));
+    ASSERT_TRUE(RangedStream::supports(a, remote));
+
+    // Small blocks, so that the read crosses many of them.
+    auto reader(NativeReader::create(
+        info,
+        remote,
+        makeUnique<RangedStream>(a, remote, 4096, 4)));
+    ASSERT_TRUE(reader);
+
+    std::vector<char> streamed;
+    VectorPointTable streamedTable(layout);
+    collect(streamedTable, streamed);
+    reader->read(streamedTable);
+
+    EXPECT_EQ(streamed, expected);
+    EXPECT_GT(mem->stats().ranges, 1u);
+    mem->clear();
+}
+#endif
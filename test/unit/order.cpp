@@ -0,0 +1,123 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <entwine/io/order.hpp>
+
+using namespace entwine;
+
+TEST(order, strings)
+{
+    using io::Order;
+    for (const auto o : {
+        Order::None, Order::GpsTime, Order::Morton, Order::Hilbert })
+    {
+        EXPECT_EQ(io::toOrder(io::toString(o)), o);
+    }
+    EXPECT_ANY_THROW(io::toOrder("asdf"));
+}
+
+TEST(order, sortable)
+{
+    const std::vector<double> values {
+        std::numeric_limits<double>::lowest(),
+        -1e9, -1.5, -0.0001, 0.0, 0.0001, 1.5, 1e9,
+        std::numeric_limits<double>::max()
+    };
+
+    for (std::size_t i(1); i < values.size(); ++i)
+    {
+        EXPECT_LT(
+            io::order::toSortable(values[i - 1]),
+            io::order::toSortable(values[i]));
+    }
+}
+
+TEST(order, morton)
+{
+    EXPECT_EQ(io::order::toMorton(0, 0, 0), 0u);
+    EXPECT_EQ(io::order::toMorton(1, 0, 0), 1u);
+    EXPECT_EQ(io::order::toMorton(0, 1, 0), 2u);
+    EXPECT_EQ(io::order::toMorton(0, 0, 1), 4u);
+    EXPECT_EQ(io::order::toMorton(1, 1, 1), 7u);
+    EXPECT_EQ(io::order::toMorton(2, 0, 0), 8u);
+    EXPECT_EQ(
+        io::order::toMorton(0x1fffff, 0x1fffff, 0x1fffff),
+        (uint64_t(1) << 63) - 1);
+}
+
+TEST(order, hilbert)
+{
+    // Every cell of the cube should be visited exactly once, and each step
+    // along the curve should move to a face-adjacent cell.
+    const unsigned bits(3);
+    const uint64_t span(1 << bits);
+    const uint64_t cells(span * span * span);
+
+    struct Cell { int64_t x = -1, y = -1, z = -1; };
+    std::vector<Cell> curve(cells);
+
+    for (uint64_t z(0); z < span; ++z)
+    for (uint64_t y(0); y < span; ++y)
+    for (uint64_t x(0); x < span; ++x)
+    {
+        const uint64_t h(io::order::toHilbert(x, y, z, bits));
+        ASSERT_LT(h, cells);
+        ASSERT_EQ(curve[h].x, -1);
+        curve[h] = { int64_t(x), int64_t(y), int64_t(z) };
+    }
+
+    for (uint64_t i(1); i < cells; ++i)
+    {
+        const Cell& a(curve[i - 1]);
+        const Cell& b(curve[i]);
+        EXPECT_EQ(
+            std::abs(a.x - b.x) + std::abs(a.y - b.y) + std::abs(a.z - b.z),
+            1);
+    }
+
+    EXPECT_ANY_THROW(io::order::toHilbert(0, 0, 0, 22));
+}
+
+TEST(order, radix)
+{
+    std::mt19937_64 gen(42);
+    std::uniform_real_distribution<double> dist(-1e6, 1e6);
+
+    const std::size_t n(10000);
+    std::vector<double> values(n);
+    std::vector<char> storage(n);
+    std::vector<uint64_t> keys(n);
+    std::vector<char*> refs(n);
+
+    for (std::size_t i(0); i < n; ++i)
+    {
+        // Include some duplicates to exercise stability.
+        values[i] = i % 10 ? dist(gen) : 0;
+        keys[i] = io::order::toSortable(values[i]);
+        refs[i] = storage.data() + i;
+    }
+
+    io::order::sort(keys, refs);
+
+    ASSERT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+    for (std::size_t i(1); i < n; ++i)
+    {
+        const std::size_t a(refs[i - 1] - storage.data());
+        const std::size_t b(refs[i] - storage.data());
+        ASSERT_LE(values[a], values[b]);
+        if (values[a] == values[b]) ASSERT_LT(a, b);
+    }
+}
+
+TEST(order, mismatch)
+{
+    std::vector<uint64_t> keys(2);
+    std::vector<char*> refs(3);
+    EXPECT_ANY_THROW(io::order::sort(keys, refs));
+}
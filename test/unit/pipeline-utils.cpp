@@ -46,3 +46,42 @@ TEST(pipeline, omitStage)
         omitStage(p, "filters.smrf"),
         json({ { { "type", "readers.ept" } } }));
 }
+
+TEST(pipeline, getReaderType)
+{
+    EXPECT_EQ(getReaderType(p, "a.laz"), "readers.ept");
+    EXPECT_EQ(getReaderType(json(), "a/b.COPC.LAZ"), "readers.copc");
+    EXPECT_EQ(getReaderType(json(), "s3://a/ept.json"), "readers.ept");
+    EXPECT_EQ(getReaderType(json::array({ json::object() }), "a.laz"),
+        "readers.las");
+    EXPECT_EQ(getReaderType(json(), "a.ply"), "");
+}
+
+TEST(pipeline, pushDownBounds)
+{
+    const Bounds bounds(0, 0, 0, 10, 20, 30);
+
+    json copc;
+    EXPECT_TRUE(pushDownBounds(copc, "a.copc.laz", bounds));
+    ASSERT_EQ(copc.size(), 1u);
+    EXPECT_EQ(copc.at(0).at("type").get<std::string>(), "readers.copc");
+    EXPECT_EQ(
+        copc.at(0).at("bounds").get<std::string>(),
+        "([0, 10], [0, 20])");
+
+    // Plain LAZ files have no spatial index.
+    json las;
+    EXPECT_FALSE(pushDownBounds(las, "a.laz", bounds));
+    EXPECT_TRUE(las.is_null());
+
+    // Any filters might alter coordinates, so these are left alone.
+    json mut = p;
+    EXPECT_FALSE(pushDownBounds(mut, "ept.json", bounds));
+    EXPECT_EQ(mut, p);
+
+    // As are readers which already have their own bounds.
+    json own = json::array({ { { "bounds", "([1, 2], [3, 4])" } } });
+    const json original = own;
+    EXPECT_FALSE(pushDownBounds(own, "ept.json", bounds));
+    EXPECT_EQ(own, original);
+}
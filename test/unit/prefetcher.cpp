@@ -0,0 +1,132 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <entwine/builder/prefetcher.hpp>
+#include <entwine/third/arbiter/arbiter.hpp>
+
+using namespace entwine;
+
+namespace
+{
+
+class MockDriver : public arbiter::Driver
+{
+public:
+    MockDriver() : arbiter::Driver("mock") { }
+
+    std::vector<char> put(
+        std::string path,
+        const std::vector<char>& data) const override
+    {
+        m_files[path] = data;
+        return { };
+    }
+
+    std::unique_ptr<std::size_t> tryGetSize(std::string path) const override
+    {
+        const auto it(m_files.find(path));
+        if (it == m_files.end()) return { };
+        return std::unique_ptr<std::size_t>(
+            new std::size_t(it->second.size()));
+    }
+
+    uint64_t gets() const { return m_gets; }
+
+protected:
+    bool get(std::string path, std::vector<char>& data) const override
+    {
+        ++m_gets;
+        const auto it(m_files.find(path));
+        if (it == m_files.end()) return false;
+        data = it->second;
+        return true;
+    }
+
+private:
+    mutable std::map<std::string, std::vector<char>> m_files;
+    mutable std::atomic_uint64_t m_gets { 0 };
+};
+
+std::string read(const std::string& path)
+{
+    return arbiter::Arbiter().get(path);
+}
+
+} // unnamed namespace
+
+TEST(prefetcher, fetch)
+{
+    arbiter::Arbiter a;
+    auto driver(std::make_shared<MockDriver>());
+    a.addDriver("mock", driver);
+
+    StringList paths;
+    for (int i(0); i < 8; ++i)
+    {
+        const std::string path("mock://" + std::to_string(i));
+        a.put(path, std::string(100, 'a' + i));
+        paths.push_back(path);
+    }
+
+    std::string first;
+    {
+        Prefetcher prefetcher(a, paths, 2, 250);
+        for (int i(0); i < 8; ++i)
+        {
+            const auto handle(prefetcher.get(paths[i]));
+            if (!i) first = handle->localPath();
+            EXPECT_EQ(read(handle->localPath()), std::string(100, 'a' + i));
+        }
+
+        // Paths which were not listed up front are fetched on request.
+        a.put("mock://other", std::string("other"));
+        EXPECT_EQ(
+            read(prefetcher.get("mock://other")->localPath()),
+            "other");
+    }
+
+    // Each file is downloaded exactly once, and removed once released.
+    EXPECT_EQ(driver->gets(), 9u);
+    EXPECT_FALSE(arbiter::Arbiter().exists(first));
+}
+
+TEST(prefetcher, unclaimed)
+{
+    arbiter::Arbiter a;
+    auto driver(std::make_shared<MockDriver>());
+    a.addDriver("mock", driver);
+
+    StringList paths;
+    for (int i(0); i < 4; ++i)
+    {
+        const std::string path("mock://" + std::to_string(i));
+        a.put(path, std::string(10, 'a'));
+        paths.push_back(path);
+    }
+
+    // Downloads which are never requested should be cleaned up.
+    {
+        Prefetcher prefetcher(a, paths, 4, 1000);
+        const auto handle(prefetcher.get(paths.back()));
+        EXPECT_EQ(read(handle->localPath()), std::string(10, 'a'));
+    }
+
+    EXPECT_LE(driver->gets(), 4u);
+}
+
+TEST(prefetcher, disabled)
+{
+    arbiter::Arbiter a;
+    auto driver(std::make_shared<MockDriver>());
+    a.addDriver("mock", driver);
+    a.put("mock://a", std::string("data"));
+
+    Prefetcher prefetcher(a, { "mock://a" }, 0, 0);
+    EXPECT_EQ(read(prefetcher.get("mock://a")->localPath()), "data");
+    EXPECT_EQ(driver->gets(), 1u);
+}
@@ -0,0 +1,142 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <entwine/util/ranged-stream.hpp>
+
+using namespace entwine;
+
+namespace
+{
+
+// A stand-in for an HTTP server which supports range requests.
+class Server
+{
+public:
+    explicit Server(uint64_t size) : m_data(size)
+    {
+        for (uint64_t i(0); i < size; ++i) m_data[i] = char(i * 7 + i / 251);
+    }
+
+    RangedBuffer::Fetch fetch()
+    {
+        return [this](uint64_t begin, uint64_t end)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_requests.emplace_back(begin, end);
+            if (begin == m_fail) throw std::runtime_error("Unavailable");
+            return std::vector<char>(
+                m_data.begin() + begin,
+                m_data.begin() + end);
+        };
+    }
+
+    const std::vector<char>& data() const { return m_data; }
+    std::vector<std::pair<uint64_t, uint64_t>> requests()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_requests;
+    }
+
+    void fail(uint64_t begin) { m_fail = begin; }
+
+private:
+    std::vector<char> m_data;
+    std::mutex m_mutex;
+    std::vector<std::pair<uint64_t, uint64_t>> m_requests;
+    uint64_t m_fail = -1;
+};
+
+} // unnamed namespace
+
+TEST(ranged, sequential)
+{
+    Server server(100000);
+    RangedStream stream(server.fetch(), server.data().size(), 1000, 4);
+
+    std::vector<char> result(server.data().size());
+    stream.read(result.data(), result.size());
+    ASSERT_TRUE(stream.good());
+    EXPECT_EQ(result, server.data());
+
+    char c(0);
+    EXPECT_FALSE(stream.read(&c, 1));
+    EXPECT_TRUE(stream.eof());
+
+    // Every block was requested, with exact ranges.
+    auto requests(server.requests());
+    std::sort(requests.begin(), requests.end());
+    requests.erase(
+        std::unique(requests.begin(), requests.end()),
+        requests.end());
+    ASSERT_EQ(requests.size(), 100u);
+    for (uint64_t i(0); i < requests.size(); ++i)
+    {
+        EXPECT_EQ(requests[i].first, i * 1000);
+        EXPECT_EQ(requests[i].second, (i + 1) * 1000);
+    }
+}
+
+TEST(ranged, seek)
+{
+    Server server(10500);
+    const auto& data(server.data());
+    RangedStream stream(server.fetch(), data.size(), 1000, 2);
+
+    std::vector<char> result(600);
+
+    // Across a block boundary.
+    stream.seekg(700);
+    stream.read(result.data(), 600);
+    EXPECT_TRUE(std::equal(result.begin(), result.end(), data.begin() + 700));
+    EXPECT_EQ(uint64_t(stream.tellg()), 1300u);
+
+    // Backward, within the current block.
+    stream.seekg(-300, std::ios_base::cur);
+    stream.read(result.data(), 100);
+    EXPECT_TRUE(std::equal(
+        result.begin(), result.begin() + 100, data.begin() + 1000));
+
+    // The partial final block.
+    stream.seekg(-200, std::ios_base::end);
+    EXPECT_EQ(uint64_t(stream.tellg()), 10300u);
+    stream.read(result.data(), 600);
+    EXPECT_EQ(stream.gcount(), 200);
+    EXPECT_TRUE(std::equal(
+        result.begin(), result.begin() + 200, data.begin() + 10300));
+
+    // Back to the start, as a reader would for a header.
+    stream.clear();
+    stream.seekg(0);
+    stream.read(result.data(), 10);
+    EXPECT_TRUE(std::equal(
+        result.begin(), result.begin() + 10, data.begin()));
+
+    // Out of bounds.
+    stream.seekg(20000);
+    EXPECT_TRUE(stream.fail());
+}
+
+TEST(ranged, failure)
+{
+    Server server(5000);
+    server.fail(3000);
+    RangedStream stream(server.fetch(), server.data().size(), 1000, 2);
+
+    std::vector<char> result(5000);
+    EXPECT_TRUE(stream.read(result.data(), 3000));
+    EXPECT_FALSE(stream.read(result.data(), 1));
+    EXPECT_TRUE(stream.bad());
+
+    // Past the failed block, reading works again.
+    stream.clear();
+    stream.seekg(4000);
+    EXPECT_TRUE(stream.read(result.data(), 1000));
+}
@@ -0,0 +1,77 @@
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+#include <entwine/util/json.hpp>
+#include <entwine/util/sax.hpp>
+
+using namespace entwine;
+
+namespace
+{
+    // Records the top-level events of an object, capturing any nested
+    // containers whole.
+    class Recorder : public SaxHandler
+    {
+    public:
+        std::vector<std::string> keys;
+        std::vector<json> values;
+        int starts = 0;
+        int ends = 0;
+
+    protected:
+        void onStart(bool object) override
+        {
+            if (starts++) capture();
+            else EXPECT_TRUE(object);
+        }
+        void onKey(std::string& key) override { keys.push_back(key); }
+        void onValue(json v) override { values.push_back(std::move(v)); }
+        void onEnd() override { ++ends; }
+    };
+}
+
+TEST(sax, scalars)
+{
+    Recorder r;
+    r.parse(R"({ "a": 1, "b": -2, "c": 1.5, "d": "s", "e": true, "f": null })");
+
+    const std::vector<std::string> keys { "a", "b", "c", "d", "e", "f" };
+    EXPECT_EQ(r.keys, keys);
+    ASSERT_EQ(r.values.size(), 6u);
+    EXPECT_EQ(r.values[0], 1);
+    EXPECT_EQ(r.values[1], -2);
+    EXPECT_EQ(r.values[2], 1.5);
+    EXPECT_EQ(r.values[3], "s");
+    EXPECT_EQ(r.values[4], true);
+    EXPECT_TRUE(r.values[5].is_null());
+    EXPECT_EQ(r.ends, 1);
+}
+
+TEST(sax, capture)
+{
+    const json nested = {
+        { "x", { 1, 2, { { "y", json::array() } } } },
+        { "z", { { "w", { { "v", "deep" } } } } }
+    };
+    const json doc = { { "a", nested }, { "b", { 3, 4 } }, { "c", 5 } };
+
+    Recorder r;
+    r.parse(doc.dump());
+
+    EXPECT_EQ(r.keys, (std::vector<std::string> { "a", "b", "c" }));
+    ASSERT_EQ(r.values.size(), 3u);
+    EXPECT_EQ(r.values[0], nested);
+    EXPECT_EQ(r.values[1], json({ 3, 4 }));
+    EXPECT_EQ(r.values[2], 5);
+
+    // Captured containers do not produce their own end events.
+    EXPECT_EQ(r.ends, 1);
+}
+
+TEST(sax, invalid)
+{
+    Recorder r;
+    EXPECT_ANY_THROW(r.parse(R"({ "a": 1 )"));
+}
@@ -0,0 +1,189 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <entwine/util/scheduler.hpp>
+
+using namespace entwine;
+
+namespace
+{
+
+using ms = std::chrono::milliseconds;
+using Priority = Scheduler::Priority;
+
+// A stand-in endpoint which fails its first few requests, and optionally
+// takes some time to service each one.
+class Faulty
+{
+public:
+    Faulty(int failures, ms latency = ms(0))
+        : m_failures(failures)
+        , m_latency(latency)
+    { }
+
+    void operator()()
+    {
+        std::this_thread::sleep_for(m_latency);
+        if (m_failures-- > 0) throw std::runtime_error("Throttled");
+        ++m_successes;
+    }
+
+    int successes() const { return m_successes; }
+
+private:
+    std::atomic_int m_failures;
+    const ms m_latency;
+    std::atomic_int m_successes { 0 };
+};
+
+} // unnamed namespace
+
+TEST(scheduler, retries)
+{
+    Scheduler scheduler(2, 4, ms(1), ms(10));
+
+    Faulty faulty(3);
+    scheduler.run("a", Priority::High, [&faulty]() { faulty(); });
+    EXPECT_EQ(faulty.successes(), 1);
+
+    Faulty broken(100);
+    EXPECT_ANY_THROW(
+        scheduler.run("a", Priority::High, [&broken]() { broken(); }));
+
+    const auto stats(scheduler.stats().at("a"));
+    EXPECT_EQ(stats.completed, 1u);
+    EXPECT_EQ(stats.failed, 1u);
+    EXPECT_EQ(stats.retries, 6u);
+    EXPECT_EQ(stats.queued + stats.active + stats.waiting, 0u);
+}
+
+TEST(scheduler, nonBlockingBackoff)
+{
+    // With a single worker, an operation which is backing off must not keep
+    // other operations from running.
+    Scheduler scheduler(1, 2, ms(500), ms(500));
+
+    Faulty faulty(1);
+    std::atomic_bool failedDone(false);
+    scheduler.add("a", Priority::Low, [&faulty]() { faulty(); },
+        [&failedDone](const std::string& e)
+        {
+            EXPECT_TRUE(e.empty());
+            failedDone = true;
+        });
+
+    std::this_thread::sleep_for(ms(20));
+
+    const auto start(std::chrono::steady_clock::now());
+    scheduler.run("b", Priority::Low, []() { });
+    EXPECT_LT(std::chrono::steady_clock::now() - start, ms(200));
+    EXPECT_FALSE(failedDone);
+    EXPECT_EQ(scheduler.stats().at("a").waiting, 1u);
+}
+
+TEST(scheduler, concurrency)
+{
+    Scheduler scheduler(8);
+    scheduler.limit("a", { 2, 0 });
+
+    std::atomic_int active(0);
+    std::atomic_int peak(0);
+    std::atomic_int done(0);
+
+    for (int i(0); i < 20; ++i)
+    {
+        scheduler.add("a", Priority::Low, [&]()
+        {
+            const int now(++active);
+            int p(peak);
+            while (now > p && !peak.compare_exchange_weak(p, now)) { }
+            std::this_thread::sleep_for(ms(2));
+            --active;
+        },
+        [&done](const std::string&) { ++done; });
+    }
+
+    while (done < 20) std::this_thread::sleep_for(ms(1));
+    EXPECT_LE(peak, 2);
+}
+
+TEST(scheduler, rate)
+{
+    Scheduler scheduler(4);
+    scheduler.limit("a", { 0, 50 });
+
+    const auto start(std::chrono::steady_clock::now());
+    for (int i(0); i < 100; ++i)
+    {
+        scheduler.add("a", Priority::Low, []() { }, nullptr);
+    }
+    scheduler.run("a", Priority::Low, []() { });
+
+    // A burst of 50, then the remaining 51 at 50 per second.
+    EXPECT_GE(std::chrono::steady_clock::now() - start, ms(900));
+}
+
+TEST(scheduler, priority)
+{
+    Scheduler scheduler(1);
+
+    std::mutex mutex;
+    std::vector<std::string> order;
+    const auto record([&](std::string s)
+    {
+        return [&, s]()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(s);
+        };
+    });
+
+    // Occupy our only worker so everything else is queued behind it.
+    std::atomic_bool release(false);
+    scheduler.add("a", Priority::Low, [&release]()
+    {
+        while (!release) std::this_thread::sleep_for(ms(1));
+    }, nullptr);
+    std::this_thread::sleep_for(ms(20));
+
+    for (int i(0); i < 3; ++i)
+    {
+        scheduler.add("a", Priority::Low, record("low"), nullptr);
+    }
+    scheduler.add("a", Priority::High, record("high"), nullptr);
+
+    release = true;
+    scheduler.run("a", Priority::Low, []() { });
+
+    ASSERT_EQ(order.size(), 4u);
+    EXPECT_EQ(order.front(), "high");
+}
+
+TEST(scheduler, lazyWorkers)
+{
+    Scheduler scheduler(8);
+    EXPECT_EQ(scheduler.workers(), 0u);
+
+    scheduler.run("a", Priority::High, []() { });
+    EXPECT_EQ(scheduler.workers(), 1u);
+
+    std::atomic_int done(0);
+    for (int i(0); i < 100; ++i)
+    {
+        scheduler.add(
+            "a",
+            Priority::High,
+            []() { std::this_thread::sleep_for(ms(1)); },
+            [&done](const std::string&) { ++done; });
+    }
+
+    while (done < 100) std::this_thread::sleep_for(ms(1));
+    EXPECT_EQ(scheduler.workers(), 8u);
+}
@@ -0,0 +1,165 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/util/shaped-driver.hpp>
+
+using namespace entwine;
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+const std::string dir(arbiter::getTempPath() + "entwine-shaped-test/");
+
+std::unique_ptr<arbiter::Arbiter> makeArbiter(
+    std::shared_ptr<ShapedDriver> driver)
+{
+    std::unique_ptr<arbiter::Arbiter> a(new arbiter::Arbiter());
+    a->addDriver("shaped", driver);
+    return a;
+}
+
+double msSince(const Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(
+        Clock::now() - start).count();
+}
+
+} // unnamed namespace
+
+TEST(shaped, passthrough)
+{
+    auto driver(std::make_shared<ShapedDriver>());
+    auto a(makeArbiter(driver));
+
+    const std::string root("shaped://" + dir + "passthrough/");
+    EXPECT_TRUE(a->isRemote(root + "a.json"));
+
+    // Parent directories are created implicitly.
+    a->put(root + "nested/a.json", std::string("hello"));
+    EXPECT_EQ(a->get(root + "nested/a.json"), "hello");
+    EXPECT_EQ(a->get(dir + "passthrough/nested/a.json"), "hello");
+    EXPECT_EQ(*a->tryGetSize(root + "nested/a.json"), 5u);
+    EXPECT_FALSE(a->tryGet(root + "missing.json"));
+
+    a->copy(root + "nested/a.json", root + "copied/b.json");
+    EXPECT_EQ(a->get(root + "copied/b.json"), "hello");
+
+    const std::vector<std::string> listed(a->resolve(root + "nested/*"));
+    ASSERT_EQ(listed.size(), 1u);
+    EXPECT_EQ(listed.front(), root + "nested/a.json");
+
+    EXPECT_EQ(driver->stats().requests, 7u);
+    EXPECT_EQ(driver->stats().failures, 0u);
+}
+
+TEST(shaped, latency)
+{
+    ShapedDriver::Shape shape;
+    shape.latency = 30;
+    auto driver(std::make_shared<ShapedDriver>(shape));
+    auto a(makeArbiter(driver));
+
+    const std::string path("shaped://" + dir + "latency/a.json");
+
+    const auto start(Clock::now());
+    a->put(path, std::string("hello"));
+    a->get(path);
+    EXPECT_GE(msSince(start), 60);
+}
+
+TEST(shaped, tail)
+{
+    ShapedDriver::Shape shape;
+    shape.tail = 1;
+    shape.tailLatency = 50;
+    auto driver(std::make_shared<ShapedDriver>(shape));
+    auto a(makeArbiter(driver));
+
+    const auto start(Clock::now());
+    a->put("shaped://" + dir + "tail/a.json", std::string("hello"));
+    EXPECT_GE(msSince(start), 50);
+    EXPECT_EQ(driver->stats().tails, 1u);
+}
+
+TEST(shaped, bandwidth)
+{
+    ShapedDriver::Shape shape;
+    shape.bandwidth = 100000;
+    auto driver(std::make_shared<ShapedDriver>(shape));
+    auto a(makeArbiter(driver));
+
+    const std::string path("shaped://" + dir + "bandwidth/a.bin");
+
+    auto start(Clock::now());
+    a->put(path, std::vector<char>(10000));
+    EXPECT_GE(msSince(start), 100);
+
+    start = Clock::now();
+    EXPECT_EQ(a->getBinary(path).size(), 10000u);
+    EXPECT_GE(msSince(start), 100);
+}
+
+TEST(shaped, errors)
+{
+    const std::string path("shaped://" + dir + "errors/a.json");
+    makeArbiter(std::make_shared<ShapedDriver>())->put(path, std::string("a"));
+
+    ShapedDriver::Shape shape;
+    shape.errors = 1;
+    auto driver(std::make_shared<ShapedDriver>(shape));
+    auto a(makeArbiter(driver));
+
+    EXPECT_ANY_THROW(a->put(path, std::string("b")));
+    EXPECT_FALSE(a->tryGet(path));
+    EXPECT_FALSE(a->tryGetSize(path));
+    EXPECT_ANY_THROW(a->resolve("shaped://" + dir + "errors/*"));
+    EXPECT_EQ(driver->stats().failures, 4u);
+
+    // With some fraction of failures, the same seed fails the same requests.
+    shape.errors = 0.5;
+    shape.seed = 42;
+    auto x(makeArbiter(std::make_shared<ShapedDriver>(shape)));
+    auto y(makeArbiter(std::make_shared<ShapedDriver>(shape)));
+
+    int failures(0);
+    for (int i(0); i < 100; ++i)
+    {
+        const bool success(!!x->tryGet(path));
+        EXPECT_EQ(success, !!y->tryGet(path));
+        if (!success) ++failures;
+    }
+    EXPECT_GT(failures, 20);
+    EXPECT_LT(failures, 80);
+}
+
+TEST(shaped, config)
+{
+    const json j {
+        { "latency", 40 },
+        { "jitter", 0.5 },
+        { "tail", 0.01 },
+        { "tailLatency", 2000 },
+        { "errors", 0.02 },
+        { "bandwidth", 50000000 },
+        { "seed", 7 }
+    };
+    const auto shape(j.get<ShapedDriver::Shape>());
+    EXPECT_EQ(shape.latency, 40);
+    EXPECT_EQ(shape.jitter, 0.5);
+    EXPECT_EQ(shape.tail, 0.01);
+    EXPECT_EQ(shape.tailLatency, 2000);
+    EXPECT_EQ(shape.errors, 0.02);
+    EXPECT_EQ(shape.bandwidth, 50000000);
+    EXPECT_EQ(shape.seed, 7u);
+
+    const auto empty(json::object().get<ShapedDriver::Shape>());
+    EXPECT_EQ(empty.latency, 0);
+    EXPECT_EQ(empty.errors, 0);
+}
@@ -0,0 +1,118 @@
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+#include <entwine/builder/time-index.hpp>
+#include <entwine/third/arbiter/arbiter.hpp>
+
+using namespace entwine;
+
+namespace
+{
+    using Keys = std::vector<Dxyz>;
+
+    // As the builder does, from the range of the times and then each time.
+    TimeIndex::Entry make(const std::vector<double>& times)
+    {
+        Range range;
+        for (const double t : times) range.grow(t);
+
+        TimeIndex::Entry entry(TimeIndex::create(range));
+        for (const double t : times) entry.mark(t);
+        return entry;
+    }
+
+    // The root holds two passes, separated by a gap.
+    void fill(TimeIndex& index)
+    {
+        index.set(Dxyz(), make({ 0, 5, 10, 90, 95, 100 }));
+        index.set(Dxyz(1, 0, 0, 0), make({ 20, 30 }));
+        index.set(Dxyz(1, 1, 0, 0), make({ 50, 60 }));
+        index.set(Dxyz(2, 0, 0, 0), make({ 25, 26 }));
+    }
+
+    void checkQueries(const TimeIndex& index)
+    {
+        EXPECT_EQ(index.query(40, 45), Keys());
+        EXPECT_EQ(index.query(200, 300), Keys());
+        EXPECT_EQ(index.query(5, 5), Keys({ Dxyz() }));
+        EXPECT_EQ(index.query(25, 25.5), Keys({ Dxyz(2, 0, 0, 0) }));
+        EXPECT_EQ(
+            index.query(55, 92),
+            Keys({ Dxyz(), Dxyz(1, 1, 0, 0) }));
+        EXPECT_EQ(
+            index.query(0, 100),
+            Keys({
+                Dxyz(),
+                Dxyz(1, 0, 0, 0),
+                Dxyz(1, 1, 0, 0),
+                Dxyz(2, 0, 0, 0)
+            }));
+    }
+}
+
+TEST(timeIndex, create)
+{
+    const TimeIndex::Entry e(make({ 10, 42, 20 }));
+    EXPECT_EQ(e.range.min, 10);
+    EXPECT_EQ(e.range.max, 42);
+    EXPECT_EQ(e.mask, (1u << 0) | (1u << 10) | (1u << 31));
+    EXPECT_TRUE(e.overlaps(0, 10));
+    EXPECT_TRUE(e.overlaps(19.5, 20.5));
+    EXPECT_FALSE(e.overlaps(25, 35));
+    EXPECT_FALSE(e.overlaps(43, 50));
+
+    const TimeIndex::Entry single(make({ 7 }));
+    EXPECT_EQ(single.mask, 1u);
+    EXPECT_TRUE(single.overlaps(7, 7));
+    EXPECT_FALSE(single.overlaps(8, 9));
+
+    EXPECT_TRUE(make({ }).range.empty());
+    EXPECT_FALSE(make({ }).overlaps(0, 100));
+}
+
+TEST(timeIndex, query)
+{
+    TimeIndex index;
+    fill(index);
+    EXPECT_EQ(index.size(), 4u);
+    EXPECT_TRUE(index.changed());
+    checkQueries(index);
+
+    // Ancestors which have not been set are created, linking to the node.
+    TimeIndex deep;
+    deep.set(Dxyz(3, 1, 1, 1), make({ 1, 2 }));
+    EXPECT_EQ(deep.size(), 4u);
+
+    TimeIndex::Entry root;
+    ASSERT_TRUE(deep.find(Dxyz(), root));
+    EXPECT_TRUE(root.range.empty());
+    EXPECT_EQ(root.subtree.min, 1);
+    EXPECT_EQ(root.subtree.max, 2);
+    EXPECT_EQ(deep.query(0, 10), Keys({ Dxyz(3, 1, 1, 1) }));
+}
+
+TEST(timeIndex, saveLoad)
+{
+    const std::string out(
+        arbiter::join(arbiter::getTempPath(), "entwine-time-index-test/"));
+    arbiter::mkdirp(out);
+    arbiter::Arbiter a;
+    const arbiter::Endpoint ep(a.getEndpoint(out));
+
+    TimeIndex index;
+    fill(index);
+    timeindex::save(index, ep, "-1");
+    EXPECT_EQ(ep.getSize(timeindex::getFilename("-1")), 16 + 4 * 56);
+
+    TimeIndex loaded;
+    timeindex::load(loaded, ep, "-1");
+    EXPECT_EQ(loaded.size(), 4u);
+    EXPECT_FALSE(loaded.changed());
+    checkQueries(loaded);
+
+    ep.put(timeindex::getFilename("-2"), "ETIX");
+    TimeIndex bad;
+    EXPECT_ANY_THROW(timeindex::load(bad, ep, "-2"));
+}
@@ -0,0 +1,85 @@
+#include "gtest/gtest.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/util/uploader.hpp>
+
+using namespace entwine;
+
+namespace
+{
+    const std::string dir(
+        arbiter::join(arbiter::getTempPath(), "entwine-uploader-test"));
+}
+
+TEST(uploader, uploads)
+{
+    arbiter::mkdirp(dir);
+    arbiter::Arbiter a;
+    const arbiter::Endpoint ep(a.getEndpoint(dir));
+
+    const uint64_t maxBytes(64);
+    const int count(200);
+
+    {
+        Scheduler scheduler(4);
+        Uploader uploader(ep, scheduler, maxBytes);
+
+        std::vector<std::thread> producers;
+        for (int t(0); t < 4; ++t)
+        {
+            producers.emplace_back([&uploader, t]()
+            {
+                for (int i(t); i < count; i += 4)
+                {
+                    const std::string s(i % 50, 'a' + i % 26);
+                    uploader.put(
+                        std::to_string(i) + ".bin",
+                        std::vector<char>(s.begin(), s.end()));
+                }
+            });
+        }
+
+        // A single put larger than the budget must not block forever.
+        uploader.put("big.bin", std::vector<char>(maxBytes * 4, 'x'));
+
+        for (auto& p : producers) p.join();
+
+        uploader.wait("7.bin");
+        EXPECT_EQ(ep.get("7.bin"), std::string(7, 'h'));
+
+        uploader.wait();
+        EXPECT_EQ(uploader.bytes(), 0u);
+    }
+
+    for (int i(0); i < count; ++i)
+    {
+        const std::string path(std::to_string(i) + ".bin");
+        ASSERT_EQ(ep.get(path), std::string(i % 50, 'a' + i % 26));
+        arbiter::remove(ep.fullPath(path));
+    }
+    EXPECT_EQ(ep.getBinary("big.bin").size(), maxBytes * 4);
+    arbiter::remove(ep.fullPath("big.bin"));
+}
+
+TEST(uploader, overwrite)
+{
+    arbiter::mkdirp(dir);
+    arbiter::Arbiter a;
+    const arbiter::Endpoint ep(a.getEndpoint(dir));
+
+    Scheduler scheduler(8);
+    Uploader uploader(ep, scheduler, 1024);
+    for (int i(0); i < 20; ++i)
+    {
+        const std::string s(std::to_string(i));
+        uploader.put("same.bin", std::vector<char>(s.begin(), s.end()));
+    }
+    uploader.wait();
+
+    EXPECT_EQ(ep.get("same.bin"), "19");
+    arbiter::remove(ep.fullPath("same.bin"));
+}